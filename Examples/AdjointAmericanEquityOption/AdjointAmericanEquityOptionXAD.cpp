@@ -36,11 +36,17 @@ with XAD.
 #include <ql/exercise.hpp>
 #include <ql/pricingengines/vanilla/baroneadesiwhaleyengine.hpp>
 #include <ql/pricingengines/vanilla/fdblackscholesvanillaengine.hpp>
+#include <ql/risks/admode.hpp>
+#include <ql/risks/batchedamericanengine.hpp>
+#include <ql/risks/risksession.hpp>
 
 #include <vector>
 #include <iostream>
 #include <iomanip>
 
+// per-thread sessions, with QuantLib built with QL_ENABLE_SESSIONS
+QLRISKS_DEFINE_SESSION_ID
+
 using namespace QuantLib;
 
 Real priceAmerican(Rate riskFreeRate, const Calendar &calendar,
@@ -85,36 +91,89 @@ Real priceAmerican(Rate riskFreeRate, const Calendar &calendar,
 using tape_type = Real::tape_type;
 tape_type tape;
 
+// With only 5 inputs, the cheapest mode depends on the relative cost of recording the
+// finite-difference engine versus re-running it, so we let the cost model decide.  The
+// model is measured on the first valuation and reused by the following ones.  In the
+// forward-difference mode, the Greeks are one-sided bumps of the engine.
+TapeCostModel americanCost;
+
 Real priceWithSensi(Rate riskFreeRate, const Calendar& calendar,
                     const Date maturity, Real strike, const Date settlementDate,
                     DayCounter dayCounter, Volatility volatility, Date todaysDate,
                     Spread dividendYield, Option::Type type, Real underlying,
-                    const std::vector<Date>& exerciseDates, std::vector<Real>& gradient)
+                    const std::vector<Date>& exerciseDates, std::vector<Real>& gradient,
+                    ADMode& mode)
 {
-    // register the independent inputs
-    tape.registerInput(riskFreeRate);
-    tape.registerInput(strike);
-    tape.registerInput(volatility);
+    // the independent inputs, in the order of the gradient
+    std::vector<double> inputs = {value(riskFreeRate), value(strike), value(volatility),
+                                  value(underlying), value(dividendYield)};
+    auto task = [&](const std::vector<Real>& x) {
+        return std::vector<Real>{priceAmerican(x[0], calendar, maturity, x[1], settlementDate,
+                                               dayCounter, x[2], todaysDate, x[4], type, x[3],
+                                               exerciseDates)};
+    };
+
+    // select the cheapest mode for the task, and compute the sensitivities in it
+    std::vector<double> jacobian;
+    auto values = differentiateTask(task, inputs, 1, jacobian, americanCost, &mode);
+
+    gradient.assign(jacobian.begin(), jacobian.end());
+    return values[0];
+}
+
+// A screen of listed options on the same underlying, one volatility per quote, priced
+// with the batched Barone-Adesi-Whaley approximation.  All quotes are recorded together,
+// and one adjoint sweep gives the vega of every quote along with the screen's delta.
+void priceScreenWithSensi(Rate riskFreeRate, const Calendar& calendar, Date settlementDate,
+                          DayCounter dayCounter, Volatility volatility, Spread dividendYield,
+                          Option::Type type, Real underlying)
+{
+    std::vector<Real> strikes = {32.0, 36.0, 40.0, 44.0, 48.0};
+    std::vector<Period> expiries = {3 * Months, 6 * Months, 1 * Years};
+
+    tape.clearAll();
     tape.registerInput(underlying);
+    tape.registerInput(riskFreeRate);
     tape.registerInput(dividendYield);
+    // a simple smile around the option's volatility
+    std::vector<Real> vols;
+    for (Size i = 0; i < expiries.size(); ++i)
+        for (auto strike : strikes)
+            vols.push_back(volatility + 0.002 * std::fabs(value(strike) - 40.0));
+    tape.registerInputs(vols);
     tape.newRecording();
 
-    Real value = priceAmerican(riskFreeRate, calendar, maturity, strike,
-                               settlementDate, dayCounter, volatility, todaysDate, dividendYield, type, underlying, exerciseDates);
-
-    // register dependent variables and roll back the adjoints
-    tape.registerOutput(value);
-    derivative(value) = 1.0;
+    AmericanOptionBatch screen;
+    for (Size i = 0; i < expiries.size(); ++i) {
+        Time t = dayCounter.yearFraction(settlementDate,
+                                         calendar.advance(settlementDate, expiries[i]));
+        for (Size j = 0; j < strikes.size(); ++j) {
+            const Real& vol = vols[i * strikes.size() + j];
+            screen.add(type, underlying, strikes[j], std::exp(-riskFreeRate * t),
+                       std::exp(-dividendYield * t), vol * vol * t);
+        }
+    }
+    std::vector<Real> values = screen.baroneAdesiWhaleyValues();
+    tape.registerOutputs(values);
+    for (auto& v : values)
+        derivative(v) = 1.0;
     tape.computeAdjoints();
 
-    // add adjoints to the gradient vector
-    gradient.push_back(derivative(riskFreeRate));
-    gradient.push_back(derivative(strike));
-    gradient.push_back(derivative(volatility));
-    gradient.push_back(derivative(underlying));
-    gradient.push_back(derivative(dividendYield));
-
-    return value;
+    std::cout << "\nScreen (Barone-Adesi-Whaley, " << screen.size() << " quotes):\n";
+    std::cout << "Expiry  Strike       Value        Vega\n";
+    for (Size i = 0; i < expiries.size(); ++i) {
+        for (Size j = 0; j < strikes.size(); ++j) {
+            Size k = i * strikes.size() + j;
+            std::cout << std::setw(6) << expiries[i] << std::setw(8) << strikes[j]
+                      << std::setw(12) << std::setprecision(6) << values[k] << std::setw(12)
+                      << derivative(vols[k]) << "\n";
+        }
+    }
+    std::cout << "Screen Delta       = " << derivative(underlying) << "\n";
+    std::cout << "Screen Rho         = " << derivative(riskFreeRate) << "\n";
+    std::cout << "Screen Div. Rho    = " << derivative(dividendYield) << "\n";
+    std::cout << std::endl;
+    tape.clearAll();
 }
 
 #endif
@@ -166,12 +225,28 @@ int main()
         std::cout << "American equity option value: " << v << "\n";
 #else
         std::vector<Real> gradient;
+        ADMode mode;
         std::cout << "Pricing American equity option with sensitivities...\n";
         Real v = priceWithSensi(riskFreeRate, calendar, maturity, strike,
                 settlementDate, dayCounter, volatility, todaysDate,
-                dividendYield, type, underlying, exerciseDates, gradient);
+                dividendYield, type, underlying, exerciseDates, gradient, mode);
         std::cout << "American equity option value: " << v << "\n";
+        std::cout << "Sensitivities computed in " << mode << " mode\n";
         printResults(v, gradient);
+
+        // revaluations for moved spots reuse the cost model measured above
+        for (Real spot : {34.0, 38.0}) {
+            Real vs = priceWithSensi(riskFreeRate, calendar, maturity, strike, settlementDate,
+                                     dayCounter, volatility, todaysDate, dividendYield, type,
+                                     spot, exerciseDates, gradient, mode);
+            std::cout << "Spot " << spot << ": value " << vs << ", delta " << gradient[3]
+                      << " (" << mode << " mode)\n";
+        }
+        std::cout << std::endl;
+
+        std::cout << "Pricing an option screen with sensitivities...\n";
+        priceScreenWithSensi(riskFreeRate, calendar, settlementDate, dayCounter, volatility,
+                             dividendYield, type, underlying);
 #endif
 
         return 0;
@@ -32,6 +32,8 @@ This example shows how to use XAD to price a CDS with sensitivities.
 #include <ql/math/interpolations/backwardflatinterpolation.hpp>
 #include <ql/pricingengines/credit/midpointcdsengine.hpp>
 #include <ql/quotes/simplequote.hpp>
+#include <ql/risks/riskengine.hpp>
+#include <ql/risks/risksession.hpp>
 #include <ql/termstructures/credit/defaultprobabilityhelpers.hpp>
 #include <ql/termstructures/credit/flathazardrate.hpp>
 #include <ql/termstructures/credit/interpolatedhazardratecurve.hpp>
@@ -44,6 +46,9 @@ This example shows how to use XAD to price a CDS with sensitivities.
 #include <iostream>
 #include <vector>
 
+// per-thread sessions, with QuantLib built with QL_ENABLE_SESSIONS
+QLRISKS_DEFINE_SESSION_ID
+
 using namespace std;
 using namespace QuantLib;
 
@@ -102,30 +107,21 @@ Real priceWithSensi(const std::vector<Real>& hazardRates,
     // register the independent inputs
     auto riskFreeRates_t = riskFreeRate;
     auto hazardRates_t = hazardRates;
-    tape.registerInputs(riskFreeRates_t);
-    tape.registerInputs(hazardRates_t);
-    tape.registerInput(recoveryRate);
-    tape.registerInput(fixedRate);
-    tape.registerInput(notional);
-    tape.newRecording();
-
-    Real value = priceCDS(hazardRates_t, dates, riskFreeRates_t, issueDate, maturity, recoveryRate,
-                          fixedRate, calendar, dayCount, notional);
-
-    // register dependent variables and roll back the adjoints
-    tape.registerOutput(value);
-    derivative(value) = 1.0;
-    tape.computeAdjoints();
-
-    for (auto& r : riskFreeRates_t) {
-        gradient.push_back(derivative(r));
-    }
-    for (auto& a : hazardRates_t) {
-        gradient.push_back(derivative(a));
-    }
-    gradient.push_back(derivative(recoveryRate));
-    gradient.push_back(derivative(fixedRate));
-    gradient.push_back(derivative(notional));
+    RiskEngine engine(tape);
+    engine.addFactors("riskFreeRates", riskFreeRates_t);
+    engine.addFactors("hazardRates", hazardRates_t);
+    engine.addFactor("recoveryRate", recoveryRate);
+    engine.addFactor("fixedRate", fixedRate);
+    engine.addFactor("notional", notional);
+
+    engine.addPricer([&]() {
+        return priceCDS(hazardRates_t, dates, riskFreeRates_t, issueDate, maturity, recoveryRate,
+                        fixedRate, calendar, dayCount, notional);
+    });
+    Real value = engine.calculate()[0];
+
+    auto sensitivities = engine.sensitivities();
+    gradient.assign(sensitivities.begin(), sensitivities.end());
 
     return value;
 }
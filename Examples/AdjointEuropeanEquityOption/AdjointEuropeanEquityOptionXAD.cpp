@@ -34,8 +34,14 @@ This sample is used to validate XAD performance with an analytic engine.
 #include <ql/exercise.hpp>
 #include <ql/instruments/vanillaoption.hpp>
 #include <ql/pricingengines/vanilla/analyticeuropeanengine.hpp>
+#include <ql/pricingengines/vanilla/fdblackscholesvanillaengine.hpp>
 #include <ql/processes/blackscholesprocess.hpp>
 #include <ql/quotes/simplequote.hpp>
+#include <ql/risks/localvolgrid.hpp>
+#include <ql/risks/pnlexplain.hpp>
+#include <ql/risks/perfcounters.hpp>
+#include <ql/risks/riskengine.hpp>
+#include <ql/risks/risksession.hpp>
 #include <ql/termstructures/volatility/equityfx/blackconstantvol.hpp>
 #include <ql/termstructures/volatility/equityfx/blackvariancecurve.hpp>
 #include <ql/termstructures/volatility/equityfx/blackvoltermstructure.hpp>
@@ -44,10 +50,18 @@ This sample is used to validate XAD performance with an analytic engine.
 #include <ql/time/calendars/target.hpp>
 #include <ql/time/daycounters/actual365fixed.hpp>
 #include <chrono>
+#include <cmath>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <vector>
 
+// counts the heap allocations of the pricing phases, with QLRISKS_ENABLE_ALLOCATION_HOOKS
+QLRISKS_DEFINE_ALLOCATION_HOOKS
+
+// per-thread sessions, with QuantLib built with QL_ENABLE_SESSIONS
+QLRISKS_DEFINE_SESSION_ID
+
 using namespace QuantLib;
 
 // to record all sensitivities of the portfolio
@@ -72,6 +86,8 @@ Real priceEuropean(const std::vector<Date>& dates,
                    Option::Type type,
                    const std::vector<Real>& underlyings) {
 
+    // building the object graph is the part of this phase outside the nested npv phases
+    PerfPhase phase("portfolio");
     auto europeanExercise = ext::make_shared<EuropeanExercise>(maturity);
 
     // setup the yield/dividend/vol curves
@@ -100,6 +116,7 @@ Real priceEuropean(const std::vector<Date>& dates,
             // computing the option price with the analytic Black-Scholes formulae
             european->setPricingEngine(engine);
 
+            PerfPhase npv("npv");
             value += european->NPV();
         }
     }
@@ -113,69 +130,62 @@ Real priceEuropean(const std::vector<Date>& dates,
 using tape_type = Real::tape_type;
 tape_type tape;
 
-Real priceWithSensi(const std::vector<Date>& dates,
-                    const std::vector<Rate>& rates,
-                    const std::vector<Real>& vols,
-                    const Calendar& calendar,
-                    const Date& maturity,
-                    const std::vector<Real>& strikes,
-                    const Date settlementDate,
-                    DayCounter& dayCounter,
-                    Date todaysDate,
-                    Spread dividendYield,
-                    Option::Type type,
-                    const std::vector<Real>& underlyings,
-                    OptionSensitivities& sensiOutput) {
-    // to enable repeated runs, we clear the tape first
-    tape.clearAll();
-
-    // copy inputs and register them on the tape
-    auto t_rates = rates;
-    auto t_vols = vols;
-    auto t_strikes = strikes;
-    auto t_underlyings = underlyings;
-    tape.registerInputs(t_rates);
-    tape.registerInputs(t_vols);
-    tape.registerInputs(t_strikes);
-    tape.registerInputs(t_underlyings);
-    tape.registerInput(dividendYield);
-    tape.newRecording();
-
-    // price
-    Real value =
-        priceEuropean(dates, t_rates, t_vols, calendar, maturity, t_strikes, settlementDate,
-                      dayCounter, todaysDate, dividendYield, type, t_underlyings);
-
-    // register output, set adjoint, and roll back the tape to the inputs
-    tape.registerOutput(value);
-    derivative(value) = 1.0;
-    tape.computeAdjoints();
-
-    // obtain the sensitivities and store them in the result struct
-    sensiOutput.rhos.clear();
-    sensiOutput.rhos.reserve(t_rates.size());
-    for (Size i = 0; i < t_rates.size(); ++i) {
-        sensiOutput.rhos.push_back(derivative(t_rates[i]));
-    }
-    sensiOutput.vegas.clear();
-    sensiOutput.vegas.reserve(t_vols.size());
-    for (Size i = 0; i < t_vols.size(); ++i) {
-        sensiOutput.vegas.push_back(derivative(t_vols[i]));
-    }
-    sensiOutput.strikeSensitivities.clear();
-    sensiOutput.strikeSensitivities.reserve(t_strikes.size());
-    for (Size i = 0; i < t_strikes.size(); ++i) {
-        sensiOutput.strikeSensitivities.push_back(derivative(t_strikes[i]));
+// the inputs are copied and registered as risk factors once, and each calculation records
+// the pricer again into the buffers of the risk engine
+class SensiPricer {
+  public:
+    SensiPricer(const std::vector<Date>& dates,
+                const std::vector<Rate>& rates,
+                const std::vector<Real>& vols,
+                const Calendar& calendar,
+                const Date& maturity,
+                const std::vector<Real>& strikes,
+                const Date settlementDate,
+                DayCounter& dayCounter,
+                Date todaysDate,
+                Spread dividendYield,
+                Option::Type type,
+                const std::vector<Real>& underlyings)
+    : rates_(rates), vols_(vols), strikes_(strikes), underlyings_(underlyings),
+      dividendYield_(dividendYield), engine_(tape) {
+        engine_.addFactors("rates", rates_);
+        engine_.addFactors("vols", vols_);
+        engine_.addFactors("strikes", strikes_);
+        engine_.addFactors("underlyings", underlyings_);
+        engine_.addFactor("dividend", dividendYield_);
+
+        // price
+        engine_.addPricer([=]() mutable {
+            return priceEuropean(dates, rates_, vols_, calendar, maturity, strikes_,
+                                 settlementDate, dayCounter, todaysDate, dividendYield_, type,
+                                 underlyings_);
+        });
     }
-    sensiOutput.deltas.clear();
-    sensiOutput.deltas.reserve(t_underlyings.size());
-    for (Size i = 0; i < t_underlyings.size(); ++i) {
-        sensiOutput.deltas.push_back(derivative(t_underlyings[i]));
+
+    Real calculate(OptionSensitivities& sensiOutput) {
+        Real value = engine_.calculate()[0];
+
+        // obtain the sensitivities and store them in the result struct
+        auto rhos = engine_.sensitivities("rates");
+        sensiOutput.rhos.assign(rhos.begin(), rhos.end());
+        auto vegas = engine_.sensitivities("vols");
+        sensiOutput.vegas.assign(vegas.begin(), vegas.end());
+        auto strikeSensitivities = engine_.sensitivities("strikes");
+        sensiOutput.strikeSensitivities.assign(strikeSensitivities.begin(),
+                                               strikeSensitivities.end());
+        auto deltas = engine_.sensitivities("underlyings");
+        sensiOutput.deltas.assign(deltas.begin(), deltas.end());
+        sensiOutput.dividendRho = engine_.sensitivities("dividend")[0];
+
+        return value;
     }
-    sensiOutput.dividendRho = derivative(dividendYield);
 
-    return value;
-}
+  private:
+    std::vector<Rate> rates_;
+    std::vector<Real> vols_, strikes_, underlyings_;
+    Spread dividendYield_;
+    RiskEngine engine_;
+};
 
 #else // pricing with bumping, as we don't have XAD available here
 
@@ -256,6 +266,33 @@ Real priceWithSensi(const std::vector<Date>& dates,
     return value;
 }
 
+// same interface as with XAD
+class SensiPricer {
+  public:
+    SensiPricer(const std::vector<Date>& dates,
+                const std::vector<Rate>& rates,
+                const std::vector<Real>& vols,
+                const Calendar& calendar,
+                const Date& maturity,
+                const std::vector<Real>& strikes,
+                const Date settlementDate,
+                DayCounter& dayCounter,
+                Date todaysDate,
+                Spread dividendYield,
+                Option::Type type,
+                const std::vector<Real>& underlyings)
+    : calculate_([=](OptionSensitivities& sensiOutput) mutable {
+          return priceWithSensi(dates, rates, vols, calendar, maturity, strikes, settlementDate,
+                                dayCounter, todaysDate, dividendYield, type, underlyings,
+                                sensiOutput);
+      }) {}
+
+    Real calculate(OptionSensitivities& sensiOutput) { return calculate_(sensiOutput); }
+
+  private:
+    std::function<Real(OptionSensitivities&)> calculate_;
+};
+
 #endif
 
 void printResults(Real v, const OptionSensitivities& sensiOutput) {
@@ -285,6 +322,122 @@ void printResults(Real v, const OptionSensitivities& sensiOutput) {
     std::cout << std::endl;
 }
 
+#ifndef QLRISKS_DISABLE_AAD
+
+// explains the P&L between two market snapshots from the AAD risk at both snapshots,
+// where the risk factors are the rates, vols, underlyings, and the dividend yield
+void explainMarketMove(const std::vector<double>& startFactors,
+                       const std::vector<double>& endFactors,
+                       Size nRates,
+                       Size nVols,
+                       const std::vector<Date>& dates,
+                       const Calendar& calendar,
+                       const Date& maturity,
+                       const std::vector<Real>& strikes,
+                       const Date& settlementDate,
+                       DayCounter& dayCounter,
+                       const Date& todaysDate,
+                       Option::Type type) {
+    Size nUnderlyings = startFactors.size() - nRates - nVols - 1;
+    auto pricer = [&](const std::vector<Real>& x) {
+        std::vector<Real> rates(x.begin(), x.begin() + nRates);
+        std::vector<Real> vols(x.begin() + nRates, x.begin() + nRates + nVols);
+        std::vector<Real> underlyings(x.begin() + nRates + nVols, x.end() - 1);
+        return priceEuropean(dates, rates, vols, calendar, maturity, strikes, settlementDate,
+                             dayCounter, todaysDate, x.back(), type, underlyings);
+    };
+
+    auto explain = explainPnL(pricer, startFactors, endFactors);
+
+    std::cout << "P&L explain:\n";
+    std::cout << "Rates          : " << explain.explained(0, nRates) << "\n";
+    std::cout << "Vols           : " << explain.explained(nRates, nRates + nVols) << "\n";
+    std::cout << "Underlyings    : "
+              << explain.explained(nRates + nVols, nRates + nVols + nUnderlyings) << "\n";
+    std::cout << "Dividend yield : "
+              << explain.explained(startFactors.size() - 1, startFactors.size()) << "\n";
+    std::cout << "Explained P&L  : " << explain.explained() << "\n";
+    std::cout << "Actual P&L     : " << explain.actual() << "\n";
+    std::cout << "Unexplained    : " << explain.unexplained() << "\n\n";
+}
+
+/* Prices puts with Dupire local volatility from an implied volatility surface (the term
+ * structure of vols with a smile around the spot), and computes the vega buckets of the
+ * portfolio to all the implied volatilities of the surface in one adjoint sweep.
+ */
+void priceLocalVolWithVegas(const std::vector<Date>& dates,
+                            const std::vector<Rate>& rates,
+                            const std::vector<Real>& vols,
+                            const Date& maturity,
+                            const Date& settlementDate,
+                            DayCounter& dayCounter,
+                            Spread dividendYield,
+                            Real underlying) {
+    std::vector<Date> expiries(dates.begin() + 1, dates.end());
+    std::vector<Real> surfaceStrikes;
+    for (Real k = 20.0; k <= 50.0; k += 5.0)
+        surfaceStrikes.push_back(k);
+    const Size n = surfaceStrikes.size(), m = expiries.size();
+    std::vector<Real> surfaceVols(n * m);
+    for (Size i = 0; i < n; ++i) {
+        Real x = std::log(surfaceStrikes[i] / underlying);
+        for (Size j = 0; j < m; ++j)
+            surfaceVols[i * m + j] = vols[j] * (1.0 - 0.1 * x + 0.3 * x * x);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    RiskEngine engine(tape);
+    engine.addFactors("surface vols", surfaceVols);
+    engine.addPricer([&]() {
+        Matrix blackVols(n, m);
+        for (Size i = 0; i < n; ++i)
+            for (Size j = 0; j < m; ++j)
+                blackVols[i][j] = surfaceVols[i * m + j];
+        Handle<Quote> spot(ext::make_shared<SimpleQuote>(underlying));
+        Handle<YieldTermStructure> riskFree(
+            ext::make_shared<ZeroCurve>(dates, rates, dayCounter));
+        Handle<YieldTermStructure> dividend(
+            ext::make_shared<FlatForward>(settlementDate, dividendYield, dayCounter));
+        // the at-the-money term structure sizes the finite-difference mesh
+        Handle<BlackVolTermStructure> atmVols(
+            ext::make_shared<BlackVarianceCurve>(settlementDate, expiries, vols, dayCounter));
+        Handle<LocalVolTermStructure> localVols(ext::make_shared<LocalVolGrid>(
+            settlementDate, expiries, surfaceStrikes, blackVols, spot, riskFree, dividend,
+            dayCounter));
+        auto process = ext::make_shared<GeneralizedBlackScholesProcess>(spot, dividend, riskFree,
+                                                                        atmVols, localVols);
+        auto fdEngine = ext::make_shared<FdBlackScholesVanillaEngine>(
+            process, 50, 100, 0, FdmSchemeDesc::Douglas(), true);
+        auto exercise = ext::make_shared<EuropeanExercise>(maturity);
+        Real value = 0.0;
+        for (Real strike : {30.0, 35.0, 40.0}) {
+            VanillaOption put(ext::make_shared<PlainVanillaPayoff>(Option::Put, strike),
+                              exercise);
+            put.setPricingEngine(fdEngine);
+            value += put.NPV();
+        }
+        return value;
+    });
+    double value = engine.calculate()[0];
+    auto vegas = engine.sensitivities("surface vols");
+    auto end = std::chrono::high_resolution_clock::now();
+
+    std::cout << "Local volatility puts value = " << value << "\n";
+    std::cout << "Vega buckets by expiry      = [";
+    for (Size j = 0; j < m; ++j) {
+        double vega = 0.0;
+        for (Size i = 0; i < n; ++i)
+            vega += vegas[i * m + j];
+        std::cout << vega << ", ";
+    }
+    std::cout << "]\n";
+    std::cout << "Local vol sensi time : "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() * 1e-3
+              << "ms\n\n";
+}
+
+#endif
+
 int main() {
     try {
         // set up dates
@@ -342,10 +495,11 @@ int main() {
         std::cout << "Pricing european equity option portfolio with sensitivities...\n";
         OptionSensitivities sensi;
         Real v2 = 0.0;
+        SensiPricer sensiPricer(dates, rates, vols, calendar, maturity, strikes, settlementDate,
+                                dayCounter, todaysDate, dividendYield, type, underlyings);
         start = std::chrono::high_resolution_clock::now();
         for (int i = 0; i < N; ++i) {
-            v2 = priceWithSensi(dates, rates, vols, calendar, maturity, strikes, settlementDate,
-                                dayCounter, todaysDate, dividendYield, type, underlyings, sensi);
+            v2 = sensiPricer.calculate(sensi);
         }
         end = std::chrono::high_resolution_clock::now();
         auto time_sensi =
@@ -360,6 +514,48 @@ int main() {
                   << "Sensi time : " << time_sensi << "ms\n"
                   << "Factor     : " << time_sensi / time_plain << "x\n";
 
+        // hardware event and allocation counts of the pricing phases, with
+        // QLRISKS_ENABLE_PERF_COUNTERS or QLRISKS_ENABLE_ALLOCATION_HOOKS, from one more run
+        // of each, as reading the counters around the timed runs would skew the timings
+        PerfProfile profile;
+        if (profile.available()) {
+            {
+                PerfPhase phase("plain");
+                priceEuropean(dates, rates, vols, calendar, maturity, strikes, settlementDate,
+                              dayCounter, todaysDate, dividendYield, type, underlyings);
+            }
+            {
+                PerfPhase phase("sensi");
+                sensiPricer.calculate(sensi);
+            }
+            std::cout << profile;
+        }
+
+#ifndef QLRISKS_DISABLE_AAD
+        // next day's market: rates +5bp, vols +1%, underlyings -2%, dividend yield +10bp
+        std::vector<double> startFactors, endFactors;
+        for (auto& r : rates) {
+            startFactors.push_back(value(r));
+            endFactors.push_back(value(r) + 0.0005);
+        }
+        for (auto& vol : vols) {
+            startFactors.push_back(value(vol));
+            endFactors.push_back(value(vol) + 0.01);
+        }
+        for (auto& u : underlyings) {
+            startFactors.push_back(value(u));
+            endFactors.push_back(value(u) * 0.98);
+        }
+        startFactors.push_back(value(dividendYield));
+        endFactors.push_back(value(dividendYield) + 0.001);
+        std::cout << "\n";
+        explainMarketMove(startFactors, endFactors, rates.size(), vols.size(), dates, calendar,
+                          maturity, strikes, settlementDate, dayCounter, todaysDate, type);
+
+        priceLocalVolWithVegas(dates, rates, vols, maturity, settlementDate, dayCounter,
+                               dividendYield, 35.0);
+#endif
+
         return 0;
     } catch (std::exception& e) {
         std::cerr << e.what() << std::endl;
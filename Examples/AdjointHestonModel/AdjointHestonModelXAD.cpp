@@ -38,6 +38,7 @@ TODO: Use the implicit function theorem for calibration with AAD.
 #include <ql/pricingengines/vanilla/fdhestonvanillaengine.hpp>
 #include <ql/processes/hestonprocess.hpp>
 #include <ql/quotes/simplequote.hpp>
+#include <ql/risks/risksession.hpp>
 #include <ql/termstructures/yield/flatforward.hpp>
 #include <ql/termstructures/yield/zerocurve.hpp>
 #include <ql/termstructures/yieldtermstructure.hpp>
@@ -50,6 +51,9 @@ TODO: Use the implicit function theorem for calibration with AAD.
 #include <iostream>
 #include <vector>
 
+// per-thread sessions, with QuantLib built with QL_ENABLE_SESSIONS
+QLRISKS_DEFINE_SESSION_ID
+
 using namespace QuantLib;
 
 
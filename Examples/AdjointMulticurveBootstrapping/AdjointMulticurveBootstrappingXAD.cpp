@@ -40,6 +40,11 @@ either with XAD or with plain doubles and bumping (when QLRISKS_DISABLE_AAD is O
 #include <ql/math/interpolations/cubicinterpolation.hpp>
 #include <ql/math/interpolations/loginterpolation.hpp>
 #include <ql/pricingengines/swap/discountingswapengine.hpp>
+#include <ql/risks/curvesnapshot.hpp>
+#include <ql/risks/perfcounters.hpp>
+#include <ql/risks/riskengine.hpp>
+#include <ql/risks/risksession.hpp>
+#include <ql/termstructures/yield/discountcurve.hpp>
 #include <ql/termstructures/yield/oisratehelper.hpp>
 #include <ql/termstructures/yield/piecewiseyieldcurve.hpp>
 #include <ql/termstructures/yield/ratehelpers.hpp>
@@ -49,29 +54,33 @@ either with XAD or with plain doubles and bumping (when QLRISKS_DISABLE_AAD is O
 #include <ql/time/daycounters/actualactual.hpp>
 #include <ql/time/daycounters/thirty360.hpp>
 #include <ql/time/imm.hpp>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <string>
+
+// counts the heap allocations of the pricing phases, with QLRISKS_ENABLE_ALLOCATION_HOOKS
+QLRISKS_DEFINE_ALLOCATION_HOOKS
+
+// per-thread sessions, with QuantLib built with QL_ENABLE_SESSIONS
+QLRISKS_DEFINE_SESSION_ID
 
 using namespace QuantLib;
 
 
-Real priceMulticurveBootstrappingSwap(const std::vector<Real>& depos,
-                                      const Calendar& calendar,
-                                      const std::vector<Real>& shortOis,
-                                      const std::vector<Real>& datesOIS,
-                                      const std::vector<Real>& longTermOIS,
-                                      Date todaysDate,
-                                      const DayCounter& termStructureDayCounter,
-                                      Real d6MRate,
-                                      const std::vector<Real>& fra,
-                                      const std::vector<Real>& swapRates,
-                                      Date settlementDate,
-                                      Date maturity,
-                                      Real nominal,
-                                      Real fixedRate,
-                                      Real spread,
-                                      Integer lengthInYears) {
+typedef PiecewiseYieldCurve<Discount, Cubic> BootstrappedCurve;
+
+ext::shared_ptr<BootstrappedCurve> bootstrapEonia(const std::vector<Real>& depos,
+                                                  const Calendar& calendar,
+                                                  const std::vector<Real>& shortOis,
+                                                  const std::vector<Real>& datesOIS,
+                                                  const std::vector<Real>& longTermOIS,
+                                                  Date todaysDate,
+                                                  const DayCounter& termStructureDayCounter) {
     auto eonia = ext::make_shared<Eonia>();
     std::vector<ext::shared_ptr<RateHelper>> eoniaInstruments;
     // deposits
@@ -159,13 +168,21 @@ Real priceMulticurveBootstrappingSwap(const std::vector<Real>& depos,
         todaysDate, eoniaInstruments, termStructureDayCounter);
 
     eoniaTermStructure->enableExtrapolation();
+    return eoniaTermStructure;
+}
 
-    // This curve will be used for discounting cash flows
-    RelinkableHandle<YieldTermStructure> discountingTermStructure;
-    discountingTermStructure.linkTo(eoniaTermStructure);
-
+ext::shared_ptr<BootstrappedCurve>
+bootstrapEuribor6M(const Calendar& calendar,
+                   Real d6MRate,
+                   const std::vector<Real>& fra,
+                   const std::vector<Real>& swapRates,
+                   Date settlementDate,
+                   const DayCounter& termStructureDayCounter,
+                   const Handle<YieldTermStructure>& discountingTermStructure) {
     std::vector<ext::shared_ptr<RateHelper>> euribor6MInstruments;
 
+    DayCounter depositDayCounter = Actual360();
+
     auto euribor6M = ext::make_shared<Euribor6M>();
 
     auto d6M = ext::make_shared<DepositRateHelper>(
@@ -227,12 +244,20 @@ Real priceMulticurveBootstrappingSwap(const std::vector<Real>& depos,
         euribor6MInstruments.push_back(helper);
     }
     double tolerance = 1.0e-15;
-    auto euribor6MTermStructure = ext::make_shared<PiecewiseYieldCurve<Discount, Cubic>>(
-        settlementDate, euribor6MInstruments, termStructureDayCounter,
-        PiecewiseYieldCurve<Discount, Cubic>::bootstrap_type(tolerance));
+    return ext::make_shared<BootstrappedCurve>(settlementDate, euribor6MInstruments,
+                                               termStructureDayCounter,
+                                               BootstrappedCurve::bootstrap_type(tolerance));
+}
 
-    RelinkableHandle<YieldTermStructure> forecastingTermStructure;
-    forecastingTermStructure.linkTo(euribor6MTermStructure);
+Real priceSwap(const Handle<YieldTermStructure>& discountingTermStructure,
+               const Handle<YieldTermStructure>& forecastingTermStructure,
+               const Calendar& calendar,
+               Date settlementDate,
+               Date maturity,
+               Real nominal,
+               Real fixedRate,
+               Real spread,
+               Integer lengthInYears) {
     auto euriborIndex = ext::make_shared<Euribor6M>(forecastingTermStructure);
     Schedule fixedSchedule(settlementDate, maturity, Period(Annual), calendar, Unadjusted,
                            Unadjusted, DateGeneration::Forward, false);
@@ -251,7 +276,6 @@ Real priceMulticurveBootstrappingSwap(const std::vector<Real>& depos,
     VanillaSwap oneYearForward5YearSwap(Swap::Payer, nominal, fwdFixedSchedule, fixedRate,
                                         Thirty360(Thirty360::European), fwdFloatSchedule,
                                         euriborIndex, spread, Actual360());
-    auto s5yRate = swapQuotes[5 * Years];
     ext::shared_ptr<PricingEngine> swapEngine(new DiscountingSwapEngine(discountingTermStructure));
 
     spot5YearSwap.setPricingEngine(swapEngine);
@@ -260,90 +284,239 @@ Real priceMulticurveBootstrappingSwap(const std::vector<Real>& depos,
     return spot5YearSwap.NPV();
 }
 
+Real priceMulticurveBootstrappingSwap(const std::vector<Real>& depos,
+                                      const Calendar& calendar,
+                                      const std::vector<Real>& shortOis,
+                                      const std::vector<Real>& datesOIS,
+                                      const std::vector<Real>& longTermOIS,
+                                      Date todaysDate,
+                                      const DayCounter& termStructureDayCounter,
+                                      Real d6MRate,
+                                      const std::vector<Real>& fra,
+                                      const std::vector<Real>& swapRates,
+                                      Date settlementDate,
+                                      Date maturity,
+                                      Real nominal,
+                                      Real fixedRate,
+                                      Real spread,
+                                      Integer lengthInYears) {
+    // This curve will be used for discounting cash flows
+    RelinkableHandle<YieldTermStructure> discountingTermStructure;
+    discountingTermStructure.linkTo(bootstrapEonia(depos, calendar, shortOis, datesOIS,
+                                                   longTermOIS, todaysDate,
+                                                   termStructureDayCounter));
+
+    RelinkableHandle<YieldTermStructure> forecastingTermStructure;
+    forecastingTermStructure.linkTo(bootstrapEuribor6M(calendar, d6MRate, fra, swapRates,
+                                                       settlementDate, termStructureDayCounter,
+                                                       discountingTermStructure));
+
+    return priceSwap(discountingTermStructure, forecastingTermStructure, calendar,
+                     settlementDate, maturity, nominal, fixedRate, spread, lengthInYears);
+}
+
 #ifndef QLRISKS_DISABLE_AAD
 
 // create tape
 using tape_type = Real::tape_type;
 tape_type tape;
 
-Real priceWithSensi(const std::vector<Real>& depos,
-                    const Calendar& calendar,
-                    const std::vector<Real>& shortOis,
-                    const std::vector<Real>& datesOIS,
-                    const std::vector<Real>& longTermOIS,
-                    Date todaysDate,
-                    const DayCounter& termStructureDayCounter,
-                    Real d6MRate,
-                    const std::vector<Real>& fra,
-                    const std::vector<Real>& swapRates,
-                    Date settlementDate,
-                    Date maturity,
-                    Real nominal,
-                    Real fixedRate,
-                    Real spread,
-                    Integer lengthInYears,
-                    std::vector<Real>& gradient) {
-    // clear the tape and gradient to allow for re-running this in a loop
-    tape.clearAll();
-    gradient.clear();
-
-    // copy independent variables and register them with the tape
-    auto depos_t = depos;
-    auto shortOis_t = shortOis;
-    auto datesOIS_t = datesOIS;
-    auto longTermOIS_t = longTermOIS;
-    auto swapRates_t = swapRates;
-    auto fra_t = fra;
-    tape.registerInputs(depos_t);
-    tape.registerInputs(shortOis_t);
-    tape.registerInputs(datesOIS_t);
-    tape.registerInputs(longTermOIS_t);
-    tape.registerInputs(swapRates_t);
-    tape.registerInputs(fra_t);
-    tape.registerInput(fixedRate);
-    tape.registerInput(spread);
-    tape.registerInput(nominal);
-    tape.registerInput(d6MRate);
-    tape.newRecording();
-
-    Real value = priceMulticurveBootstrappingSwap(
-        depos_t, calendar, shortOis_t, datesOIS_t, longTermOIS_t, todaysDate,
-        termStructureDayCounter, d6MRate, fra_t, swapRates_t, settlementDate, maturity, nominal,
-        fixedRate, spread, lengthInYears);
-
-    // register output, set its adjoint, and roll-back the tape
-    tape.registerOutput(value);
-    derivative(value) = 1.0;
-    tape.computeAdjoints();
-
-    // obtain the sensitivities (input adjonits)
-    for (auto& g : depos_t)
-        gradient.push_back(derivative(g));
+// the quotes and swap terms registered as risk factors of a risk engine, set up once and
+// calculated again for each run
+class MulticurveSensiPricer {
+  public:
+    MulticurveSensiPricer(const std::vector<Real>& depos,
+                          const std::vector<Real>& shortOis,
+                          const std::vector<Real>& datesOIS,
+                          const std::vector<Real>& longTermOIS,
+                          Real d6MRate,
+                          const std::vector<Real>& fra,
+                          const std::vector<Real>& swapRates,
+                          Real nominal,
+                          Real fixedRate,
+                          Real spread)
+    : depos_(depos), shortOis_(shortOis), datesOIS_(datesOIS), longTermOIS_(longTermOIS),
+      swapRates_(swapRates), fra_(fra), fixedRate_(fixedRate), spread_(spread),
+      nominal_(nominal), d6MRate_(d6MRate), engine_(tape) {
+        engine_.addFactors("depos", depos_);
+        engine_.addFactors("shortOis", shortOis_);
+        engine_.addFactors("datesOIS", datesOIS_);
+        engine_.addFactors("longTermOIS", longTermOIS_);
+        engine_.addFactors("swapRates", swapRates_);
+        engine_.addFactors("fra", fra_);
+        engine_.addFactor("fixedRate", fixedRate_);
+        engine_.addFactor("spread", spread_);
+        engine_.addFactor("nominal", nominal_);
+        engine_.addFactor("d6MRate", d6MRate_);
+    }
 
-    for (auto& g : shortOis_t)
-        gradient.push_back(derivative(g));
+    Real calculate(std::vector<Real>& gradient) {
+        Real value = engine_.calculate()[0];
 
-    for (auto& g : datesOIS_t)
-        gradient.push_back(derivative(g));
+        // obtain the sensitivities (input adjoints), in registration order
+        auto sensitivities = engine_.sensitivities();
+        gradient.assign(sensitivities.begin(), sensitivities.end());
 
-    for (auto& g : longTermOIS_t)
-        gradient.push_back(derivative(g));
+        return value;
+    }
 
-    for (auto& g : swapRates_t)
-        gradient.push_back(derivative(g));
+  protected:
+    std::vector<Real> depos_, shortOis_, datesOIS_, longTermOIS_, swapRates_, fra_;
+    Real fixedRate_, spread_, nominal_, d6MRate_;
+    RiskEngine engine_;
+};
+
+class SensiPricer : public MulticurveSensiPricer {
+  public:
+    SensiPricer(const std::vector<Real>& depos,
+                const Calendar& calendar,
+                const std::vector<Real>& shortOis,
+                const std::vector<Real>& datesOIS,
+                const std::vector<Real>& longTermOIS,
+                Date todaysDate,
+                const DayCounter& termStructureDayCounter,
+                Real d6MRate,
+                const std::vector<Real>& fra,
+                const std::vector<Real>& swapRates,
+                Date settlementDate,
+                Date maturity,
+                Real nominal,
+                Real fixedRate,
+                Real spread,
+                Integer lengthInYears)
+    : MulticurveSensiPricer(
+          depos, shortOis, datesOIS, longTermOIS, d6MRate, fra, swapRates, nominal, fixedRate,
+          spread) {
+        engine_.addPricer([=]() {
+            return priceMulticurveBootstrappingSwap(
+                depos_, calendar, shortOis_, datesOIS_, longTermOIS_, todaysDate,
+                termStructureDayCounter, d6MRate_, fra_, swapRates_, settlementDate, maturity,
+                nominal_, fixedRate_, spread_, lengthInYears);
+        });
+    }
+};
 
-    for (auto& g : fra_t)
-        gradient.push_back(derivative(g));
+std::vector<Real> concat(std::initializer_list<const std::vector<Real>*> parts) {
+    std::vector<Real> result;
+    for (const auto* p : parts)
+        result.insert(result.end(), p->begin(), p->end());
+    return result;
+}
 
+std::vector<double> values(const std::vector<Real>& x) {
+    std::vector<double> result;
+    for (const auto& xi : x)
+        result.push_back(xad::value(xi));
+    return result;
+}
 
-    gradient.push_back(derivative(fixedRate));
-    gradient.push_back(derivative(spread));
-    gradient.push_back(derivative(nominal));
-    gradient.push_back(derivative(d6MRate));
+// a file in the temporary directory, where the curve snapshots are kept between runs
+std::string temporaryPath(const std::string& name) {
+    for (const char* variable : {"TMPDIR", "TEMP", "TMP"}) {
+        const char* dir = std::getenv(variable);
+        if (dir != nullptr && *dir != '\0')
+            return std::string(dir) + "/" + name;
+    }
+#ifdef _WIN32
+    return name;
+#else
+    return "/tmp/" + name;
+#endif
+}
 
-    return value;
+// the snapshot in the file if it was taken for this curve and these quotes, else a new
+// one, saved
+template <class Builder>
+CurveSnapshot snapshotFor(const std::string& path,
+                          const Builder& build,
+                          const std::vector<Real>& quotes,
+                          const Date& referenceDate,
+                          const std::string& conventions) {
+    CurveSnapshot snapshot;
+    std::vector<double> q = values(quotes);
+    if (!loadCurveSnapshot(path, curveSnapshotKey(q, referenceDate, conventions), snapshot)) {
+        snapshot = takeCurveSnapshot(build, q, conventions);
+        saveCurveSnapshot(path, snapshot);
+    }
+    return snapshot;
 }
 
+/* As SensiPricer, but with the curves restored from snapshots of their nodes and
+ * bootstrap Jacobians instead of bootstrapped, for a warm start on the same quotes.
+ * The snapshots are taken and saved on construction, unless a previous process saved
+ * them for the same quotes, and every calculation restores them.
+ */
+class SnapshotSensiPricer : public MulticurveSensiPricer {
+  public:
+    SnapshotSensiPricer(const std::vector<Real>& depos,
+                        const Calendar& calendar,
+                        const std::vector<Real>& shortOis,
+                        const std::vector<Real>& datesOIS,
+                        const std::vector<Real>& longTermOIS,
+                        Date todaysDate,
+                        const DayCounter& termStructureDayCounter,
+                        Real d6MRate,
+                        const std::vector<Real>& fra,
+                        const std::vector<Real>& swapRates,
+                        Date settlementDate,
+                        Date maturity,
+                        Real nominal,
+                        Real fixedRate,
+                        Real spread,
+                        Integer lengthInYears)
+    : MulticurveSensiPricer(
+          depos, shortOis, datesOIS, longTermOIS, d6MRate, fra, swapRates, nominal, fixedRate,
+          spread) {
+        // the Eonia quotes, then the Euribor ones, which also depend on the Eonia curve
+        const Size nEonia =
+            depos.size() + shortOis.size() + datesOIS.size() + longTermOIS.size();
+        auto split = [&](const std::vector<Real>& q, Size& k, Size n) {
+            k += n;
+            return std::vector<Real>(q.begin() + (k - n), q.begin() + k);
+        };
+        auto eoniaFrom = [&](const std::vector<Real>& q) {
+            Size k = 0;
+            auto d = split(q, k, depos.size()), s = split(q, k, shortOis.size()),
+                 o = split(q, k, datesOIS.size()), l = split(q, k, longTermOIS.size());
+            return bootstrapEonia(d, calendar, s, o, l, todaysDate, termStructureDayCounter);
+        };
+        auto euriborFrom = [&](const std::vector<Real>& q) {
+            Handle<YieldTermStructure> discounting(eoniaFrom(q));
+            Size k = nEonia;
+            Real d6M = split(q, k, 1)[0];
+            auto f = split(q, k, fra.size()), s = split(q, k, swapRates.size());
+            return bootstrapEuribor6M(calendar, d6M, f, s, settlementDate,
+                                      termStructureDayCounter, discounting);
+        };
+
+        std::vector<Real> d6M = {d6MRate};
+        CurveSnapshot eoniaSnapshot =
+            snapshotFor(temporaryPath("AdjointMulticurveBootstrappingXAD.eonia.snapshot"),
+                        eoniaFrom, concat({&depos, &shortOis, &datesOIS, &longTermOIS}),
+                        todaysDate, "eonia;discount cubic;" + termStructureDayCounter.name());
+        CurveSnapshot euriborSnapshot = snapshotFor(
+            temporaryPath("AdjointMulticurveBootstrappingXAD.euribor6m.snapshot"), euriborFrom,
+            concat({&depos, &shortOis, &datesOIS, &longTermOIS, &d6M, &fra, &swapRates}),
+            settlementDate, "euribor6m;discount cubic;" + termStructureDayCounter.name());
+
+        engine_.addPricer([this, eoniaSnapshot, euriborSnapshot, termStructureDayCounter,
+                           calendar, settlementDate, maturity, lengthInYears]() {
+            std::vector<Real> d6M_t = {d6MRate_};
+            auto eoniaQuotes = concat({&depos_, &shortOis_, &datesOIS_, &longTermOIS_});
+            auto euriborQuotes = concat(
+                {&depos_, &shortOis_, &datesOIS_, &longTermOIS_, &d6M_t, &fra_, &swapRates_});
+            auto eoniaCurve = restoreCurve<InterpolatedDiscountCurve<Cubic>>(
+                eoniaSnapshot, eoniaQuotes, termStructureDayCounter);
+            eoniaCurve->enableExtrapolation();
+            auto euriborCurve = restoreCurve<InterpolatedDiscountCurve<Cubic>>(
+                euriborSnapshot, euriborQuotes, termStructureDayCounter);
+            return priceSwap(Handle<YieldTermStructure>(eoniaCurve),
+                             Handle<YieldTermStructure>(euriborCurve), calendar, settlementDate,
+                             maturity, nominal_, fixedRate_, spread_, lengthInYears);
+        });
+    }
+};
+
 
 #else
 
@@ -465,6 +638,41 @@ Real priceWithSensi(const std::vector<Real>& depos,
 }
 
 
+// the same interface as the AAD build, bumping all inputs for each calculation
+class SensiPricer {
+  public:
+    SensiPricer(const std::vector<Real>& depos,
+                const Calendar& calendar,
+                const std::vector<Real>& shortOis,
+                const std::vector<Real>& datesOIS,
+                const std::vector<Real>& longTermOIS,
+                Date todaysDate,
+                const DayCounter& termStructureDayCounter,
+                Real d6MRate,
+                const std::vector<Real>& fra,
+                const std::vector<Real>& swapRates,
+                Date settlementDate,
+                Date maturity,
+                Real nominal,
+                Real fixedRate,
+                Real spread,
+                Integer lengthInYears)
+    : calculate_([=](std::vector<Real>& gradient) {
+          return priceWithSensi(depos, calendar, shortOis, datesOIS, longTermOIS, todaysDate,
+                                termStructureDayCounter, d6MRate, fra, swapRates,
+                                settlementDate, maturity, nominal, fixedRate, spread,
+                                lengthInYears, gradient);
+      }) {}
+
+    Real calculate(std::vector<Real>& gradient) const {
+        gradient.clear();
+        return calculate_(gradient);
+    }
+
+  private:
+    std::function<Real(std::vector<Real>&)> calculate_;
+};
+
 #endif
 
 
@@ -574,11 +782,13 @@ int main(int, char*[]) {
         std::vector<Real> gradient;
         std::cout << "Pricing swap with multicurve bootstrapping with sensitivities...\n";
         Real v2 = 0.0;
+        SensiPricer sensiPricer(depos, calendar, shortOis, datesOIS, longTermOIS, todaysDate,
+                                termStructureDayCounter, d6MRate, fra, swapRates,
+                                settlementDate, maturity, nominal, fixedRate, spread,
+                                lengthInYears);
         start = std::chrono::high_resolution_clock::now();
         for (int i = 0; i < N; ++i) {
-            v2 = priceWithSensi(depos, calendar, shortOis, datesOIS, longTermOIS, todaysDate,
-                                termStructureDayCounter, d6MRate, fra, swapRates, settlementDate,
-                                maturity, nominal, fixedRate, spread, lengthInYears, gradient);
+            v2 = sensiPricer.calculate(gradient);
         }
         end = std::chrono::high_resolution_clock::now();
         auto time_sensi =
@@ -592,6 +802,54 @@ int main(int, char*[]) {
         std::cout << "Plain time : " << time_plain << "ms\n"
                   << "Sensi time : " << time_sensi << "ms\n"
                   << "Factor     : " << time_sensi / time_plain << "x\n";
+
+        // hardware event and allocation counts of the pricing phases, with
+        // QLRISKS_ENABLE_PERF_COUNTERS or QLRISKS_ENABLE_ALLOCATION_HOOKS, from one more run
+        // of each, as reading the counters around the timed runs would skew the timings
+        PerfProfile profile;
+        if (profile.available()) {
+            {
+                PerfPhase phase("plain");
+                priceMulticurveBootstrappingSwap(depos, calendar, shortOis, datesOIS, longTermOIS,
+                                                 todaysDate, termStructureDayCounter, d6MRate,
+                                                 fra, swapRates, settlementDate, maturity,
+                                                 nominal, fixedRate, spread, lengthInYears);
+            }
+            {
+                PerfPhase phase("sensi");
+                sensiPricer.calculate(gradient);
+            }
+            std::cout << profile;
+        }
+
+#ifndef QLRISKS_DISABLE_AAD
+        // the pricer bootstraps and saves the curve snapshots, unless a previous process
+        // did so for the same quotes; the timed runs restore them
+        std::cout << "Pricing swap with curves restored from snapshots...\n";
+        std::vector<Real> snapshotGradient;
+        Real v3 = 0.0;
+        SnapshotSensiPricer snapshotPricer(depos, calendar, shortOis, datesOIS, longTermOIS,
+                                           todaysDate, termStructureDayCounter, d6MRate, fra,
+                                           swapRates, settlementDate, maturity, nominal,
+                                           fixedRate, spread, lengthInYears);
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < N; ++i) {
+            v3 = snapshotPricer.calculate(snapshotGradient);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        auto time_snapshot =
+            static_cast<double>(
+                std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()) *
+            1e-3 / N;
+        double maxDifference = 0.0;
+        for (Size i = 0; i < gradient.size(); ++i)
+            maxDifference = std::max(maxDifference,
+                                     std::fabs(xad::value(snapshotGradient[i] - gradient[i])));
+        std::cout << "Value                    = " << v3 << "\n"
+                  << "Max sensitivity change   = " << maxDifference << "\n"
+                  << "Snapshot time : " << time_snapshot << "ms\n"
+                  << "Factor        : " << time_snapshot / time_plain << "x\n";
+#endif
         return 0;
     } catch (std::exception& e) {
         std::cerr << e.what() << std::endl;
@@ -36,15 +36,28 @@ When QLRISKS_DISABLE_AAD is ON, it calculates the sensitivities using finite dif
 #include <ql/pricingengines/barrier/analyticbarrierengine.hpp>
 #include <ql/pricingengines/vanilla/analyticeuropeanengine.hpp>
 #include <ql/quotes/simplequote.hpp>
+#include <ql/risks/admode.hpp>
+#include <ql/risks/hybridsensitivities.hpp>
+#include <ql/risks/perfcounters.hpp>
+#include <ql/risks/riskengine.hpp>
+#include <ql/risks/risksession.hpp>
+#include <ql/risks/staticreplication.hpp>
 #include <ql/termstructures/volatility/equityfx/blackconstantvol.hpp>
 #include <ql/termstructures/yield/flatforward.hpp>
 #include <ql/termstructures/yield/zerocurve.hpp>
 #include <ql/time/calendars/nullcalendar.hpp>
 #include <chrono>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <vector>
 
+// counts the heap allocations of the pricing phases, with QLRISKS_ENABLE_ALLOCATION_HOOKS
+QLRISKS_DEFINE_ALLOCATION_HOOKS
+
+// per-thread sessions, with QuantLib built with QL_ENABLE_SESSIONS
+QLRISKS_DEFINE_SESSION_ID
+
 using namespace QuantLib;
 
 
@@ -162,61 +175,177 @@ Real pricePortfolio(const std::vector<Date>& dates,
     return portfolioValue;
 }
 
+// Same replication, but with all hedge notionals chosen in one least-squares fit over a grid
+// of points on the barrier, rather than killing the portfolio value point by point.
+// The grid has M points per hedge maturity interval.
+Real pricePortfolioLeastSquares(const std::vector<Date>& dates,
+                                const std::vector<Real>& riskFreeRates,
+                                const DayCounter& dayCounter,
+                                Date maturity,
+                                Real strike,
+                                Option::Type type,
+                                Real underlying,
+                                Real v,
+                                Real barrier,
+                                Integer B,
+                                Integer t,
+                                Integer M,
+                                TimeUnit timeUnit,
+                                Date& today,
+                                std::vector<Real>& notionals) {
+    auto underlyingH = ext::make_shared<SimpleQuote>(underlying);
+    auto volatility = ext::make_shared<SimpleQuote>(v);
+    Handle<Quote> h2(volatility);
 
-#ifndef QLRISKS_DISABLE_AAD
+    Handle<YieldTermStructure> ratesYield(
+        ext::make_shared<ZeroCurve>(dates, riskFreeRates, dayCounter));
+    Handle<BlackVolTermStructure> flatVol(
+        ext::make_shared<BlackConstantVol>(0, NullCalendar(), h2, dayCounter));
 
-// create tape
-using tape_type = Real::tape_type;
-tape_type tape;
+    auto exercise = ext::make_shared<EuropeanExercise>(maturity);
+    auto bsProcess =
+        ext::make_shared<BlackScholesProcess>(Handle<Quote>(underlyingH), ratesYield, flatVol);
+    auto europeanEngine = ext::make_shared<AnalyticEuropeanEngine>(bsProcess);
 
+    // the target: a put struck at K minus a digital put and a put struck at B
+    auto target = ext::make_shared<CompositeInstrument>();
+    auto put1 = ext::make_shared<EuropeanOption>(
+        ext::make_shared<PlainVanillaPayoff>(type, strike), exercise);
+    put1->setPricingEngine(europeanEngine);
+    target->add(put1);
+    auto digitalPut = ext::make_shared<EuropeanOption>(
+        ext::make_shared<CashOrNothingPayoff>(Option::Put, barrier, 1.0), exercise);
+    digitalPut->setPricingEngine(europeanEngine);
+    target->subtract(digitalPut, strike - barrier);
+    auto put2 = ext::make_shared<EuropeanOption>(
+        ext::make_shared<PlainVanillaPayoff>(Option::Put, barrier), exercise);
+    put2->setPricingEngine(europeanEngine);
+    target->subtract(put2);
+
+    // the hedges: puts struck at B, maturing every t time units
+    std::vector<ext::shared_ptr<Instrument>> hedges;
+    for (Integer i = t; i <= B * t; i += t) {
+        auto putn = ext::make_shared<EuropeanOption>(
+            ext::make_shared<PlainVanillaPayoff>(Option::Put, barrier),
+            ext::make_shared<EuropeanExercise>(today + i * timeUnit));
+        putn->setPricingEngine(europeanEngine);
+        hedges.push_back(putn);
+    }
 
-Real priceWithSensi(const std::vector<Date>& dates,
-                    const std::vector<Real>& riskFreeRates,
-                    const DayCounter& dayCounter,
-                    Date maturity,
-                    Real strike,
-                    Option::Type type,
-                    Barrier::Type barrierType,
-                    Real underlying,
-                    Real v,
-                    Real barrier,
-                    Real rebate,
-                    Integer B,
-                    Integer t,
-                    TimeUnit timeUnit,
-                    Date today,
-                    std::vector<Real>& gradient) {
-    tape.clearAll();
+    // the grid: M dates on the barrier in each interval between hedge maturities
+    std::vector<StaticReplication::GridPoint> grid;
+    for (Integer i = 0; i < B * t; i += t) {
+        Date start = today + i * timeUnit;
+        Date end = today + (i + t) * timeUnit;
+        for (Integer k = 0; k < M; ++k)
+            grid.push_back({start + ((end - start) * k) / M, barrier});
+    }
 
-    auto riskFreeRates_t = riskFreeRates;
+    StaticReplication replication(underlyingH, grid);
+    Array w = replication.notionals(target, hedges);
 
-    tape.registerInputs(riskFreeRates_t);
-    tape.registerInput(strike);
-    tape.registerInput(v);
-    tape.registerInput(underlying);
-    tape.registerInput(barrier);
-    tape.newRecording();
+    notionals.assign(w.begin(), w.end());
+    for (Size j = 0; j < hedges.size(); ++j)
+        target->subtract(hedges[j], w[j]);
+    return target->NPV();
+}
 
-    Real value = pricePortfolio(dates, riskFreeRates_t, dayCounter, maturity, strike, type,
-                                barrierType, underlying, v, barrier, rebate, B, t, timeUnit, today);
 
-    // get the values
-    tape.registerOutput(value);
-    derivative(value) = 1.0;
-    tape.computeAdjoints();
+#ifndef QLRISKS_DISABLE_AAD
 
-    gradient.clear();
-    for (std::size_t i = 0; i < riskFreeRates_t.size(); ++i) {
-        gradient.push_back(derivative(riskFreeRates_t[i]));
+// create tape
+using tape_type = Real::tape_type;
+tape_type tape;
+
+
+// the rates, strike, vol, underlying and barrier are registered as risk factors once, and
+// each calculation records the pricer again into the buffers of the risk engine
+class SensiPricer {
+  public:
+    SensiPricer(const std::vector<Date>& dates,
+                const std::vector<Real>& riskFreeRates,
+                const DayCounter& dayCounter,
+                Date maturity,
+                Real strike,
+                Option::Type type,
+                Barrier::Type barrierType,
+                Real underlying,
+                Real v,
+                Real barrier,
+                Real rebate,
+                Integer B,
+                Integer t,
+                TimeUnit timeUnit,
+                Date today)
+    : riskFreeRates_(riskFreeRates), strike_(strike), v_(v), underlying_(underlying),
+      barrier_(barrier), engine_(tape) {
+        engine_.addFactors("rates", riskFreeRates_);
+        engine_.addFactor("strike", strike_);
+        engine_.addFactor("vol", v_);
+        engine_.addFactor("underlying", underlying_);
+        engine_.addFactor("barrier", barrier_);
+
+        engine_.addPricer([=]() {
+            return pricePortfolio(dates, riskFreeRates_, dayCounter, maturity, strike_, type,
+                                  barrierType, underlying_, v_, barrier_, rebate, B, t,
+                                  timeUnit, today);
+        });
     }
-    gradient.push_back(derivative(strike));
-    gradient.push_back(derivative(v));
-    gradient.push_back(derivative(underlying));
-    gradient.push_back(derivative(barrier));
 
-    return value;
-}
+    Real calculate(std::vector<Real>& gradient) {
+        Real value = engine_.calculate()[0];
+        auto sensitivities = engine_.sensitivities();
+        gradient.assign(sensitivities.begin(), sensitivities.end());
+        return value;
+    }
 
+  private:
+    std::vector<Real> riskFreeRates_;
+    Real strike_, v_, underlying_, barrier_;
+    RiskEngine engine_;
+};
+
+
+// Jacobian of the least-squares replication value and hedge notionals with respect to
+// the market inputs, from one recording and one adjoint sweep per output
+std::vector<double> priceHedgeWithSensi(const std::vector<Date>& dates,
+                                        const std::vector<Real>& riskFreeRates,
+                                        const DayCounter& dayCounter,
+                                        Date maturity,
+                                        Real strike,
+                                        Option::Type type,
+                                        Real underlying,
+                                        Real v,
+                                        Real barrier,
+                                        Integer B,
+                                        Integer t,
+                                        Integer M,
+                                        TimeUnit timeUnit,
+                                        Date today,
+                                        std::vector<double>& jacobian) {
+    // inputs: rates, strike, vol, underlying, barrier
+    std::vector<double> inputs;
+    for (auto& r : riskFreeRates)
+        inputs.push_back(value(r));
+    inputs.push_back(value(strike));
+    inputs.push_back(value(v));
+    inputs.push_back(value(underlying));
+    inputs.push_back(value(barrier));
+    Size nRates = riskFreeRates.size();
+
+    // outputs: portfolio value, followed by the hedge notionals
+    auto task = [&](const std::vector<Real>& x) {
+        std::vector<Real> rates(x.begin(), x.begin() + nRates);
+        std::vector<Real> notionals;
+        Real npv = pricePortfolioLeastSquares(
+            dates, rates, dayCounter, maturity, x[nRates], type, x[nRates + 2], x[nRates + 1],
+            x[nRates + 3], B, t, M, timeUnit, today, notionals);
+        notionals.insert(notionals.begin(), npv);
+        return notionals;
+    };
+
+    return computeJacobian(task, inputs, ADMode::VectorReverse, jacobian);
+}
 
 #else
 
@@ -272,6 +401,36 @@ Real priceWithSensi(const std::vector<Date>& dates,
     return value;
 }
 
+// same interface as with AAD
+class SensiPricer {
+  public:
+    SensiPricer(const std::vector<Date>& dates,
+                const std::vector<Real>& riskFreeRates,
+                const DayCounter& dayCounter,
+                Date maturity,
+                Real strike,
+                Option::Type type,
+                Barrier::Type barrierType,
+                Real underlying,
+                Real v,
+                Real barrier,
+                Real rebate,
+                Integer B,
+                Integer t,
+                TimeUnit timeUnit,
+                Date today)
+    : calculate_([=](std::vector<Real>& gradient) {
+          return priceWithSensi(dates, riskFreeRates, dayCounter, maturity, strike, type,
+                                barrierType, underlying, v, barrier, rebate, B, t, timeUnit,
+                                today, gradient);
+      }) {}
+
+    Real calculate(std::vector<Real>& gradient) { return calculate_(gradient); }
+
+  private:
+    std::function<Real(std::vector<Real>&)> calculate_;
+};
+
 #endif
 
 void printResults(Real v, const std::vector<Real>& gradient, Size nRates) {
@@ -287,6 +446,44 @@ void printResults(Real v, const std::vector<Real>& gradient, Size nRates) {
     std::cout << "Barrier            = " << gradient[nRates + 3] << "\n";
 }
 
+// sensitivities of the barrier option itself, with the barrier level bumped and all other
+// inputs from one AAD pass - engines monitoring the barrier on a grid or on paths give no
+// useful adjoint for it
+Real priceBarrierOptionWithSensi(std::vector<Date>& dates,
+                                 std::vector<Real>& rates,
+                                 DayCounter& dayCounter,
+                                 Date& maturity,
+                                 Real strike,
+                                 Option::Type type,
+                                 Barrier::Type barrierType,
+                                 Real underlying,
+                                 Real v,
+                                 Real barrier,
+                                 Real rebate,
+                                 std::vector<Real>& gradient) {
+    // inputs: rates, strike, vol, underlying, barrier
+    std::vector<double> inputs;
+    for (auto& r : rates)
+        inputs.push_back(xad::value(r));
+    for (auto x : {strike, v, underlying, barrier})
+        inputs.push_back(xad::value(x));
+    std::vector<SensitivityMethod> methods(inputs.size(), SensitivityMethod::Adjoint);
+    methods.back() = SensitivityMethod::Bump;
+
+    Size nRates = rates.size();
+    auto pricer = [&](const std::vector<Real>& x) {
+        std::vector<Real> r(x.begin(), x.begin() + nRates);
+        Real k = x[nRates], vol = x[nRates + 1], s = x[nRates + 2], b = x[nRates + 3];
+        return priceBarrierOption(dates, r, dayCounter, maturity, k, type, barrierType, s, vol,
+                                  b, rebate);
+    };
+
+    std::vector<double> g;
+    double value = computeHybridGradient(pricer, inputs, methods, g);
+    gradient.assign(g.begin(), g.end());
+    return value;
+}
+
 int main() {
     try {
         std::cout << std::endl;
@@ -329,6 +526,13 @@ int main() {
 
         std::cout << "Original barrier option value : " << value << "\n";
 
+        std::vector<Real> barrierGradient;
+        std::cout << "Barrier option sensitivities (barrier bumped, others adjoint):\n";
+        printResults(priceBarrierOptionWithSensi(dates, rates, dayCounter, maturity, strike, type,
+                                                 barrierType, underlying, v, barrier, rebate,
+                                                 barrierGradient),
+                     barrierGradient, rates.size());
+
         // pricing a portfolio of a barrier option without AAD
         int B = 26;                // number of dates
         int t = 2;                 // number of the repetition of time unit
@@ -355,10 +559,11 @@ int main() {
         std::vector<Real> gradient;
         std::cout << "Pricing replication portfolio with sensitivities...\n";
         Real v2 = 0.0;
+        SensiPricer sensiPricer(dates, rates, dayCounter, maturity, strike, type, barrierType,
+                                underlying, v, barrier, rebate, B, t, timeUnit, today);
         start = std::chrono::high_resolution_clock::now();
         for (int i = 0; i < N; ++i) {
-            v2 = priceWithSensi(dates, rates, dayCounter, maturity, strike, type, barrierType,
-                                underlying, v, barrier, rebate, B, t, timeUnit, today, gradient);
+            v2 = sensiPricer.calculate(gradient);
         }
         end = std::chrono::high_resolution_clock::now();
         auto time_sensi =
@@ -373,6 +578,45 @@ int main() {
                   << "Sensi time : " << time_sensi << "ms\n"
                   << "Factor     : " << time_sensi / time_plain << "x\n";
 
+        // hardware event and allocation counts of the pricing phases, with
+        // QLRISKS_ENABLE_PERF_COUNTERS or QLRISKS_ENABLE_ALLOCATION_HOOKS, from one more run
+        // of each, as reading the counters around the timed runs would skew the timings
+        PerfProfile profile;
+        if (profile.available()) {
+            {
+                PerfPhase phase("plain");
+                pricePortfolio(dates, rates, dayCounter, maturity, strike, type, barrierType,
+                               underlying, v, barrier, rebate, B, t, timeUnit, today);
+            }
+            {
+                PerfPhase phase("sensi");
+                sensiPricer.calculate(gradient);
+            }
+            std::cout << profile;
+        }
+
+        // least-squares replication over a grid with 2 points per hedge maturity
+        int M = 2;
+        std::vector<Real> notionals;
+        Real v3 = pricePortfolioLeastSquares(dates, rates, dayCounter, maturity, strike, type,
+                                             underlying, v, barrier, B, t, M, timeUnit, today,
+                                             notionals);
+        std::cout << "Least-squares replication value = " << v3 << "\n";
+
+#ifndef QLRISKS_DISABLE_AAD
+        std::vector<double> jacobian;
+        auto hedge = priceHedgeWithSensi(dates, rates, dayCounter, maturity, strike, type,
+                                         underlying, v, barrier, B, t, M, timeUnit, today,
+                                         jacobian);
+        Size nInputs = rates.size() + 4;
+        std::cout << "Hedge notionals and their vega / barrier sensitivities:\n";
+        for (Size j = 1; j < hedge.size(); ++j) {
+            std::cout << "  notional #" << j << " = " << hedge[j]
+                      << ", d/dvol = " << jacobian[j * nInputs + rates.size() + 1]
+                      << ", d/dbarrier = " << jacobian[j * nInputs + rates.size() + 3] << "\n";
+        }
+#endif
+
         return 0;
     } catch (std::exception& e) {
         std::cerr << e.what() << std::endl;
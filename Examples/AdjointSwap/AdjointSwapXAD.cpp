@@ -34,6 +34,15 @@ either with XAD or with plain doubles and bumping (when QLRISKS_DISABLE_AAD is O
 #include <ql/math/randomnumbers/mt19937uniformrng.hpp>
 #include <ql/pricingengines/swap/discountingswapengine.hpp>
 #include <ql/quotes/simplequote.hpp>
+#include <ql/risks/admode.hpp>
+#include <ql/risks/pnlexplain.hpp>
+#include <ql/risks/perfcounters.hpp>
+#include <ql/risks/riskengine.hpp>
+#include <ql/risks/riskjournal.hpp>
+#include <ql/risks/risksession.hpp>
+#include <ql/risks/tapehandoff.hpp>
+#include <ql/risks/tradefile.hpp>
+#include <ql/risks/vanillabook.hpp>
 #include <ql/termstructures/iterativebootstrap.hpp>
 #include <ql/termstructures/yield/bootstraptraits.hpp>
 #include <ql/termstructures/yield/piecewiseyieldcurve.hpp>
@@ -43,9 +52,20 @@ either with XAD or with plain doubles and bumping (when QLRISKS_DISABLE_AAD is O
 #include <ql/time/daycounters/actual360.hpp>
 #include <ql/time/daycounters/thirty360.hpp>
 #include <XAD/XAD.hpp>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
 #include <vector>
 
+// counts the heap allocations of the pricing phases, with QLRISKS_ENABLE_ALLOCATION_HOOKS
+QLRISKS_DEFINE_ALLOCATION_HOOKS
+
+// per-thread sessions, with QuantLib built with QL_ENABLE_SESSIONS
+QLRISKS_DEFINE_SESSION_ID
+
 using namespace QuantLib;
 
 const int Ndepos = 10;
@@ -128,9 +148,12 @@ bootstrapCurve(Date referenceDate, const std::vector<Real>& marketQuotes, Size m
         ext::make_shared<CurveType>(referenceDate, instruments, Actual365Fixed()));
 }
 
-// creates the Swap portfolio, given the curve
-std::vector<ext::shared_ptr<VanillaSwap>>
-setupPortfolio(Size portfolioSize, Size maximumMaturity, Handle<YieldTermStructure> curveHandle) {
+// creates the trades first, ..., last - 1 of the Swap portfolio, given the curve
+std::vector<ext::shared_ptr<VanillaSwap>> setupPortfolio(Size portfolioSize,
+                                                         Size maximumMaturity,
+                                                         Handle<YieldTermStructure> curveHandle,
+                                                         Size first,
+                                                         Size last) {
     auto euribor6mYts = ext::make_shared<Euribor>(6 * Months, curveHandle);
 
     // set up a vanilla swap portfolio
@@ -141,12 +164,15 @@ setupPortfolio(Size portfolioSize, Size maximumMaturity, Handle<YieldTermStructu
     std::vector<ext::shared_ptr<VanillaSwap>> portfolio;
     MersenneTwisterUniformRng mt(42);
 
-    for (Size j = 0; j < portfolioSize; ++j) {
+    for (Size j = 0; j < std::min(portfolioSize, last); ++j) {
         Real fixedRate = mt.nextReal() * 0.10;
         Date effective(6, October, 2014);
         Date termination = TARGET().advance(
             effective,
             static_cast<Size>(mt.nextReal() * static_cast<double>(maximumMaturity) + 1.) * Years);
+        // the earlier trades still draw their terms, so that each trade is the same
+        if (j < first)
+            continue;
 
         Schedule fixedSchedule(effective, termination, 1 * Years, TARGET(), ModifiedFollowing,
                                Following, DateGeneration::Backward, false);
@@ -162,10 +188,18 @@ setupPortfolio(Size portfolioSize, Size maximumMaturity, Handle<YieldTermStructu
     return portfolio;
 }
 
+// creates the Swap portfolio, given the curve
+std::vector<ext::shared_ptr<VanillaSwap>>
+setupPortfolio(Size portfolioSize, Size maximumMaturity, Handle<YieldTermStructure> curveHandle) {
+    return setupPortfolio(portfolioSize, maximumMaturity, curveHandle, 0, portfolioSize);
+}
+
 // prices the portfolio using the DiscountingSwapEngine
 Real pricePortfolio(Handle<YieldTermStructure> curveHandle,
                     std::vector<ext::shared_ptr<VanillaSwap>>& portfolio) {
 
+    // includes the lazy bootstrap of the curve
+    PerfPhase phase("npv");
     auto pricingEngine = ext::make_shared<DiscountingSwapEngine>(curveHandle);
     Real y = 0.0;
     for (auto& swap : portfolio) {
@@ -183,9 +217,14 @@ Real pricePlain(const std::vector<double>& marketQuotes, Size portfolioSize, Siz
     // value the portfolio
     Real v = 0.0;
     {
-        auto curveHandle =
-            bootstrapCurve(Settings::instance().evaluationDate(), marketQuotesInp, maxMaturity);
-        auto portfolio = setupPortfolio(portfolioSize, maxMaturity, curveHandle);
+        Handle<YieldTermStructure> curveHandle;
+        std::vector<ext::shared_ptr<VanillaSwap>> portfolio;
+        {
+            PerfPhase phase("build");
+            curveHandle =
+                bootstrapCurve(Settings::instance().evaluationDate(), marketQuotesInp, maxMaturity);
+            portfolio = setupPortfolio(portfolioSize, maxMaturity, curveHandle);
+        }
         v = pricePortfolio(curveHandle, portfolio);
     }
 
@@ -198,71 +237,73 @@ Real pricePlain(const std::vector<double>& marketQuotes, Size portfolioSize, Siz
 using tape_type = Real::tape_type;
 tape_type tape;
 
-// price with sensitivities using AAD
-double priceWithSensi(const std::vector<double>& marketQuotes,
-                      Size portfolioSize,
-                      Size maxMaturity,
-                      std::vector<double>& gradient) {
-
-    tape.clearAll();
-    gradient.clear();
-
+// price with sensitivities using AAD: the risk engine is set up once, and each calculation
+// records the pricer again into the engine's buffers
+class SensiPricer {
+  public:
+    SensiPricer(const std::vector<double>& marketQuotes, Size portfolioSize, Size maxMaturity)
     // convert double market quotes into AD type (Real is active double type)
-    std::vector<Real> marketQuotesAD(marketQuotes.begin(), marketQuotes.end());
-
-    // register independent variables with the tape as inputs and start a new recording
-    tape.registerInputs(marketQuotesAD);
-    tape.newRecording();
-
-    // build curve and price
-    auto curveHandle =
-        bootstrapCurve(Settings::instance().evaluationDate(), marketQuotesAD, maxMaturity);
-    auto portfolio = setupPortfolio(portfolioSize, maxMaturity, curveHandle);
-    Real v = pricePortfolio(curveHandle, portfolio);
-
-    // set adjoint of output and roll back the tape (propagate the adjoints)
-    derivative(v) = 1.0;
-    tape.computeAdjoints();
+    : marketQuotesAD_(marketQuotes.begin(), marketQuotes.end()), engine_(tape) {
+        // the quotes are the risk factors of a pricer building the curve and pricing
+        engine_.addFactors("quotes", marketQuotesAD_);
+        engine_.addPricer([this, portfolioSize, maxMaturity]() {
+            auto curveHandle = bootstrapCurve(Settings::instance().evaluationDate(),
+                                              marketQuotesAD_, maxMaturity);
+            auto portfolio = setupPortfolio(portfolioSize, maxMaturity, curveHandle);
+            return pricePortfolio(curveHandle, portfolio);
+        });
+    }
 
-    // read adjoints of inputs and store them in gradient vector
-    std::transform(marketQuotesAD.begin(), marketQuotesAD.end(), std::back_inserter(gradient),
-                   [](const Real& q) { return derivative(q); });
+    double calculate(std::vector<double>& gradient) {
+        double v = engine_.calculate()[0];
+        auto sensitivities = engine_.sensitivities();
+        gradient.assign(sensitivities.begin(), sensitivities.end());
+        return v;
+    }
 
-    return value(v);
-}
+  private:
+    std::vector<Real> marketQuotesAD_;
+    RiskEngine engine_;
+};
 
 #else
 
 // price with sensitivities using Bumping
-double priceWithSensi(const std::vector<double>& marketQuotes,
-                      Size portfolioSize,
-                      Size maxMaturity,
-                      std::vector<double>& gradient) {
-    gradient.clear();
+class SensiPricer {
+  public:
+    SensiPricer(const std::vector<double>& marketQuotes, Size portfolioSize, Size maxMaturity)
+    : marketQuotes_(marketQuotes), portfolioSize_(portfolioSize), maxMaturity_(maxMaturity) {}
 
-    // convert double market quotes into AD type (Real is active double type)
-    std::vector<Real> marketQuotesCpy(marketQuotes.begin(), marketQuotes.end());
+    double calculate(std::vector<double>& gradient) const {
+        gradient.clear();
 
-    // build curve and price
-    auto curveHandle =
-        bootstrapCurve(Settings::instance().evaluationDate(), marketQuotesCpy, maxMaturity);
-    auto portfolio = setupPortfolio(portfolioSize, maxMaturity, curveHandle);
-    Real v = pricePortfolio(curveHandle, portfolio);
+        // copy of the market quotes, so we can bump each of them without affecting inputs
+        std::vector<Real> marketQuotesCpy(marketQuotes_.begin(), marketQuotes_.end());
 
-    Real eps = 1e-5;
-    for (Size i = 0; i < marketQuotesCpy.size(); ++i) {
-        marketQuotesCpy[i] += eps;
+        // build curve and price
         auto curveHandle =
-            bootstrapCurve(Settings::instance().evaluationDate(), marketQuotesCpy, maxMaturity);
-        auto portfolio = setupPortfolio(portfolioSize, maxMaturity, curveHandle);
-        Real v1 = pricePortfolio(curveHandle, portfolio);
-        gradient.push_back(xad::value((v - v1) / eps));
-        marketQuotesCpy[i] -= eps;
-    }
+            bootstrapCurve(Settings::instance().evaluationDate(), marketQuotesCpy, maxMaturity_);
+        auto portfolio = setupPortfolio(portfolioSize_, maxMaturity_, curveHandle);
+        Real v = pricePortfolio(curveHandle, portfolio);
+
+        Real eps = 1e-5;
+        for (Size i = 0; i < marketQuotesCpy.size(); ++i) {
+            marketQuotesCpy[i] += eps;
+            auto curveHandle = bootstrapCurve(Settings::instance().evaluationDate(),
+                                              marketQuotesCpy, maxMaturity_);
+            auto portfolio = setupPortfolio(portfolioSize_, maxMaturity_, curveHandle);
+            Real v1 = pricePortfolio(curveHandle, portfolio);
+            gradient.push_back(xad::value((v - v1) / eps));
+            marketQuotesCpy[i] -= eps;
+        }
 
-    return xad::value(v);
-}
+        return xad::value(v);
+    }
 
+  private:
+    std::vector<double> marketQuotes_;
+    Size portfolioSize_, maxMaturity_;
+};
 
 #endif
 
@@ -286,6 +327,200 @@ void printResults(double v, const std::vector<double>& gradient) {
         std::cout << "dv/dSwap[" << i - Ndepos - Nfra << "] = " << gradient[i] << "\n";
 }
 
+#ifndef QLRISKS_DISABLE_AAD
+
+// the largest absolute difference between two gradients
+double maxDifference(const std::vector<double>& x, const std::vector<double>& y) {
+    QL_REQUIRE(x.size() == y.size(), "gradients of different sizes");
+    double d = 0.0;
+    for (Size i = 0; i < x.size(); ++i)
+        d = std::max(d, std::fabs(x[i] - y[i]));
+    return d;
+}
+
+// explains the P&L between two quote snapshots from the AAD risk at both snapshots
+void explainMarketMove(const std::vector<double>& startQuotes,
+                       const std::vector<double>& endQuotes,
+                       Size portfolioSize,
+                       Size maxMaturity) {
+    auto pricer = [&](const std::vector<Real>& quotes) {
+        auto curveHandle =
+            bootstrapCurve(Settings::instance().evaluationDate(), quotes, maxMaturity);
+        auto portfolio = setupPortfolio(portfolioSize, maxMaturity, curveHandle);
+        return pricePortfolio(curveHandle, portfolio);
+    };
+
+    auto explain = explainPnL(pricer, startQuotes, endQuotes);
+
+    std::cout << "\nP&L explain:\n";
+    std::cout << "Deposits       : " << explain.explained(0, Ndepos) << "\n";
+    std::cout << "FRAs           : " << explain.explained(Ndepos, Ndepos + Nfra) << "\n";
+    std::cout << "Swaps          : " << explain.explained(Ndepos + Nfra, startQuotes.size())
+              << "\n";
+    std::cout << "Explained P&L  : " << explain.explained() << "\n";
+    std::cout << "Actual P&L     : " << explain.actual() << "\n";
+    std::cout << "Unexplained    : " << explain.unexplained() << "\n";
+}
+
+// a file in the temporary directory, where the journal and trade file are written
+std::string temporaryPath(const std::string& name) {
+    for (const char* variable : {"TMPDIR", "TEMP", "TMP"}) {
+        const char* dir = std::getenv(variable);
+        if (dir != nullptr && *dir != '\0')
+            return std::string(dir) + "/" + name;
+    }
+#ifdef _WIN32
+    return name;
+#else
+    return "/tmp/" + name;
+#endif
+}
+
+// prices the portfolio in shards of trades with per-trade sensitivities, journaling each
+// completed shard so that a job restarted after a failure resumes from the last shard
+double priceWithSensiJournaled(const std::vector<double>& marketQuotes,
+                               Size portfolioSize,
+                               Size maxMaturity,
+                               Size shardSize,
+                               const std::string& journalPath,
+                               std::vector<double>& gradient) {
+    // the journal is only reused by the same shards of the same trades
+    RiskJobLayout layout;
+    layout.shards = (portfolioSize + shardSize - 1) / shardSize;
+    layout.shardSize = shardSize;
+    std::vector<double> tradeTerms;
+    for (const auto& swap :
+         setupPortfolio(portfolioSize, maxMaturity, Handle<YieldTermStructure>())) {
+        tradeTerms.push_back(value(swap->nominal()));
+        tradeTerms.push_back(value(swap->fixedRate()));
+        tradeTerms.push_back(static_cast<double>(swap->maturityDate().serialNumber()));
+    }
+    layout.portfolioHash = hashPortfolio(tradeTerms);
+    RiskJournal journal(journalPath, hashSnapshot(marketQuotes), layout);
+    Size nShards = layout.shards;
+    std::cout << "\nJournaled risk: " << journal.completedShards() << " of " << nShards
+              << " shards already completed\n";
+
+    auto priceShard = [&](Size k) {
+        // per-trade NPVs of the shard, as a block of outputs
+        auto task = [&](const std::vector<Real>& quotes) {
+            auto curveHandle =
+                bootstrapCurve(Settings::instance().evaluationDate(), quotes, maxMaturity);
+            auto shard = setupPortfolio(portfolioSize, maxMaturity, curveHandle, k * shardSize,
+                                        (k + 1) * shardSize);
+            auto pricingEngine = ext::make_shared<DiscountingSwapEngine>(curveHandle);
+            std::vector<Real> npvs;
+            for (auto& swap : shard) {
+                swap->setPricingEngine(pricingEngine);
+                npvs.push_back(swap->NPV());
+            }
+            return npvs;
+        };
+        RiskShard shard;
+        shard.npvs = computeJacobian(task, marketQuotes, ADMode::VectorReverse, shard.gradients);
+        return shard;
+    };
+    auto shards = runShards(journal, priceShard);
+
+    double v = 0.0;
+    Size n = marketQuotes.size();
+    gradient.assign(n, 0.0);
+    for (auto& shard : shards) {
+        for (Size t = 0; t < shard.npvs.size(); ++t) {
+            v += shard.npvs[t];
+            for (Size i = 0; i < n; ++i)
+                gradient[i] += shard.gradients[t * n + i];
+        }
+    }
+
+    // the job is complete, so the journal is no longer needed
+    journal.remove();
+    return v;
+}
+
+// prices the portfolio in shards of trades, recording each shard on this thread while the
+// reverse sweeps of the previous shards run on a worker thread.  Each shard is recorded on
+// a tape of its own, with one bootstrap of the curve and the shard's trades only.
+double priceWithSensiPipelined(const std::vector<double>& marketQuotes,
+                               Size portfolioSize,
+                               Size maxMaturity,
+                               Size shardSize,
+                               std::vector<double>& gradient) {
+    ActiveTapeSuspension suspension;
+
+    AdjointPipeline pipeline;
+    std::vector<std::future<std::vector<double>>> sweeps;
+    double v = 0.0;
+    for (Size begin = 0; begin < portfolioSize; begin += shardSize) {
+        auto task = [&](const std::vector<Real>& quotes) {
+            auto curveHandle =
+                bootstrapCurve(Settings::instance().evaluationDate(), quotes, maxMaturity);
+            auto shard =
+                setupPortfolio(portfolioSize, maxMaturity, curveHandle, begin, begin + shardSize);
+            return std::vector<Real>{pricePortfolio(curveHandle, shard)};
+        };
+        RecordedTape recording = recordTape(task, marketQuotes);
+        v += recording.values()[0];
+        sweeps.push_back(pipeline.sweep(std::move(recording)));
+    }
+
+    gradient.assign(marketQuotes.size(), 0.0);
+    for (auto& sweep : sweeps) {
+        std::vector<double> adjoints = sweep.get();
+        for (Size i = 0; i < adjoints.size(); ++i)
+            gradient[i] += adjoints[i];
+    }
+    return v;
+}
+
+// prices the portfolio from a book of trade values, converted once from the instruments,
+// instead of one VanillaSwap object graph per trade and recording
+class BookSensiPricer {
+  public:
+    BookSensiPricer(const std::vector<double>& marketQuotes,
+                    const VanillaSwapBook& book,
+                    Size maxMaturity)
+    : marketQuotesAD_(marketQuotes.begin(), marketQuotes.end()), engine_(tape) {
+        engine_.addFactors("quotes", marketQuotesAD_);
+        engine_.addPricer([this, &book, maxMaturity]() {
+            auto curveHandle = bootstrapCurve(Settings::instance().evaluationDate(),
+                                              marketQuotesAD_, maxMaturity);
+            const YieldTermStructure& curve = *curveHandle.currentLink();
+            return book.npv(curve, curve);
+        });
+    }
+
+    double calculate(std::vector<double>& gradient) {
+        double v = engine_.calculate()[0];
+        auto sensitivities = engine_.sensitivities();
+        gradient.assign(sensitivities.begin(), sensitivities.end());
+        return v;
+    }
+
+  private:
+    std::vector<Real> marketQuotesAD_;
+    RiskEngine engine_;
+};
+
+// derivatives of the portfolio value along the quote shifts of stress scenarios, from one
+// recording instead of one bumped revaluation per scenario
+std::vector<double> stressDerivatives(const std::vector<double>& marketQuotes,
+                                      Size portfolioSize,
+                                      Size maxMaturity,
+                                      const std::vector<std::vector<double>>& scenarios) {
+    auto task = [&](const std::vector<Real>& quotes) {
+        auto curveHandle =
+            bootstrapCurve(Settings::instance().evaluationDate(), quotes, maxMaturity);
+        auto portfolio = setupPortfolio(portfolioSize, maxMaturity, curveHandle);
+        return std::vector<Real>{pricePortfolio(curveHandle, portfolio)};
+    };
+    ActiveTapeSuspension suspension;
+    RecordedTape recording = recordTape(task, marketQuotes);
+    return recording.directionalDerivatives(scenarios);
+}
+
+#endif
+
 int main() {
     try {
         Size portfolioSize = 50;
@@ -303,8 +538,9 @@ int main() {
         std::cout << "Pricing portfolio of " << portfolioSize << " swaps...\n";
         auto start = std::chrono::high_resolution_clock::now();
         Real v = 0.0;
-        for (int i = 0; i < N; ++i)
+        for (int i = 0; i < N; ++i) {
             v = pricePlain(marketQuotes, portfolioSize, maxMaturity);
+        }
         auto end = std::chrono::high_resolution_clock::now();
         auto time_plain =
             static_cast<double>(
@@ -315,10 +551,12 @@ int main() {
         std::vector<double> gradient;
 
         std::cout << "Pricing portfolio of " << portfolioSize << " swaps with sensitivities...\n";
+        SensiPricer sensiPricer(marketQuotes, portfolioSize, maxMaturity);
         start = std::chrono::high_resolution_clock::now();
         double v2 = 0.0;
-        for (int i = 0; i < N; ++i)
-            v2 = priceWithSensi(marketQuotes, portfolioSize, maxMaturity, gradient);
+        for (int i = 0; i < N; ++i) {
+            v2 = sensiPricer.calculate(gradient);
+        }
         end = std::chrono::high_resolution_clock::now();
         auto time_sensi =
             static_cast<double>(
@@ -330,6 +568,122 @@ int main() {
         std::cout << "Plain time : " << time_plain << "ms\n"
                   << "Sensi time : " << time_sensi << "ms\n"
                   << "Factor     : " << time_sensi / time_plain << "x\n";
+
+        // hardware event and allocation counts of the pricing phases, with
+        // QLRISKS_ENABLE_PERF_COUNTERS or QLRISKS_ENABLE_ALLOCATION_HOOKS, from one more run
+        // of each, as reading the counters around the timed runs would skew the timings
+        PerfProfile profile;
+        if (profile.available()) {
+            {
+                PerfPhase phase("plain");
+                pricePlain(marketQuotes, portfolioSize, maxMaturity);
+            }
+            {
+                PerfPhase phase("sensi");
+                sensiPricer.calculate(gradient);
+            }
+            std::cout << profile;
+        }
+
+#ifndef QLRISKS_DISABLE_AAD
+        // next day's quotes: a 1bp parallel move with a steepening of the swap curve
+        std::vector<double> endQuotes = marketQuotes;
+        for (Size i = 0; i < endQuotes.size(); ++i) {
+            endQuotes[i] += 0.0001;
+            if (i >= Ndepos + Nfra)
+                endQuotes[i] += 0.000002 * static_cast<double>(i - Ndepos - Nfra);
+        }
+        explainMarketMove(marketQuotes, endQuotes, portfolioSize, maxMaturity);
+
+        // the same risk, computed in shards of 10 trades with a restartable journal
+        std::vector<double> journaledGradient;
+        double v3 = priceWithSensiJournaled(marketQuotes, portfolioSize, maxMaturity, 10,
+                                            temporaryPath("AdjointSwapXAD.journal"),
+                                            journaledGradient);
+        std::cout << "Journaled portfolio value: " << v3 << "\n";
+        std::cout << "Max difference to serial sensitivities: "
+                  << maxDifference(journaledGradient, gradient) << "\n";
+
+        // and with the recordings of the shards overlapping with their reverse sweeps
+        std::vector<double> pipelinedGradient;
+        start = std::chrono::high_resolution_clock::now();
+        double v4 = priceWithSensiPipelined(marketQuotes, portfolioSize, maxMaturity, 10,
+                                            pipelinedGradient);
+        end = std::chrono::high_resolution_clock::now();
+        std::cout << "\nPipelined portfolio value: " << v4 << "\n";
+        std::cout << "Max difference to serial sensitivities: "
+                  << maxDifference(pipelinedGradient, gradient) << "\n";
+        std::cout << "Pipelined time : "
+                  << static_cast<double>(
+                         std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+                             .count()) *
+                         1e-3
+                  << "ms\n";
+
+        // and from a flat book of the trades, loaded from a binary trade file: the book
+        // entries are built from the records and conventions, without building the swaps
+        const std::string tradePath = temporaryPath("AdjointSwapXAD.trades");
+        std::vector<TradeRecord> trades;
+        for (const auto& swap :
+             setupPortfolio(portfolioSize, maxMaturity, Handle<YieldTermStructure>()))
+            trades.push_back(vanillaSwapTrade(*swap));
+        writeTradeFile(tradePath, trades);
+        SwapTradeConventions conventions;
+        conventions.calendar = TARGET();
+        conventions.fixedDayCount = Thirty360(Thirty360::European);
+        conventions.floatingDayCount = Actual360();
+        conventions.index = ext::make_shared<Euribor>(6 * Months);
+        VanillaSwapBook book;
+        start = std::chrono::high_resolution_clock::now();
+        {
+            TradeFile file(tradePath);
+            addTrades(book, file.begin(), file.end(), conventions);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        std::remove(tradePath.c_str());
+        std::cout << "\nTrade file load time : "
+                  << static_cast<double>(
+                         std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+                             .count()) *
+                         1e-3
+                  << "ms\n";
+        std::vector<double> bookGradient;
+        double v5 = 0.0;
+        BookSensiPricer bookPricer(marketQuotes, book, maxMaturity);
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < N; ++i)
+            v5 = bookPricer.calculate(bookGradient);
+        end = std::chrono::high_resolution_clock::now();
+        std::cout << "\nTrade book portfolio value: " << v5 << "\n";
+        std::cout << "Max difference to serial sensitivities: "
+                  << maxDifference(bookGradient, gradient) << "\n";
+        std::cout << "Trade book sensi time : "
+                  << static_cast<double>(
+                         std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+                             .count()) *
+                         1e-3 / N
+                  << "ms\n";
+
+        // the first-order P&L of 200 stress scenarios, shifting the quotes by up to 10bp
+        MersenneTwisterUniformRng rng(7);
+        std::vector<std::vector<double>> scenarios(200);
+        for (auto& shift : scenarios)
+            for (Size i = 0; i < marketQuotes.size(); ++i)
+                shift.push_back(0.002 * (value(rng.nextReal()) - 0.5));
+        start = std::chrono::high_resolution_clock::now();
+        std::vector<double> stress =
+            stressDerivatives(marketQuotes, portfolioSize, maxMaturity, scenarios);
+        end = std::chrono::high_resolution_clock::now();
+        std::cout << "\nStress scenarios     : " << scenarios.size() << "\n";
+        std::cout << "Worst scenario P&L   : " << *std::min_element(stress.begin(), stress.end())
+                  << "\n";
+        std::cout << "Stress time : "
+                  << static_cast<double>(
+                         std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+                             .count()) *
+                         1e-3
+                  << "ms\n";
+#endif
         return 0;
     } catch (std::exception& e) {
         std::cerr << e.what() << std::endl;
@@ -0,0 +1,213 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2022, 2023, 2024 Xcelerit
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+/*
+This example prices a portfolio of swaps under parallel shifts of the bootstrapped zero
+curve, in a scenario build where QuantLib's Real is a batch of QLRISKS_SCENARIO_LANES
+scenario values.  Each pass through the pricing code prices one batch of shifts.
+It checks the batched values against pricing one scenario at a time, and measures both.
+*/
+
+
+#include <ql/qldefines.hpp>
+#if !defined(BOOST_ALL_NO_LIB) && defined(BOOST_MSVC)
+#    include <ql/auto_link.hpp>
+#endif
+#include <ql/indexes/ibor/euribor.hpp>
+#include <ql/instruments/vanillaswap.hpp>
+#include <ql/math/randomnumbers/mt19937uniformrng.hpp>
+#include <ql/pricingengines/swap/discountingswapengine.hpp>
+#include <ql/quotes/simplequote.hpp>
+#include <ql/risks/scenariopricing.hpp>
+#include <ql/termstructures/iterativebootstrap.hpp>
+#include <ql/termstructures/yield/bootstraptraits.hpp>
+#include <ql/termstructures/yield/piecewiseyieldcurve.hpp>
+#include <ql/termstructures/yield/ratehelpers.hpp>
+#include <ql/termstructures/yield/zerospreadedtermstructure.hpp>
+#include <ql/time/calendars/target.hpp>
+#include <ql/time/daycounters/actual360.hpp>
+#include <ql/time/daycounters/actual365fixed.hpp>
+#include <ql/time/daycounters/thirty360.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#ifndef QLRISKS_SCENARIO_LANES
+#    error "this example needs a scenario build (QLRISKS_SCENARIO_LANES CMake option)"
+#endif
+
+using namespace QuantLib;
+
+constexpr std::size_t Lanes = QLRISKS_SCENARIO_LANES;
+
+const int Ndepos = 6;
+
+// deposit quotes 1m, ... , 6m and swap quotes 1y, ... , maximum maturity
+std::vector<Real> prepareQuotes(Size maximumMaturity) {
+    std::vector<Real> marketQuotes;
+    for (Size i = 0; i < Ndepos; ++i)
+        marketQuotes.push_back(0.0010 + i * 0.0002);
+    for (Size i = 0; i < maximumMaturity; ++i)
+        marketQuotes.push_back(0.0060 + i * 0.0001);
+    return marketQuotes;
+}
+
+// bootstraps the base curve, with the same quotes in all lanes
+Handle<YieldTermStructure>
+bootstrapCurve(Date referenceDate, const std::vector<Real>& marketQuotes, Size maximumMaturity) {
+    std::vector<ext::shared_ptr<RateHelper>> instruments;
+    for (Size i = 0; i < Ndepos; ++i) {
+        Handle<Quote> quote(ext::make_shared<SimpleQuote>(marketQuotes[i]));
+        instruments.push_back(ext::make_shared<DepositRateHelper>(
+            quote, (i + 1) * Months, 2, TARGET(), ModifiedFollowing, false, Actual360()));
+    }
+    auto euribor6m = ext::make_shared<Euribor>(6 * Months);
+    for (Size i = 0; i < maximumMaturity; ++i) {
+        Handle<Quote> quote(ext::make_shared<SimpleQuote>(marketQuotes[Ndepos + i]));
+        instruments.push_back(ext::make_shared<SwapRateHelper>(
+            quote, (i + 1) * Years, TARGET(), Annual, ModifiedFollowing,
+            Thirty360(Thirty360::European), euribor6m));
+    }
+
+    using CurveType = PiecewiseYieldCurve<ZeroYield, Linear, IterativeBootstrap>;
+    auto curve = ext::make_shared<CurveType>(referenceDate, instruments, Actual365Fixed());
+    curve->enableExtrapolation();
+    return Handle<YieldTermStructure>(curve);
+}
+
+// creates the swap portfolio, forecasting and discounting on the given curve
+std::vector<ext::shared_ptr<VanillaSwap>>
+setupPortfolio(Size portfolioSize, Size maximumMaturity, Handle<YieldTermStructure> curveHandle) {
+    auto euribor6mYts = ext::make_shared<Euribor>(6 * Months, curveHandle);
+    euribor6mYts->addFixing(Date(2, October, 2014), 0.0040);
+    euribor6mYts->addFixing(Date(3, October, 2014), 0.0040);
+    euribor6mYts->addFixing(Date(6, October, 2014), 0.0040);
+
+    std::vector<ext::shared_ptr<VanillaSwap>> portfolio;
+    MersenneTwisterUniformRng mt(42);
+
+    for (Size j = 0; j < portfolioSize; ++j) {
+        // the random numbers are the same in all lanes
+        Real fixedRate = mt.nextReal() * 0.10;
+        Date effective(6, October, 2014);
+        Date termination = TARGET().advance(
+            effective, static_cast<Size>(value(mt.nextReal()) * maximumMaturity + 1.) * Years);
+
+        Schedule fixedSchedule(effective, termination, 1 * Years, TARGET(), ModifiedFollowing,
+                               Following, DateGeneration::Backward, false);
+        Schedule floatSchedule(effective, termination, 6 * Months, TARGET(), ModifiedFollowing,
+                               Following, DateGeneration::Backward, false);
+
+        portfolio.push_back(ext::make_shared<VanillaSwap>(
+            VanillaSwap::Receiver, 10000000.0 / portfolioSize, fixedSchedule, fixedRate,
+            Thirty360(Thirty360::European), floatSchedule, euribor6mYts, 0.0, Actual360()));
+    }
+
+    return portfolio;
+}
+
+// prices the portfolio, built once on the shifted curve
+Real pricePortfolio(const std::vector<ext::shared_ptr<VanillaSwap>>& portfolio) {
+    Real y = 0.0;
+    for (auto& swap : portfolio)
+        y += swap->NPV();
+    return y;
+}
+
+int main() {
+    try {
+        Size portfolioSize = 20;
+        Size maxMaturity = 30;
+        Size nScenarios = 64;
+
+        Date referenceDate(2, January, 2015);
+        Settings::instance().evaluationDate() = referenceDate;
+        auto baseCurve = bootstrapCurve(referenceDate, prepareQuotes(maxMaturity), maxMaturity);
+
+        // parallel shifts from -50bp to +50bp
+        std::vector<std::vector<double>> scenarios;
+        for (Size i = 0; i < nScenarios; ++i)
+            scenarios.push_back({-0.005 + 0.01 * i / (nScenarios - 1)});
+
+        // the portfolio is built once on the base curve with its zero rates shifted by a
+        // quote, which is relinked rather than set for each batch: setting it would compare
+        // the new lanes with the previous ones
+        RelinkableHandle<Quote> shift(ext::make_shared<SimpleQuote>(0.0));
+        Handle<YieldTermStructure> curve(
+            ext::make_shared<ZeroSpreadedTermStructure>(baseCurve, shift));
+        auto portfolio = setupPortfolio(portfolioSize, maxMaturity, curve);
+        auto pricingEngine = ext::make_shared<DiscountingSwapEngine>(curve);
+        for (auto& swap : portfolio)
+            swap->setPricingEngine(pricingEngine);
+
+        auto pricer = [&](const std::vector<Real>& factors) {
+            shift.linkTo(ext::make_shared<SimpleQuote>(factors[0]));
+            return pricePortfolio(portfolio);
+        };
+
+        std::cout << "Pricing portfolio of " << portfolioSize << " swaps under " << nScenarios
+                  << " scenarios, " << Lanes << " per batch...\n";
+        Size divergent = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<double> batched = priceScenarios<Lanes>(pricer, scenarios, &divergent);
+        auto end = std::chrono::high_resolution_clock::now();
+        auto time_batched =
+            static_cast<double>(
+                std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()) *
+            1e-3;
+
+        std::cout << "Pricing the scenarios one at a time...\n";
+        std::vector<double> single;
+        start = std::chrono::high_resolution_clock::now();
+        for (const auto& s : scenarios)
+            single.push_back(pricer({Real(s[0])}).lane(0));
+        end = std::chrono::high_resolution_clock::now();
+        auto time_single =
+            static_cast<double>(
+                std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()) *
+            1e-3;
+
+        double maxDifference = 0.0;
+        for (Size i = 0; i < nScenarios; ++i)
+            maxDifference = std::max(maxDifference, std::fabs(batched[i] - single[i]));
+
+        std::cout << "Value at -50bp             = " << batched.front() << "\n"
+                  << "Value at +50bp             = " << batched.back() << "\n"
+                  << "Divergent batches          = " << divergent << "\n"
+                  << "Max difference to single   = " << maxDifference << "\n"
+                  << "Batched time : " << time_batched << "ms\n"
+                  << "Single time  : " << time_single << "ms\n"
+                  << "Speedup      : " << time_single / time_batched << "x\n";
+
+        if (maxDifference > 1e-6) {
+            std::cerr << "batched scenario values differ from single-scenario ones\n";
+            return 1;
+        }
+        return 0;
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    } catch (...) {
+        std::cerr << "unknown error" << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,198 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+// Include-first header for scenario builds, where QuantLib's Real is a batch of
+// QLRISKS_SCENARIO_LANES scenario values (see ql/risks/scenarioreal.hpp).
+// It is the counterpart of ql/qlrisks.hpp, selected with the CMake option of the same name.
+
+#pragma once
+
+#include <boost/accumulators/numeric/functional.hpp>
+#include <boost/math/special_functions/math_fwd.hpp>
+#include <boost/math/tools/promotion.hpp>
+#include <boost/numeric/conversion/cast.hpp>
+#include <boost/numeric/ublas/operations.hpp>
+#include <boost/type_traits/is_arithmetic.hpp>
+#include <boost/type_traits/is_floating_point.hpp>
+#include <boost/type_traits/is_pod.hpp>
+#include <ql/risks/scenarioreal.hpp>
+#include <type_traits>
+
+#ifndef QLRISKS_SCENARIO_LANES
+#    error "QLRISKS_SCENARIO_LANES must be defined for scenario builds"
+#endif
+
+#define QL_REAL QuantLib::ScenarioReal<QLRISKS_SCENARIO_LANES>
+#define QL_RISKS_SCENARIOS 1
+
+// QuantLib calls the math functions fully qualified, so they are made visible in std,
+// as XAD does for its active types
+namespace std {
+    using QuantLib::scenarios::abs;
+    using QuantLib::scenarios::acos;
+    using QuantLib::scenarios::asin;
+    using QuantLib::scenarios::atan;
+    using QuantLib::scenarios::atan2;
+    using QuantLib::scenarios::cbrt;
+    using QuantLib::scenarios::ceil;
+    using QuantLib::scenarios::cos;
+    using QuantLib::scenarios::cosh;
+    using QuantLib::scenarios::erf;
+    using QuantLib::scenarios::erfc;
+    using QuantLib::scenarios::exp;
+    using QuantLib::scenarios::expm1;
+    using QuantLib::scenarios::fabs;
+    using QuantLib::scenarios::floor;
+    using QuantLib::scenarios::fmax;
+    using QuantLib::scenarios::fmin;
+    using QuantLib::scenarios::fmod;
+    using QuantLib::scenarios::hypot;
+    using QuantLib::scenarios::isfinite;
+    using QuantLib::scenarios::isinf;
+    using QuantLib::scenarios::isnan;
+    using QuantLib::scenarios::log;
+    using QuantLib::scenarios::log10;
+    using QuantLib::scenarios::log1p;
+    using QuantLib::scenarios::max;
+    using QuantLib::scenarios::min;
+    using QuantLib::scenarios::pow;
+    using QuantLib::scenarios::round;
+    using QuantLib::scenarios::sin;
+    using QuantLib::scenarios::sinh;
+    using QuantLib::scenarios::sqrt;
+    using QuantLib::scenarios::tan;
+    using QuantLib::scenarios::tanh;
+    using QuantLib::scenarios::trunc;
+}
+
+// boost specialisations, as for AReal in ql/qlrisks.hpp
+namespace boost {
+
+    template <class Target>
+    inline Target numeric_cast(const QL_REAL& arg) {
+        return numeric_cast<Target>(QuantLib::scenarios::value(arg));
+    }
+
+    namespace math {
+
+        namespace tools {
+            template <>
+            struct promote_args_2<QL_REAL, QL_REAL> {
+                typedef QL_REAL type;
+            };
+
+            template <class T>
+            struct promote_args_2<QL_REAL, T> {
+                typedef QL_REAL type;
+            };
+
+            template <class T>
+            struct promote_args_2<T, QL_REAL> {
+                typedef QL_REAL type;
+            };
+        }
+
+        namespace policies {
+            template <class Policy>
+            struct evaluation<QL_REAL, Policy> {
+                using type = QL_REAL;
+            };
+        }
+
+        // classification needs a common answer for all lanes
+        inline bool(isfinite)(const QL_REAL& x) { return QuantLib::scenarios::isfinite(x); }
+        inline bool(isinf)(const QL_REAL& x) { return QuantLib::scenarios::isinf(x); }
+        inline bool(isnan)(const QL_REAL& x) { return QuantLib::scenarios::isnan(x); }
+    }
+
+    namespace numeric {
+
+        namespace functional {
+
+            template <>
+            struct result_of_divides<QL_REAL, QL_REAL> {
+                typedef QL_REAL type;
+            };
+
+            template <class T>
+            struct result_of_divides<QL_REAL, T> {
+                typedef QL_REAL type;
+            };
+
+            template <class T>
+            struct result_of_divides<T, QL_REAL> {
+                typedef QL_REAL type;
+            };
+
+            template <>
+            struct result_of_multiplies<QL_REAL, QL_REAL> {
+                typedef QL_REAL type;
+            };
+
+            template <class T>
+            struct result_of_multiplies<QL_REAL, T> {
+                typedef QL_REAL type;
+            };
+
+            template <class T>
+            struct result_of_multiplies<T, QL_REAL> {
+                typedef QL_REAL type;
+            };
+
+        }
+
+        namespace ublas {
+            template <>
+            struct promote_traits<QL_REAL, QL_REAL> {
+                typedef QL_REAL promote_type;
+            };
+
+            template <class T>
+            struct promote_traits<QL_REAL, T> {
+                typedef QL_REAL promote_type;
+            };
+
+            template <class T>
+            struct promote_traits<T, QL_REAL> {
+                typedef QL_REAL promote_type;
+            };
+        }
+    }
+
+    // the scenario batch behaves like a floating point number
+    template <>
+    struct is_floating_point<QL_REAL> : public true_type {};
+
+    template <>
+    struct is_arithmetic<QL_REAL> : public true_type {};
+
+    template <>
+    struct is_pod<QL_REAL> : public false_type {};
+
+    // it is only convertible to itself, not to another type
+    template <class To>
+    struct is_convertible<QL_REAL, To> : public false_type {};
+
+    template <>
+    struct is_convertible<QL_REAL, QL_REAL> : public true_type {};
+}
@@ -0,0 +1,145 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/errors.hpp>
+#include <ql/types.hpp>
+#include <initializer_list>
+#include <new>
+#include <utility>
+#include <vector>
+
+#ifndef QLRISKS_DISABLE_AAD
+#    include <XAD/XAD.hpp>
+#endif
+
+namespace QuantLib {
+
+#ifndef QLRISKS_DISABLE_AAD
+
+    namespace detail {
+
+        /* Re-creates an active variable as a passive one with the same value, so that it no
+         * longer refers to its slot when the tape is cleared; assigning a value would keep it.
+         */
+        inline void resetToPassive(Real& x) {
+            double v = value(x);
+            x.~Real();
+            new (&x) Real(v);
+        }
+
+        // propagates the adjoint of one output to its inputs with fixed partials
+        class AdjointNode : public xad::CheckpointCallback<Real::tape_type> {
+          public:
+            typedef Real::tape_type tape_type;
+            typedef tape_type::slot_type slot_type;
+
+            AdjointNode(slot_type output,
+                        std::vector<slot_type> inputs,
+                        std::vector<double> partials)
+            : output_(output), inputs_(std::move(inputs)), partials_(std::move(partials)) {}
+
+            void computeAdjoint(tape_type* tape) override {
+                double adjoint = tape->getAndResetOutputAdjoint(output_);
+                for (std::size_t k = 0; k < inputs_.size(); ++k)
+                    tape->incrementAdjoint(inputs_[k], adjoint * partials_[k]);
+            }
+
+          private:
+            slot_type output_;
+            std::vector<slot_type> inputs_;
+            std::vector<double> partials_;
+        };
+
+        inline Real recordNode(double value,
+                               const std::vector<const Real*>& inputs,
+                               const std::vector<double>& partials) {
+            auto* tape = Real::tape_type::getActive();
+            std::vector<AdjointNode::slot_type> slots;
+            std::vector<double> derivatives;
+            for (Size k = 0; k < inputs.size(); ++k) {
+                if (tape != nullptr && inputs[k]->shouldRecord()) {
+                    slots.push_back(inputs[k]->getSlot());
+                    derivatives.push_back(partials[k]);
+                }
+            }
+            Real y = value;
+            if (slots.empty())
+                return y;
+            tape->registerOutput(y);
+            auto* node = new AdjointNode(y.getSlot(), std::move(slots), std::move(derivatives));
+            // the tape owns the node, and calls it during the reverse sweep
+            tape->pushCallback(node);
+            tape->insertCallback(node);
+            return y;
+        }
+
+    }
+
+    /* Records a value computed outside the tape as one node, given its partial derivatives
+     * with respect to the inputs it depends on:
+     *
+     *     Real y = recordNode(f(x1, x2), {{x1, df/dx1}, {x2, df/dx2}});
+     *
+     * This replaces taping every operation of f when the partials are known analytically
+     * (e.g. by telescoping, or by the implicit function theorem for a solver).  The result
+     * is passive if no input is active.  Without AAD, it is the plain value.
+     */
+    inline Real recordNode(double value,
+                           std::initializer_list<std::pair<const Real&, double>> partials) {
+        std::vector<const Real*> inputs;
+        std::vector<double> derivatives;
+        for (const auto& p : partials) {
+            inputs.push_back(&p.first);
+            derivatives.push_back(p.second);
+        }
+        return detail::recordNode(value, inputs, derivatives);
+    }
+
+    inline Real recordNode(double value,
+                           const std::vector<Real>& inputs,
+                           const std::vector<double>& partials) {
+        QL_REQUIRE(inputs.size() == partials.size(),
+                   "number of inputs (" << inputs.size() << ") and partials (" << partials.size()
+                                        << ") differ");
+        std::vector<const Real*> pointers;
+        for (const auto& x : inputs)
+            pointers.push_back(&x);
+        return detail::recordNode(value, pointers, partials);
+    }
+
+#else
+
+    inline Real recordNode(double value, std::initializer_list<std::pair<const Real&, double>>) {
+        return value;
+    }
+
+    inline Real
+    recordNode(double value, const std::vector<Real>&, const std::vector<double>&) {
+        return value;
+    }
+
+#endif
+
+}
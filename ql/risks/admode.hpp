@@ -0,0 +1,284 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/errors.hpp>
+#include <ql/types.hpp>
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <vector>
+
+namespace QuantLib {
+
+    /* Derivative propagation modes for a pricing task y = f(x) with n inputs and m outputs.
+     *
+     * - ForwardDifference: one input direction per pass, i.e. n + 1 evaluations.  As
+     *   QuantLib's Real is the adjoint type, there is no tangent type to propagate, and the
+     *   passes are passive revaluations with one-sided bumps: no tape is recorded, and the
+     *   derivatives have finite-difference accuracy.
+     * - Reverse: one recording and a single adjoint sweep, for scalar tasks (m = 1).
+     * - VectorReverse: one recording, swept once per output, for blocks of outputs (m > 1).
+     */
+    enum class ADMode { ForwardDifference, Reverse, VectorReverse };
+
+    inline std::ostream& operator<<(std::ostream& out, ADMode mode) {
+        switch (mode) {
+            case ADMode::ForwardDifference:
+                return out << "forward-difference";
+            case ADMode::Reverse:
+                return out << "reverse";
+            case ADMode::VectorReverse:
+                return out << "vector-reverse";
+            default:
+                QL_FAIL("unknown AD mode");
+        }
+    }
+
+    // Measured cost of the phases of a pricing task, times in seconds
+    struct TapeCostModel {
+        double plainTime = 0.0;     // one passive evaluation
+        double recordingTime = 0.0; // one evaluation while recording on the tape
+        double sweepTime = 0.0;     // one adjoint sweep over the recording
+        std::size_t tapeMemory = 0; // bytes held by the recording
+        Size samples = 0;           // runs the times were measured on
+
+        bool measured() const { return samples > 0; }
+
+        // estimated time to obtain the full m x n Jacobian in the given mode
+        double cost(ADMode mode, Size nInputs, Size nOutputs) const {
+            switch (mode) {
+                case ADMode::ForwardDifference:
+                    return plainTime * static_cast<double>(nInputs + 1);
+                case ADMode::Reverse:
+                case ADMode::VectorReverse:
+                    return recordingTime + sweepTime * static_cast<double>(nOutputs);
+                default:
+                    QL_FAIL("unknown AD mode");
+            }
+        }
+
+        // folds the phases timed in one run (the non-zero ones) into moving averages
+        void observe(const TapeCostModel& run, double smoothing = 0.3) {
+            auto blend = [&](double& average, double time) {
+                if (time > 0.0)
+                    average = average > 0.0 ? average + smoothing * (time - average) : time;
+            };
+            blend(plainTime, run.plainTime);
+            blend(recordingTime, run.recordingTime);
+            blend(sweepTime, run.sweepTime);
+            if (run.tapeMemory > 0)
+                tapeMemory = run.tapeMemory;
+            ++samples;
+        }
+    };
+
+    /* Chooses the cheapest mode from the declared input/output counts and the cost model.
+     * A non-zero tapeMemoryLimit excludes the adjoint modes for recordings that would not fit.
+     */
+    inline ADMode selectADMode(Size nInputs,
+                               Size nOutputs,
+                               const TapeCostModel& cost,
+                               std::size_t tapeMemoryLimit = 0) {
+        QL_REQUIRE(nOutputs > 0, "pricing task without outputs");
+        ADMode adjointMode = nOutputs == 1 ? ADMode::Reverse : ADMode::VectorReverse;
+        if (tapeMemoryLimit != 0 && cost.tapeMemory > tapeMemoryLimit)
+            return ADMode::ForwardDifference;
+        return cost.cost(ADMode::ForwardDifference, nInputs, nOutputs) <
+                       cost.cost(adjointMode, nInputs, nOutputs) ?
+                   ADMode::ForwardDifference :
+                   adjointMode;
+    }
+
+    // Count-only selection, for tasks that have not been measured yet.  It assumes the
+    // typical operator-overloading overheads of recording (3x) and sweeping (1x) relative to
+    // a plain evaluation.
+    inline ADMode selectADMode(Size nInputs, Size nOutputs) {
+        TapeCostModel typical;
+        typical.plainTime = 1.0;
+        typical.recordingTime = 3.0;
+        typical.sweepTime = 1.0;
+        return selectADMode(nInputs, nOutputs, typical);
+    }
+
+#ifndef QLRISKS_DISABLE_AAD
+
+    namespace detail {
+
+        inline double secondsSince(std::chrono::steady_clock::time_point start) {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+                .count();
+        }
+
+        inline Real::tape_type& activeTape() {
+            auto tape = Real::tape_type::getActive();
+            QL_REQUIRE(tape != nullptr, "no active tape on this thread");
+            return *tape;
+        }
+
+    }
+
+    /* Measures the cost model of a task with the signature
+     *     std::vector<Real> task(const std::vector<Real>& inputs)
+     * by running it once passively, once while recording, and sweeping the recording once.
+     * The active tape is cleared.
+     */
+    template <class Task>
+    TapeCostModel measureTapeCost(const Task& task, const std::vector<double>& inputs) {
+        auto& tape = detail::activeTape();
+        TapeCostModel cost;
+
+        std::vector<Real> x(inputs.begin(), inputs.end());
+        auto start = std::chrono::steady_clock::now();
+        task(x);
+        cost.plainTime = detail::secondsSince(start);
+
+        tape.clearAll();
+        std::vector<Real> xAD(inputs.begin(), inputs.end());
+        tape.registerInputs(xAD);
+        tape.newRecording();
+        start = std::chrono::steady_clock::now();
+        std::vector<Real> y = task(xAD);
+        cost.recordingTime = detail::secondsSince(start);
+        QL_REQUIRE(!y.empty(), "pricing task without outputs");
+        cost.tapeMemory = tape.getMemory();
+
+        tape.registerOutput(y.front());
+        derivative(y.front()) = 1.0;
+        start = std::chrono::steady_clock::now();
+        tape.computeAdjoints();
+        cost.sweepTime = detail::secondsSince(start);
+
+        tape.clearAll();
+        cost.samples = 1;
+        return cost;
+    }
+
+    namespace detail {
+
+        // computeJacobian, timing the phases of the selected mode into run if given
+        template <class Task>
+        std::vector<double> computeJacobian(const Task& task,
+                                            const std::vector<double>& inputs,
+                                            ADMode mode,
+                                            std::vector<double>& jacobian,
+                                            double bump,
+                                            TapeCostModel* run) {
+            Size n = inputs.size();
+            std::vector<double> values;
+            auto start = std::chrono::steady_clock::now();
+
+            if (mode == ADMode::ForwardDifference) {
+                std::vector<Real> x(inputs.begin(), inputs.end());
+                std::vector<Real> y = task(x);
+                Size m = y.size();
+                for (auto& yk : y)
+                    values.push_back(value(yk));
+                jacobian.assign(m * n, 0.0);
+                for (Size i = 0; i < n; ++i) {
+                    x[i] += bump;
+                    std::vector<Real> yb = task(x);
+                    for (Size k = 0; k < m; ++k)
+                        jacobian[k * n + i] = (value(yb[k]) - values[k]) / bump;
+                    x[i] = inputs[i];
+                }
+                if (run != nullptr)
+                    run->plainTime = secondsSince(start) / static_cast<double>(n + 1);
+                return values;
+            }
+
+            auto& tape = activeTape();
+            tape.clearAll();
+            std::vector<Real> x(inputs.begin(), inputs.end());
+            tape.registerInputs(x);
+            tape.newRecording();
+            std::vector<Real> y = task(x);
+            Size m = y.size();
+            QL_REQUIRE(mode == ADMode::VectorReverse || m == 1,
+                       "reverse mode requires a scalar task, got " << m << " outputs");
+            for (auto& yk : y) {
+                tape.registerOutput(yk);
+                values.push_back(value(yk));
+            }
+            if (run != nullptr) {
+                run->recordingTime = secondsSince(start);
+                run->tapeMemory = tape.getMemory();
+                start = std::chrono::steady_clock::now();
+            }
+
+            // one sweep per output over the same recording
+            jacobian.resize(m * n);
+            for (Size k = 0; k < m; ++k) {
+                tape.clearDerivatives();
+                derivative(y[k]) = 1.0;
+                tape.computeAdjoints();
+                for (Size i = 0; i < n; ++i)
+                    jacobian[k * n + i] = derivative(x[i]);
+            }
+            if (run != nullptr && m > 0)
+                run->sweepTime = secondsSince(start) / static_cast<double>(m);
+            return values;
+        }
+
+    }
+
+    /* Computes the values and the m x n Jacobian (row-major) of a task in the given mode,
+     * using the active tape.  bump is only used in forward-difference mode.
+     */
+    template <class Task>
+    std::vector<double> computeJacobian(const Task& task,
+                                        const std::vector<double>& inputs,
+                                        ADMode mode,
+                                        std::vector<double>& jacobian,
+                                        double bump = 1e-5) {
+        return detail::computeJacobian(task, inputs, mode, jacobian, bump, nullptr);
+    }
+
+    /* Selects the cheapest mode from the cost model of the task, and computes the Jacobian in
+     * that mode.  The model is owned by the caller and kept for the task across calls: it is
+     * measured on the first call only, and the phases timed by each call are folded into it.
+     */
+    template <class Task>
+    std::vector<double> differentiateTask(const Task& task,
+                                          const std::vector<double>& inputs,
+                                          Size nOutputs,
+                                          std::vector<double>& jacobian,
+                                          TapeCostModel& cost,
+                                          ADMode* selectedMode = nullptr,
+                                          std::size_t tapeMemoryLimit = 0) {
+        if (!cost.measured())
+            cost = measureTapeCost(task, inputs);
+        ADMode mode = selectADMode(inputs.size(), nOutputs, cost, tapeMemoryLimit);
+        if (selectedMode != nullptr)
+            *selectedMode = mode;
+        TapeCostModel run;
+        std::vector<double> values =
+            detail::computeJacobian(task, inputs, mode, jacobian, 1e-5, &run);
+        cost.observe(run);
+        return values;
+    }
+
+#endif
+
+}
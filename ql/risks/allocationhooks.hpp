@@ -0,0 +1,168 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/types.hpp>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace QuantLib {
+
+    /* Heap allocations of a thread, counted by the allocation hooks: the number of
+     * allocations and deallocations, the bytes allocated, and a histogram of the
+     * allocation sizes.  An aggregate, so that the counters of a thread need no
+     * initialisation before the first allocation.
+     */
+    struct AllocationCounts {
+        enum { NumberOfBuckets = 8 };
+
+        std::uint64_t allocations, deallocations, bytes;
+        std::uint64_t sizes[NumberOfBuckets];
+
+        AllocationCounts& operator+=(const AllocationCounts& other) {
+            allocations += other.allocations;
+            deallocations += other.deallocations;
+            bytes += other.bytes;
+            for (Size b = 0; b < NumberOfBuckets; ++b)
+                sizes[b] += other.sizes[b];
+            return *this;
+        }
+
+        // buckets of allocations up to 16, 32, 64, 128, 256, 1K and 4K bytes, and larger
+        static Size bucket(std::size_t size) {
+            static const std::size_t limits[] = {16, 32, 64, 128, 256, 1024, 4096};
+            Size b = 0;
+            while (b < NumberOfBuckets - 1 && size > limits[b])
+                ++b;
+            return b;
+        }
+
+        static const char* bucketName(Size b) {
+            static const char* names[] = {"<=16", "<=32", "<=64", "<=128",
+                                          "<=256", "<=1K", "<=4K", ">4K"};
+            return names[b];
+        }
+    };
+
+    inline AllocationCounts operator-(AllocationCounts a, const AllocationCounts& b) {
+        a.allocations -= b.allocations;
+        a.deallocations -= b.deallocations;
+        a.bytes -= b.bytes;
+        for (Size k = 0; k < AllocationCounts::NumberOfBuckets; ++k)
+            a.sizes[k] -= b.sizes[k];
+        return a;
+    }
+
+    namespace detail {
+
+        inline AllocationCounts& threadAllocations() {
+            static thread_local AllocationCounts counts;
+            return counts;
+        }
+
+        inline bool& allocationHooksFlag() {
+            static bool installed = false;
+            return installed;
+        }
+
+        inline void* countedAllocate(std::size_t size) {
+            AllocationCounts& counts = threadAllocations();
+            ++counts.allocations;
+            counts.bytes += size;
+            ++counts.sizes[AllocationCounts::bucket(size)];
+            for (;;) {
+                void* p = std::malloc(size == 0 ? 1 : size);
+                if (p != nullptr)
+                    return p;
+                std::new_handler handler = std::get_new_handler();
+                if (handler == nullptr)
+                    throw std::bad_alloc();
+                handler();
+            }
+        }
+
+        inline void* countedAllocate(std::size_t size, const std::nothrow_t&) noexcept {
+            try {
+                return countedAllocate(size);
+            } catch (...) {
+                return nullptr;
+            }
+        }
+
+        inline void countedFree(void* p) noexcept {
+            if (p == nullptr)
+                return;
+            ++threadAllocations().deallocations;
+            std::free(p);
+        }
+
+    }
+
+    // whether the allocation hooks are defined in the program
+    inline bool allocationHooksInstalled() { return detail::allocationHooksFlag(); }
+
+    // the allocations of the calling thread since it started, if the hooks are installed
+    inline AllocationCounts threadAllocations() { return detail::threadAllocations(); }
+
+}
+
+/* Replaces the global operator new and delete with versions counting the allocations of
+ * each thread, for the allocation profiles of PerfProfile.  The hooks are opt-in: this
+ * macro expands to nothing unless QuantLib-Risks is configured with
+ * QLRISKS_ENABLE_ALLOCATION_HOOKS.  It must be used once in a program, at global scope
+ * in one of its source files, e.g. next to main().
+ */
+#ifdef QLRISKS_ENABLE_ALLOCATION_HOOKS
+#    define QLRISKS_DEFINE_ALLOCATION_HOOKS                                                      \
+        namespace QuantLib {                                                                     \
+            namespace detail {                                                                   \
+                bool allocationHooksDefined = (allocationHooksFlag() = true);                    \
+            }                                                                                    \
+        }                                                                                        \
+        void* operator new(std::size_t size) { return QuantLib::detail::countedAllocate(size); } \
+        void* operator new[](std::size_t size) {                                                 \
+            return QuantLib::detail::countedAllocate(size);                                      \
+        }                                                                                        \
+        void* operator new(std::size_t size, const std::nothrow_t& tag) noexcept {               \
+            return QuantLib::detail::countedAllocate(size, tag);                                 \
+        }                                                                                        \
+        void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {             \
+            return QuantLib::detail::countedAllocate(size, tag);                                 \
+        }                                                                                        \
+        void operator delete(void* p) noexcept { QuantLib::detail::countedFree(p); }             \
+        void operator delete[](void* p) noexcept { QuantLib::detail::countedFree(p); }           \
+        void operator delete(void* p, std::size_t) noexcept { QuantLib::detail::countedFree(p); } \
+        void operator delete[](void* p, std::size_t) noexcept {                                  \
+            QuantLib::detail::countedFree(p);                                                    \
+        }                                                                                        \
+        void operator delete(void* p, const std::nothrow_t&) noexcept {                          \
+            QuantLib::detail::countedFree(p);                                                    \
+        }                                                                                        \
+        void operator delete[](void* p, const std::nothrow_t&) noexcept {                        \
+            QuantLib::detail::countedFree(p);                                                    \
+        }
+#else
+#    define QLRISKS_DEFINE_ALLOCATION_HOOKS
+#endif
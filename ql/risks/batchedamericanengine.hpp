@@ -0,0 +1,244 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/exercise.hpp>
+#include <ql/instruments/payoffs.hpp>
+#include <ql/math/comparison.hpp>
+#include <ql/processes/blackscholesprocess.hpp>
+#include <ql/risks/adjointnode.hpp>
+#include <ql/risks/normalnodes.hpp>
+#include <cmath>
+#include <vector>
+
+namespace QuantLib {
+
+    /* A book of American vanilla options in structure-of-arrays form, priced with the
+     * Barone-Adesi and Whaley approximation all at once.
+     *
+     * BaroneAdesiWhaleyApproximationEngine prices one option at a time, and tapes every
+     * Newton iteration of its critical-price search.  Here the searches run on plain
+     * doubles instead: each iteration loops over the indices of the options not yet
+     * converged, with the same seeds, updates and stopping rule as the engine.
+     * Each critical price is then recorded as one node, with the partials of the
+     * implicit function theorem, and only the closed-form price on top of it is taped.
+     * The values agree with BaroneAdesiWhaleyApproximationEngine; since the options have
+     * separate inputs, one adjoint sweep seeded with all values gives the greeks of every
+     * option of the book.
+     */
+    class AmericanOptionBatch {
+      public:
+        void add(Option::Type type,
+                 const Real& spot,
+                 const Real& strike,
+                 const DiscountFactor& riskFreeDiscount,
+                 const DiscountFactor& dividendDiscount,
+                 const Real& variance) {
+            QL_REQUIRE(spot > 0.0, "negative or null underlying given");
+            QL_REQUIRE(strike > 0.0, "negative or null strike given");
+            QL_REQUIRE(variance > 0.0, "negative or null variance given");
+            types_.push_back(type);
+            spots_.push_back(spot);
+            strikes_.push_back(strike);
+            riskFreeDiscounts_.push_back(riskFreeDiscount);
+            dividendDiscounts_.push_back(dividendDiscount);
+            variances_.push_back(variance);
+        }
+
+        // adds an option with the market data of its process, as the engine reads them
+        void add(const ext::shared_ptr<PlainVanillaPayoff>& payoff,
+                 const ext::shared_ptr<Exercise>& exercise,
+                 const ext::shared_ptr<GeneralizedBlackScholesProcess>& process) {
+            auto ex = ext::dynamic_pointer_cast<AmericanExercise>(exercise);
+            QL_REQUIRE(ex, "non-American exercise given");
+            QL_REQUIRE(!ex->payoffAtExpiry(), "payoff at expiry not handled");
+            Date maturity = ex->lastDate();
+            add(payoff->optionType(), process->stateVariable()->value(), payoff->strike(),
+                process->riskFreeRate()->discount(maturity),
+                process->dividendYield()->discount(maturity),
+                process->blackVolatility()->blackVariance(maturity, payoff->strike()));
+        }
+
+        Size size() const { return types_.size(); }
+
+        const std::vector<Option::Type>& types() const { return types_; }
+        const std::vector<Real>& spots() const { return spots_; }
+        const std::vector<Real>& strikes() const { return strikes_; }
+        const std::vector<DiscountFactor>& riskFreeDiscounts() const {
+            return riskFreeDiscounts_;
+        }
+        const std::vector<DiscountFactor>& dividendDiscounts() const {
+            return dividendDiscounts_;
+        }
+        const std::vector<Real>& variances() const { return variances_; }
+
+        // whether early exercise is never optimal, so that the option is European
+        bool european(Size i) const {
+            return types_[i] == Option::Call && dividendDiscounts_[i] >= 1.0;
+        }
+
+        /* The critical prices of all options (Null<Real>() for the European ones), each
+         * recorded as one node with partials -(dG/dx) / (dG/dS) on the market data x, where
+         * G(S) = 0 is the early-exercise boundary condition solved by the Newton search. */
+        std::vector<Real> criticalPrices(Real tolerance = 1e-6) const {
+            const Size m = size();
+            std::vector<double> S(m), phi(m), K(m), rd(m), qd(m), var(m), sd(m), Q(m);
+            std::vector<double> G(m), slope(m);
+            std::vector<Size> active;
+            for (Size j = 0; j < m; ++j) {
+                if (european(j))
+                    continue;
+                phi[j] = types_[j] == Option::Call ? 1.0 : -1.0;
+                K[j] = plain(strikes_[j]);
+                rd[j] = plain(riskFreeDiscounts_[j]);
+                qd[j] = plain(dividendDiscounts_[j]);
+                var[j] = plain(variances_[j]);
+                sd[j] = std::sqrt(var[j]);
+                Q[j] = quadraticRoot(phi[j], rd[j], qd[j], var[j], close(rd[j], 1.0, 1000));
+                S[j] = seed(phi[j], K[j], rd[j], qd[j], var[j]);
+                active.push_back(j);
+            }
+
+            std::vector<Size> pending;
+            for (Size iteration = 0; !active.empty(); ++iteration) {
+                QL_REQUIRE(iteration < 1000, "critical price search did not converge");
+                // the boundary condition and its slope for all options still searching
+                for (Size j : active) {
+                    double F = S[j] * qd[j] / rd[j];
+                    double d1 = (std::log(F / K[j]) + 0.5 * var[j]) / sd[j];
+                    double Nd1 = detail::cumulativeNormal(phi[j] * d1);
+                    double Nd2 = detail::cumulativeNormal(phi[j] * (d1 - sd[j]));
+                    double black = phi[j] * (F * Nd1 - K[j] * Nd2) * rd[j];
+                    G[j] = phi[j] * (S[j] - K[j]) - black -
+                           phi[j] * (1.0 - qd[j] * Nd1) * S[j] / Q[j];
+                    // d(RHS)/dS, named bi in the engine
+                    double b = phi[j] * qd[j] * Nd1 * (1.0 - 1.0 / Q[j]) +
+                               (phi[j] - qd[j] * detail::normalDensity(d1) / sd[j]) / Q[j];
+                    slope[j] = phi[j] - b;
+                }
+                pending.clear();
+                for (Size j : active) {
+                    if (std::fabs(G[j]) / K[j] > tolerance) {
+                        S[j] -= G[j] / slope[j];
+                        pending.push_back(j);
+                    }
+                }
+                active.swap(pending);
+            }
+
+            std::vector<Real> prices(m, Null<Real>());
+            CumulativeNormalNode N;
+            for (Size j = 0; j < m; ++j) {
+                if (european(j))
+                    continue;
+                // G at the critical price, taped for its dependence on the market data
+                const Real& strike = strikes_[j];
+                const DiscountFactor &riskFreeDiscount = riskFreeDiscounts_[j],
+                                     &dividendDiscount = dividendDiscounts_[j];
+                Real stdDev = std::sqrt(variances_[j]);
+                Real forward = S[j] * dividendDiscount / riskFreeDiscount;
+                Real d1 = (std::log(forward / strike) + 0.5 * variances_[j]) / stdDev;
+                Real Qj = quadraticRoot(phi[j], riskFreeDiscount, dividendDiscount, variances_[j],
+                                        close(riskFreeDiscount, 1.0, 1000));
+                Real Gj = phi[j] * (S[j] - strike) -
+                          blackFormulaNode(types_[j], strike, forward, stdDev) * riskFreeDiscount -
+                          phi[j] * (1.0 - dividendDiscount * N(phi[j] * d1)) * S[j] / Qj;
+                prices[j] = recordNode(S[j], {{Gj, -1.0 / slope[j]}});
+            }
+            return prices;
+        }
+
+        // the values of all options, as given by BaroneAdesiWhaleyApproximationEngine
+        std::vector<Real> baroneAdesiWhaleyValues(Real tolerance = 1e-6) const {
+            std::vector<Real> criticals = criticalPrices(tolerance);
+            std::vector<Real> values(size());
+            CumulativeNormalNode N;
+            for (Size j = 0; j < size(); ++j) {
+                const Real &spot = spots_[j], &strike = strikes_[j], &variance = variances_[j];
+                const DiscountFactor &riskFreeDiscount = riskFreeDiscounts_[j],
+                                     &dividendDiscount = dividendDiscounts_[j];
+                Real stdDev = std::sqrt(variance);
+                Real black = blackFormulaNode(types_[j], strike,
+                                              spot * dividendDiscount / riskFreeDiscount, stdDev,
+                                              riskFreeDiscount);
+                if (european(j)) {
+                    values[j] = black;
+                    continue;
+                }
+                const Real& Sk = criticals[j];
+                double phi = types_[j] == Option::Call ? 1.0 : -1.0;
+                Real forwardSk = Sk * dividendDiscount / riskFreeDiscount;
+                Real d1 = (std::log(forwardSk / strike) + 0.5 * variance) / stdDev;
+                Real Q = quadraticRoot(phi, riskFreeDiscount, dividendDiscount, variance,
+                                       close(riskFreeDiscount, 1.0, 1000));
+                Real a = phi * (Sk / Q) * (1.0 - dividendDiscount * N(phi * d1));
+                if (phi * (Sk - spot) > 0.0)
+                    values[j] = black + a * std::pow(spot / Sk, Q);
+                else
+                    values[j] = phi * (spot - strike);
+            }
+            return values;
+        }
+
+      private:
+#ifndef QLRISKS_DISABLE_AAD
+        static double plain(const Real& x) { return xad::value(x); }
+#else
+        static double plain(double x) { return x; }
+#endif
+
+        // the root Q of the quadratic equation of the approximation, with sign phi
+        template <class T>
+        static T quadraticRoot(double phi, const T& riskFreeDiscount, const T& dividendDiscount,
+                               const T& variance, bool flat) {
+            T n = 2.0 * std::log(dividendDiscount / riskFreeDiscount) / variance;
+            T k = flat ? T(2.0 / variance) :
+                         T(-2.0 * std::log(riskFreeDiscount) /
+                           (variance * (1.0 - riskFreeDiscount)));
+            return (-(n - 1.0) + phi * std::sqrt((n - 1.0) * (n - 1.0) + 4.0 * k)) / 2.0;
+        }
+
+        // the starting point of the engine's search
+        static double seed(double phi, double K, double rd, double qd, double var) {
+            double n = 2.0 * std::log(qd / rd) / var;
+            double m = -2.0 * std::log(rd) / var;
+            double bT = std::log(qd / rd);
+            double qu = (-(n - 1.0) + phi * std::sqrt((n - 1.0) * (n - 1.0) + 4.0 * m)) / 2.0;
+            double Su = K / (1.0 - 1.0 / qu);
+            if (phi > 0.0) {
+                double h = -(bT + 2.0 * std::sqrt(var)) * K / (Su - K);
+                return K + (Su - K) * (1.0 - std::exp(h));
+            } else {
+                double h = (bT - 2.0 * std::sqrt(var)) * K / (K - Su);
+                return Su + (K - Su) * std::exp(h);
+            }
+        }
+
+        std::vector<Option::Type> types_;
+        std::vector<Real> spots_, strikes_;
+        std::vector<DiscountFactor> riskFreeDiscounts_, dividendDiscounts_;
+        std::vector<Real> variances_;
+    };
+
+}
@@ -0,0 +1,256 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/errors.hpp>
+#include <ql/risks/adjointnode.hpp>
+#include <ql/risks/admode.hpp>
+#include <ql/risks/riskjournal.hpp>
+#include <ql/shared_ptr.hpp>
+#include <ql/time/date.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace QuantLib {
+
+    /* A bootstrapped curve with the Jacobian of its nodes to the quotes it was built from.
+     *
+     * Stored after the first bootstrap of a market snapshot, it rebuilds the curve for the
+     * same quotes without solving again: restoreCurve() records each node as one tape node
+     * depending on the quotes, so that sensitivities to the quotes flow through the restored
+     * curve as through the bootstrapped one.
+     */
+    struct CurveSnapshot {
+        std::uint64_t key = 0;         // curveSnapshotKey() of the quotes and the curve
+        std::string conventions;       // a tag for the instruments, day counts, interpolation
+        std::vector<Date> dates;       // the pillars, starting at the reference date
+        std::vector<double> values;    // the node values (e.g. discount factors)
+        Size quotes = 0;
+        std::vector<double> jacobian;  // nodes x quotes, row-major
+    };
+
+    /* The key a snapshot is stored and looked up under.  The quote values alone do not
+     * identify a curve: the same quotes on another date, or bootstrapped with other
+     * instruments or interpolation, give other nodes.  The conventions are any tag that
+     * differs between such curves, e.g. "eonia;cubic;act365".
+     */
+    inline std::uint64_t curveSnapshotKey(const std::vector<double>& quotes,
+                                          const Date& referenceDate,
+                                          const std::string& conventions) {
+        auto serial = static_cast<std::int64_t>(referenceDate.serialNumber());
+        std::uint64_t hash = detail::fnv1a(&serial, sizeof(serial), hashSnapshot(quotes));
+        return detail::fnv1a(conventions.data(), conventions.size(), hash);
+    }
+
+#ifndef QLRISKS_DISABLE_AAD
+
+    /* Bootstraps ext::shared_ptr<Curve> build(const std::vector<Real>& quotes), where Curve
+     * is an interpolated curve such as PiecewiseYieldCurve, and takes its snapshot, keyed
+     * by the quotes, the reference date of the curve and the given conventions tag.  The
+     * Jacobian is computed with one sweep per node on the active tape.
+     */
+    template <class Builder>
+    CurveSnapshot takeCurveSnapshot(const Builder& build,
+                                    const std::vector<double>& quotes,
+                                    const std::string& conventions) {
+        CurveSnapshot snapshot;
+        snapshot.conventions = conventions;
+        snapshot.quotes = quotes.size();
+        auto nodes = [&](const std::vector<Real>& x) {
+            auto curve = build(x);
+            snapshot.dates = curve->dates();
+            return std::vector<Real>(curve->data().begin(), curve->data().end());
+        };
+        snapshot.values = computeJacobian(nodes, quotes, ADMode::VectorReverse,
+                                          snapshot.jacobian);
+        snapshot.key = curveSnapshotKey(quotes, snapshot.dates.front(), conventions);
+        return snapshot;
+    }
+
+#endif
+
+    /* Rebuilds the curve of a snapshot as a Curve(dates, nodes, args...), e.g. an
+     * InterpolatedDiscountCurve<Cubic> for a PiecewiseYieldCurve<Discount, Cubic>, with
+     * the nodes depending on the given quotes, which must be those of the snapshot.
+     */
+    template <class Curve, class... Args>
+    ext::shared_ptr<Curve>
+    restoreCurve(const CurveSnapshot& snapshot, const std::vector<Real>& quotes, Args&&... args) {
+        std::vector<double> values;
+        for (const auto& q : quotes) {
+#ifndef QLRISKS_DISABLE_AAD
+            values.push_back(xad::value(q));
+#else
+            values.push_back(q);
+#endif
+        }
+        QL_REQUIRE(!snapshot.dates.empty(), "empty curve snapshot");
+        QL_REQUIRE(quotes.size() == snapshot.quotes &&
+                       curveSnapshotKey(values, snapshot.dates.front(), snapshot.conventions) ==
+                           snapshot.key,
+                   "quotes differ from those of the curve snapshot");
+
+        std::vector<Real> nodes;
+        nodes.reserve(snapshot.values.size());
+        for (Size k = 0; k < snapshot.values.size(); ++k) {
+#ifndef QLRISKS_DISABLE_AAD
+            // only the quotes the node depends on
+            std::vector<const Real*> inputs;
+            std::vector<double> partials;
+            for (Size i = 0; i < quotes.size(); ++i) {
+                double d = snapshot.jacobian[k * quotes.size() + i];
+                if (d != 0.0) {
+                    inputs.push_back(&quotes[i]);
+                    partials.push_back(d);
+                }
+            }
+            nodes.push_back(detail::recordNode(snapshot.values[k], inputs, partials));
+#else
+            nodes.push_back(snapshot.values[k]);
+#endif
+        }
+        return ext::make_shared<Curve>(snapshot.dates, nodes, std::forward<Args>(args)...);
+    }
+
+    namespace detail {
+
+        const std::uint64_t curveSnapshotMagic = 0x32534351514cULL; // "LQQCS2"
+
+        template <class T>
+        void appendBytes(std::vector<char>& buffer, T x) {
+            const char* bytes = reinterpret_cast<const char*>(&x);
+            buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+        }
+
+        template <class T>
+        bool readBytes(std::istream& in, T& x, std::uint64_t& hash) {
+            if (!in.read(reinterpret_cast<char*>(&x), sizeof(T)))
+                return false;
+            hash = fnv1a(&x, sizeof(T), hash);
+            return true;
+        }
+
+    }
+
+    /* Writes a snapshot to a binary file, in the native byte order, with a checksum.  The
+     * file is written under a temporary name and renamed, so that a reader never sees a
+     * partial snapshot.
+     */
+    inline void saveCurveSnapshot(const std::string& path, const CurveSnapshot& snapshot) {
+        QL_REQUIRE(snapshot.jacobian.size() == snapshot.values.size() * snapshot.quotes &&
+                       snapshot.dates.size() == snapshot.values.size(),
+                   "inconsistent curve snapshot");
+        std::vector<char> buffer;
+        detail::appendBytes(buffer, detail::curveSnapshotMagic);
+        detail::appendBytes(buffer, snapshot.key);
+        detail::appendBytes(buffer, static_cast<std::uint64_t>(snapshot.values.size()));
+        detail::appendBytes(buffer, static_cast<std::uint64_t>(snapshot.quotes));
+        detail::appendBytes(buffer, static_cast<std::uint64_t>(snapshot.conventions.size()));
+        buffer.insert(buffer.end(), snapshot.conventions.begin(), snapshot.conventions.end());
+        for (const auto& d : snapshot.dates)
+            detail::appendBytes(buffer, static_cast<std::int64_t>(d.serialNumber()));
+        for (double x : snapshot.values)
+            detail::appendBytes(buffer, x);
+        for (double x : snapshot.jacobian)
+            detail::appendBytes(buffer, x);
+        detail::appendBytes(buffer,
+                            detail::fnv1a(buffer.data(), buffer.size(), detail::fnvOffsetBasis));
+
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            QL_REQUIRE(out, "failed to write curve snapshot " << temporary);
+        }
+        if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+            // renaming over an existing file fails on some platforms
+            std::remove(path.c_str());
+            QL_REQUIRE(std::rename(temporary.c_str(), path.c_str()) == 0,
+                       "failed to write curve snapshot " << path);
+        }
+    }
+
+    /* Reads the snapshot in a file, if it exists, is intact and was taken for the given
+     * curveSnapshotKey(); returns false otherwise.
+     */
+    inline bool
+    loadCurveSnapshot(const std::string& path, std::uint64_t key, CurveSnapshot& snapshot) {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in)
+            return false;
+        auto fileSize = static_cast<std::uint64_t>(in.tellg());
+        in.seekg(0);
+
+        std::uint64_t checksum = detail::fnvOffsetBasis, magic, storedKey, nNodes, nQuotes, nTag;
+        if (!detail::readBytes(in, magic, checksum) ||
+            !detail::readBytes(in, storedKey, checksum) ||
+            !detail::readBytes(in, nNodes, checksum) || !detail::readBytes(in, nQuotes, checksum) ||
+            !detail::readBytes(in, nTag, checksum) || magic != detail::curveSnapshotMagic ||
+            storedKey != key)
+            return false;
+        // the sizes are bounded by the file before they are multiplied, so that a corrupt
+        // header neither overflows nor allocates more than the file holds
+        const std::uint64_t doubles = fileSize / sizeof(double);
+        if (nTag > fileSize || nNodes > doubles || nQuotes > doubles ||
+            (nNodes > 0 && nQuotes + 2 > doubles / nNodes))
+            return false;
+
+        CurveSnapshot result;
+        result.key = storedKey;
+        result.quotes = static_cast<Size>(nQuotes);
+        result.conventions.resize(static_cast<std::size_t>(nTag));
+        if (nTag > 0) {
+            if (!in.read(&result.conventions[0], static_cast<std::streamsize>(nTag)))
+                return false;
+            checksum = detail::fnv1a(result.conventions.data(), result.conventions.size(),
+                                     checksum);
+        }
+        result.dates.reserve(nNodes);
+        for (std::uint64_t k = 0; k < nNodes; ++k) {
+            std::int64_t serial;
+            if (!detail::readBytes(in, serial, checksum))
+                return false;
+            result.dates.emplace_back(static_cast<Date::serial_type>(serial));
+        }
+        result.values.resize(nNodes);
+        for (double& x : result.values)
+            if (!detail::readBytes(in, x, checksum))
+                return false;
+        result.jacobian.resize(nNodes * nQuotes);
+        for (double& x : result.jacobian)
+            if (!detail::readBytes(in, x, checksum))
+                return false;
+        std::uint64_t stored, unused = 0;
+        if (!detail::readBytes(in, stored, unused) || stored != checksum)
+            return false;
+
+        snapshot = std::move(result);
+        return true;
+    }
+
+}
@@ -0,0 +1,144 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/errors.hpp>
+#include <ql/risks/risksession.hpp>
+#include <ql/types.hpp>
+#include <XAD/XAD.hpp>
+#include <algorithm>
+#include <vector>
+
+namespace QuantLib {
+
+    /* How the sensitivity to an input is obtained.  Inputs that only flow through
+     * non-differentiable code (integer day counts, discontinuous payoffs or barrier
+     * checks) get zero or wrong adjoints and should be bumped instead.
+     */
+    enum class SensitivityMethod { Adjoint, Bump };
+
+    namespace detail {
+
+        // central differences for the inputs in [begin, end) of bumped
+        template <class Pricer>
+        void centralDifferences(const Pricer& pricer,
+                                const std::vector<double>& inputs,
+                                const std::vector<Size>& bumped,
+                                Size begin,
+                                Size end,
+                                double bump,
+                                std::vector<double>& gradient) {
+            std::vector<Real> x(inputs.begin(), inputs.end());
+            for (Size k = begin; k < end; ++k) {
+                Size i = bumped[k];
+                x[i] = inputs[i] + bump;
+                double up = xad::value(pricer(x));
+                x[i] = inputs[i] - bump;
+                double down = xad::value(pricer(x));
+                x[i] = inputs[i];
+                gradient[i] = (up - down) / (2.0 * bump);
+            }
+        }
+
+    }
+
+    /* Value and gradient of Real pricer(const std::vector<Real>& inputs), with the method
+     * chosen per input: one AAD pass on the active tape for the Adjoint inputs, and central
+     * differences for the Bump inputs.  Only the Adjoint inputs are registered on the tape.
+     *
+     * With threads > 1, the bumped revaluations are spread over that many threads, each in a
+     * RiskSession with the evaluation date, settings and fixings of the calling thread, so
+     * that they are priced on the same date as the AAD pass.  This requires QuantLib built
+     * with QL_ENABLE_SESSIONS, and a pricer which builds its QuantLib objects in each call
+     * instead of sharing them between threads.
+     *
+     * Without AAD, all inputs are bumped.
+     */
+    template <class Pricer>
+    double computeHybridGradient(const Pricer& pricer,
+                                 const std::vector<double>& inputs,
+                                 const std::vector<SensitivityMethod>& methods,
+                                 std::vector<double>& gradient,
+                                 double bump = 1e-5,
+                                 Size threads = 1) {
+        QL_REQUIRE(methods.size() == inputs.size(),
+                   "sensitivity methods given for " << methods.size() << " inputs, "
+                                                    << inputs.size() << " expected");
+        QL_REQUIRE(threads > 0, "at least one thread required");
+        QL_REQUIRE(threads == 1 || sessionsEnabled(),
+                   "bumping on several threads requires QuantLib built with QL_ENABLE_SESSIONS");
+        gradient.assign(inputs.size(), 0.0);
+
+        std::vector<Size> adjoint, bumped;
+        for (Size i = 0; i < inputs.size(); ++i) {
+#ifndef QLRISKS_DISABLE_AAD
+            if (methods[i] == SensitivityMethod::Adjoint) {
+                adjoint.push_back(i);
+                continue;
+            }
+#endif
+            bumped.push_back(i);
+        }
+
+        double v;
+#ifndef QLRISKS_DISABLE_AAD
+        if (!adjoint.empty()) {
+            auto tape = Real::tape_type::getActive();
+            QL_REQUIRE(tape != nullptr, "no active tape on this thread");
+            tape->clearAll();
+            std::vector<Real> x(inputs.begin(), inputs.end());
+            for (Size i : adjoint)
+                tape->registerInput(x[i]);
+            tape->newRecording();
+            Real y = pricer(x);
+            tape->registerOutput(y);
+            derivative(y) = 1.0;
+            tape->computeAdjoints();
+            for (Size i : adjoint)
+                gradient[i] = derivative(x[i]);
+            v = value(y);
+            tape->clearAll();
+        } else
+#endif
+        {
+            std::vector<Real> x(inputs.begin(), inputs.end());
+            v = xad::value(pricer(x));
+        }
+
+        Size nThreads = std::min(threads, bumped.size());
+        if (nThreads <= 1) {
+            detail::centralDifferences(pricer, inputs, bumped, 0, bumped.size(), bump, gradient);
+        } else {
+            // each bumped input in a session on the caller's state; each thread writes its
+            // own entries of the gradient
+            runRiskSessions(currentSessionContext(), bumped.size(), nThreads,
+                            [&](Size k, RiskSession&) {
+                                detail::centralDifferences(pricer, inputs, bumped, k, k + 1,
+                                                           bump, gradient);
+                            });
+        }
+        return v;
+    }
+
+}
@@ -0,0 +1,265 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/exercise.hpp>
+#include <ql/instruments/swaption.hpp>
+#include <ql/models/shortrate/onefactormodels/hullwhite.hpp>
+#include <ql/risks/adjointnode.hpp>
+#include <ql/risks/normalnodes.hpp>
+#include <cmath>
+#include <map>
+#include <vector>
+
+namespace QuantLib {
+
+    /* Prices a basket of European swaptions (e.g. the calibration helpers of a model) in
+     * the Hull-White model with Jamshidian's decomposition, all swaptions at once.
+     *
+     * Each swaption gets its own JamshidianBasketSwaptionEngine on the shared basket.  The
+     * first swaption priced after the model changes prices the whole basket, with:
+     * - discount factors looked up once per date for all swaptions,
+     * - the zero-bond options of all swaptions in one loop,
+     * - the critical rates solved together by Newton iterations on plain doubles, and
+     *   recorded on the tape with their implicit-function partials instead of taping the
+     *   solver iterations.
+     * The prices agree with JamshidianSwaptionEngine.
+     */
+    class JamshidianBasket : public Observer {
+      public:
+        explicit JamshidianBasket(ext::shared_ptr<HullWhite> model) : model_(std::move(model)) {
+            registerWith(model_);
+        }
+
+        const ext::shared_ptr<HullWhite>& model() const { return model_; }
+
+        Size addSwaption() {
+            swaptions_.emplace_back();
+            return swaptions_.size() - 1;
+        }
+
+        Real value(Size id, const Swaption::arguments& arguments) {
+            QL_REQUIRE(arguments.settlementType == Settlement::Physical,
+                       "cash-settled swaptions not priced by the Jamshidian basket");
+            QL_REQUIRE(arguments.exercise->type() == Exercise::European,
+                       "cannot use the Jamshidian decomposition on exotic swaptions");
+            QL_REQUIRE(arguments.nominal != Null<Real>(),
+                       "non-constant nominals are not supported yet");
+
+            Entry& e = swaptions_.at(id);
+            Date exercise = arguments.exercise->date(0);
+            std::vector<double> coupons(arguments.fixedCoupons.size());
+            for (Size i = 0; i < coupons.size(); ++i)
+                coupons[i] = plain(arguments.fixedCoupons[i]);
+            if (!e.priced || exercise != e.exercise || arguments.fixedPayDates != e.payDates ||
+                coupons != e.couponValues || plain(arguments.nominal) != plain(e.nominal) ||
+                arguments.type != e.type) {
+                e.exercise = exercise;
+                e.payDates = arguments.fixedPayDates;
+                e.coupons = arguments.fixedCoupons;
+                e.couponValues = coupons;
+                e.nominal = arguments.nominal;
+                e.type = arguments.type;
+                e.known = true;
+                e.priced = false;
+                priceBasket();
+            }
+            return e.npv;
+        }
+
+        void update() override {
+            for (auto& e : swaptions_)
+                e.priced = false;
+        }
+
+      private:
+        struct Entry {
+            bool known = false, priced = false;
+            Date exercise;
+            std::vector<Date> payDates;
+            std::vector<Real> coupons;
+            std::vector<double> couponValues;
+            Real nominal;
+            Swap::Type type;
+            Real npv;
+        };
+
+        // a payment at t after the exercise time T, with P(T, t) = A exp(-B r)
+        struct Bond {
+            const DiscountFactor* discount; // P(0, t)
+            Real amount, A, B;
+        };
+
+#ifndef QLRISKS_DISABLE_AAD
+        static double plain(const Real& x) { return xad::value(x); }
+#else
+        static double plain(double x) { return x; }
+#endif
+
+        static Real B(const Real& a, Time t) {
+            return a < std::sqrt(QL_EPSILON) ? Real(t) : Real((1.0 - std::exp(-a * t)) / a);
+        }
+
+        void priceBasket() {
+            const Handle<YieldTermStructure>& curve = model_->termStructure();
+            const Date reference = curve->referenceDate();
+            const DayCounter dc = curve->dayCounter();
+            const Real a = model_->a(), sigma = model_->sigma();
+
+            std::map<Date, DiscountFactor> discounts;
+            auto discount = [&](const Date& d) -> const DiscountFactor& {
+                auto it = discounts.find(d);
+                if (it == discounts.end())
+                    it = discounts.emplace(d, curve->discount(d)).first;
+                return it->second;
+            };
+
+            std::vector<Size> pending, firstBond;
+            std::vector<Real> exerciseDiscounts, variances, nominals;
+            std::vector<Bond> bonds;
+            for (Size k = 0; k < swaptions_.size(); ++k) {
+                const Entry& e = swaptions_[k];
+                if (!e.known || e.priced)
+                    continue;
+                Time T = dc.yearFraction(reference, e.exercise);
+                const DiscountFactor& PT = discount(e.exercise);
+                Rate forward = curve->forwardRate(T, T, Continuous, NoFrequency);
+                // B(0, 2T) / 2 is the variance factor of the short rate at T
+                Real B2T = B(a, 2.0 * T);
+
+                pending.push_back(k);
+                exerciseDiscounts.push_back(PT);
+                variances.push_back(0.5 * B2T);
+                nominals.push_back(e.nominal);
+                firstBond.push_back(bonds.size());
+                for (Size i = 0; i < e.payDates.size(); ++i) {
+                    Time t = dc.yearFraction(reference, e.payDates[i]);
+                    if (t <= T)
+                        continue;
+                    const DiscountFactor& Pt = discount(e.payDates[i]);
+                    Real Bi = B(a, t - T);
+                    Real temp = sigma * Bi;
+                    Real Ai = std::exp(Bi * forward - 0.25 * temp * temp * B2T) * Pt / PT;
+                    Real amount = e.coupons[i];
+                    if (i + 1 == e.payDates.size())
+                        amount += e.nominal;
+                    bonds.push_back({&Pt, amount, Ai, Bi});
+                }
+            }
+            firstBond.push_back(bonds.size());
+
+            std::vector<Real> criticalRates = solveCriticalRates(nominals, bonds, firstBond);
+
+            // the zero-bond options of all swaptions
+            for (Size j = 0; j < pending.size(); ++j) {
+                Entry& e = swaptions_[pending[j]];
+                Option::Type w = e.type == Swap::Payer ? Option::Put : Option::Call;
+                Real sqrtVariance = std::sqrt(variances[j]);
+                e.npv = 0.0;
+                for (Size b = firstBond[j]; b < firstBond[j + 1]; ++b) {
+                    const Bond& bond = bonds[b];
+                    Real strike = bond.A * std::exp(-bond.B * criticalRates[j]);
+                    e.npv += bond.amount * blackFormulaNode(w, exerciseDiscounts[j] * strike,
+                                                            *bond.discount,
+                                                            sigma * bond.B * sqrtVariance);
+                }
+                e.priced = true;
+            }
+        }
+
+        // Critical rates r with F(r) = sum_i c_i A_i exp(-B_i r) - N = 0 for all pending
+        // swaptions, solved on doubles and recorded with their implicit-function derivative
+        // -(dF/dx) / (dF/dr) with respect to any input x.
+        static std::vector<Real> solveCriticalRates(const std::vector<Real>& nominals,
+                                                    const std::vector<Bond>& bonds,
+                                                    const std::vector<Size>& firstBond) {
+            const Size n = nominals.size();
+            std::vector<double> r(n, 0.05), lower(n, -10.0), upper(n, 10.0), slope(n);
+            std::vector<bool> done(n, false);
+            for (Size iteration = 0; iteration < 100; ++iteration) {
+                bool converged = true;
+                for (Size j = 0; j < n; ++j) {
+                    if (done[j])
+                        continue;
+                    // F is decreasing and convex in r
+                    double N = plain(nominals[j]), F = -N, dF = 0.0;
+                    for (Size b = firstBond[j]; b < firstBond[j + 1]; ++b) {
+                        double term = plain(bonds[b].amount) * plain(bonds[b].A) *
+                                      std::exp(-plain(bonds[b].B) * r[j]);
+                        F += term;
+                        dF -= plain(bonds[b].B) * term;
+                    }
+                    slope[j] = dF;
+                    if (F > 0.0)
+                        lower[j] = r[j];
+                    else
+                        upper[j] = r[j];
+                    double next = r[j] - F / dF;
+                    // bisection if Newton leaves the bracket
+                    if (!(next > lower[j] && next < upper[j]))
+                        next = 0.5 * (lower[j] + upper[j]);
+                    done[j] = std::fabs(F) <= 1.0e-14 * N || std::fabs(next - r[j]) < 1.0e-14;
+                    if (std::fabs(F) > 1.0e-14 * N)
+                        r[j] = next;
+                    converged = converged && done[j];
+                }
+                if (converged)
+                    break;
+            }
+
+            std::vector<Real> rates(n);
+            for (Size j = 0; j < n; ++j) {
+                QL_REQUIRE(done[j],
+                           "critical rate of swaption " << j << " not found in 100 iterations");
+                QL_REQUIRE(slope[j] != 0.0, "zero slope at the critical rate of swaption " << j);
+                // F at the critical rate, taped for its dependence on the model and curve
+                Real F = -nominals[j];
+                for (Size b = firstBond[j]; b < firstBond[j + 1]; ++b)
+                    F += bonds[b].amount * bonds[b].A * std::exp(-bonds[b].B * r[j]);
+                rates[j] = recordNode(r[j], {{F, -1.0 / slope[j]}});
+            }
+            return rates;
+        }
+
+        ext::shared_ptr<HullWhite> model_;
+        std::vector<Entry> swaptions_;
+    };
+
+    // Jamshidian engine for one swaption of a JamshidianBasket
+    class JamshidianBasketSwaptionEngine
+    : public GenericEngine<Swaption::arguments, Swaption::results> {
+      public:
+        explicit JamshidianBasketSwaptionEngine(ext::shared_ptr<JamshidianBasket> basket)
+        : basket_(std::move(basket)), id_(basket_->addSwaption()) {
+            registerWith(basket_->model());
+        }
+
+        void calculate() const override { results_.value = basket_->value(id_, arguments_); }
+
+      private:
+        ext::shared_ptr<JamshidianBasket> basket_;
+        Size id_;
+    };
+
+}
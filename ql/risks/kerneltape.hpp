@@ -0,0 +1,418 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/errors.hpp>
+#include <ql/types.hpp>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace QuantLib {
+
+    namespace kernels {
+
+        enum class KernelOp : std::uint8_t {
+            Input,    // a: input index
+            Constant, // constant
+            Add,
+            Sub,
+            Mul,
+            Div,
+            Neg,
+            Exp,
+            Log,
+            Sqrt,
+            Erfc,
+            Abs,
+            Pow,
+            Max,
+            Min,
+            GuardLess,      // records a < b == (constant != 0)
+            GuardLessEqual, // records a <= b == (constant != 0)
+            GuardEqual      // records a == b == (constant != 0)
+        };
+
+        inline bool isGuard(KernelOp op) {
+            return op == KernelOp::GuardLess || op == KernelOp::GuardLessEqual ||
+                   op == KernelOp::GuardEqual;
+        }
+
+        inline bool isUnary(KernelOp op) {
+            return op == KernelOp::Neg || op == KernelOp::Exp || op == KernelOp::Log ||
+                   op == KernelOp::Sqrt || op == KernelOp::Erfc || op == KernelOp::Abs;
+        }
+
+        // One statement of a straight-line kernel, defining the slot of its own index
+        struct KernelStatement {
+            KernelOp op;
+            std::uint32_t a;
+            std::uint32_t b;
+            double constant;
+        };
+
+        class KernelTape;
+
+        /* A real number recording the operations applied to it on the active KernelTape.
+         *
+         * Pricing code templated on its number type is traced once into a straight-line
+         * kernel, which can then be re-evaluated for other inputs, or linearised for repeated
+         * sweeps (see linearisedtape.hpp).  Control flow is fixed by the recording:
+         * comparisons record guards, and evaluating the kernel fails when a guard does not
+         * hold for the new inputs.  Values which do not depend on the inputs are not recorded.
+         */
+        class TracedReal {
+          public:
+            static const std::uint32_t passive = 0xffffffffu;
+
+            TracedReal(double value = 0.0) // NOLINT(google-explicit-constructor)
+            : value_(value), slot_(passive) {}
+
+            double value() const { return value_; }
+            std::uint32_t slot() const { return slot_; }
+            bool isActive() const { return slot_ != passive; }
+
+            TracedReal& operator+=(const TracedReal& x) { return *this = *this + x; }
+            TracedReal& operator-=(const TracedReal& x) { return *this = *this - x; }
+            TracedReal& operator*=(const TracedReal& x) { return *this = *this * x; }
+            TracedReal& operator/=(const TracedReal& x) { return *this = *this / x; }
+
+            friend TracedReal operator+(const TracedReal& x, const TracedReal& y);
+            friend TracedReal operator-(const TracedReal& x, const TracedReal& y);
+            friend TracedReal operator*(const TracedReal& x, const TracedReal& y);
+            friend TracedReal operator/(const TracedReal& x, const TracedReal& y);
+            friend TracedReal operator-(const TracedReal& x);
+            friend bool operator<(const TracedReal& x, const TracedReal& y);
+            friend bool operator<=(const TracedReal& x, const TracedReal& y);
+            friend bool operator==(const TracedReal& x, const TracedReal& y);
+
+          private:
+            friend class KernelTape;
+            TracedReal(double value, std::uint32_t slot) : value_(value), slot_(slot) {}
+
+            double value_;
+            std::uint32_t slot_;
+        };
+
+        /* Straight-line kernel recorded from TracedReal operations.
+         *
+         * A tape is active on its thread while it is alive; recordings cannot be nested.
+         * Statements are in SSA form: statement i defines slot i, and only refers to
+         * earlier slots.
+         */
+        class KernelTape {
+          public:
+            KernelTape() {
+                QL_REQUIRE(active() == nullptr, "a kernel tape is already recording");
+                active() = this;
+            }
+            ~KernelTape() {
+                if (active() == this)
+                    active() = nullptr;
+            }
+            KernelTape(const KernelTape&) = delete;
+            KernelTape& operator=(const KernelTape&) = delete;
+
+            static KernelTape*& active() {
+                static thread_local KernelTape* tape = nullptr;
+                return tape;
+            }
+
+            // stops recording, keeping the statements
+            void deactivate() {
+                if (active() == this)
+                    active() = nullptr;
+            }
+
+            TracedReal input(double value) {
+                TracedReal x(value, push({KernelOp::Input, nInputs_, 0, 0.0}));
+                ++nInputs_;
+                return x;
+            }
+
+            void output(const TracedReal& y) { outputs_.push_back(slotOf(y)); }
+
+            // appends op(x, y) with value v, or the guard of a comparison with result r
+            TracedReal record(KernelOp op, const TracedReal& x, const TracedReal& y, double v) {
+                std::uint32_t a = slotOf(x);
+                std::uint32_t b = isUnary(op) ? 0 : slotOf(y);
+                return TracedReal(v, push({op, a, b, 0.0}));
+            }
+            void guard(KernelOp op, const TracedReal& x, const TracedReal& y, bool r) {
+                std::uint32_t a = slotOf(x), b = slotOf(y);
+                push({op, a, b, r ? 1.0 : 0.0});
+            }
+
+            Size numberOfInputs() const { return nInputs_; }
+            Size numberOfOutputs() const { return outputs_.size(); }
+            const std::vector<KernelStatement>& statements() const { return statements_; }
+            const std::vector<std::uint32_t>& outputs() const { return outputs_; }
+
+            // replaces the recording, e.g. by an optimised or decompressed one
+            void assign(std::vector<KernelStatement> statements,
+                        std::vector<std::uint32_t> outputs) {
+                nInputs_ = 0;
+                for (const auto& s : statements)
+                    if (s.op == KernelOp::Input)
+                        ++nInputs_;
+                statements_ = std::move(statements);
+                outputs_ = std::move(outputs);
+            }
+
+            /* Evaluates the kernel for new inputs; returns false if a guard fails, i.e. the
+             * inputs take a different path through the traced code.
+             */
+            bool forward(const double* inputs, double* outputs) const {
+                std::vector<double> v(statements_.size());
+                if (!evaluate(inputs, v))
+                    return false;
+                for (Size k = 0; k < outputs_.size(); ++k)
+                    outputs[k] = v[outputs_[k]];
+                return true;
+            }
+
+            // values, and adjoints of the inputs for the given output adjoints
+            bool adjoint(const double* inputs,
+                         const double* outputAdjoints,
+                         double* outputs,
+                         double* inputAdjoints) const {
+                std::vector<double> v(statements_.size()), g(statements_.size(), 0.0);
+                if (!evaluate(inputs, v))
+                    return false;
+                for (Size k = 0; k < outputs_.size(); ++k) {
+                    outputs[k] = v[outputs_[k]];
+                    g[outputs_[k]] += outputAdjoints[k];
+                }
+                for (Size i = statements_.size(); i-- > 0;) {
+                    const auto& s = statements_[i];
+                    double gi = g[i];
+                    switch (s.op) {
+                        case KernelOp::Input:
+                            inputAdjoints[s.a] = gi;
+                            break;
+                        case KernelOp::Add:
+                            g[s.a] += gi;
+                            g[s.b] += gi;
+                            break;
+                        case KernelOp::Sub:
+                            g[s.a] += gi;
+                            g[s.b] -= gi;
+                            break;
+                        case KernelOp::Mul:
+                            g[s.a] += gi * v[s.b];
+                            g[s.b] += gi * v[s.a];
+                            break;
+                        case KernelOp::Div:
+                            g[s.a] += gi / v[s.b];
+                            g[s.b] -= gi * v[i] / v[s.b];
+                            break;
+                        case KernelOp::Neg:
+                            g[s.a] -= gi;
+                            break;
+                        case KernelOp::Exp:
+                            g[s.a] += gi * v[i];
+                            break;
+                        case KernelOp::Log:
+                            g[s.a] += gi / v[s.a];
+                            break;
+                        case KernelOp::Sqrt:
+                            g[s.a] += gi * 0.5 / v[i];
+                            break;
+                        case KernelOp::Erfc:
+                            g[s.a] -= gi * 1.1283791670955126 * std::exp(-v[s.a] * v[s.a]);
+                            break;
+                        case KernelOp::Abs:
+                            g[s.a] += v[s.a] < 0.0 ? -gi : gi;
+                            break;
+                        case KernelOp::Pow:
+                            g[s.a] += gi * v[s.b] * std::pow(v[s.a], v[s.b] - 1.0);
+                            g[s.b] += gi * v[i] * std::log(v[s.a]);
+                            break;
+                        case KernelOp::Max:
+                            g[v[s.a] >= v[s.b] ? s.a : s.b] += gi;
+                            break;
+                        case KernelOp::Min:
+                            g[v[s.a] <= v[s.b] ? s.a : s.b] += gi;
+                            break;
+                        default:
+                            break;
+                    }
+                }
+                return true;
+            }
+
+          private:
+            std::uint32_t push(const KernelStatement& s) {
+                statements_.push_back(s);
+                return static_cast<std::uint32_t>(statements_.size() - 1);
+            }
+
+            // materialises passive operands as constants
+            std::uint32_t slotOf(const TracedReal& x) {
+                return x.isActive() ? x.slot() : push({KernelOp::Constant, 0, 0, x.value()});
+            }
+
+            bool evaluate(const double* inputs, std::vector<double>& v) const {
+                for (Size i = 0; i < statements_.size(); ++i) {
+                    const auto& s = statements_[i];
+                    switch (s.op) {
+                        case KernelOp::Input:
+                            v[i] = inputs[s.a];
+                            break;
+                        case KernelOp::Constant:
+                            v[i] = s.constant;
+                            break;
+                        case KernelOp::GuardLess:
+                            if ((v[s.a] < v[s.b]) != (s.constant != 0.0))
+                                return false;
+                            break;
+                        case KernelOp::GuardLessEqual:
+                            if ((v[s.a] <= v[s.b]) != (s.constant != 0.0))
+                                return false;
+                            break;
+                        case KernelOp::GuardEqual:
+                            if ((v[s.a] == v[s.b]) != (s.constant != 0.0))
+                                return false;
+                            break;
+                        default:
+                            v[i] = apply(s.op, v[s.a], v[s.b]);
+                    }
+                }
+                return true;
+            }
+
+          public:
+            // the value of an arithmetic statement
+            static double apply(KernelOp op, double a, double b) {
+                switch (op) {
+                    case KernelOp::Add:
+                        return a + b;
+                    case KernelOp::Sub:
+                        return a - b;
+                    case KernelOp::Mul:
+                        return a * b;
+                    case KernelOp::Div:
+                        return a / b;
+                    case KernelOp::Neg:
+                        return -a;
+                    case KernelOp::Exp:
+                        return std::exp(a);
+                    case KernelOp::Log:
+                        return std::log(a);
+                    case KernelOp::Sqrt:
+                        return std::sqrt(a);
+                    case KernelOp::Erfc:
+                        return std::erfc(a);
+                    case KernelOp::Abs:
+                        return std::fabs(a);
+                    case KernelOp::Pow:
+                        return std::pow(a, b);
+                    case KernelOp::Max:
+                        return a >= b ? a : b;
+                    case KernelOp::Min:
+                        return a <= b ? a : b;
+                    default:
+                        QL_FAIL("not an arithmetic kernel statement");
+                }
+            }
+
+          private:
+            std::vector<KernelStatement> statements_;
+            std::vector<std::uint32_t> outputs_;
+            std::uint32_t nInputs_ = 0;
+        };
+
+        // records op(x, y) if any operand is active, otherwise just computes it
+        inline TracedReal
+        record(KernelOp op, const TracedReal& x, const TracedReal& y = TracedReal()) {
+            double v = KernelTape::apply(op, x.value(), y.value());
+            KernelTape* tape = KernelTape::active();
+            if (tape == nullptr || (!x.isActive() && !y.isActive()))
+                return TracedReal(v);
+            return tape->record(op, x, y, v);
+        }
+
+        inline void guard(KernelOp op, const TracedReal& x, const TracedReal& y, bool result) {
+            KernelTape* tape = KernelTape::active();
+            if (tape != nullptr && (x.isActive() || y.isActive()))
+                tape->guard(op, x, y, result);
+        }
+
+        inline TracedReal operator+(const TracedReal& x, const TracedReal& y) {
+            return record(KernelOp::Add, x, y);
+        }
+        inline TracedReal operator-(const TracedReal& x, const TracedReal& y) {
+            return record(KernelOp::Sub, x, y);
+        }
+        inline TracedReal operator*(const TracedReal& x, const TracedReal& y) {
+            return record(KernelOp::Mul, x, y);
+        }
+        inline TracedReal operator/(const TracedReal& x, const TracedReal& y) {
+            return record(KernelOp::Div, x, y);
+        }
+        inline TracedReal operator-(const TracedReal& x) { return record(KernelOp::Neg, x); }
+
+        inline bool operator<(const TracedReal& x, const TracedReal& y) {
+            bool r = x.value() < y.value();
+            guard(KernelOp::GuardLess, x, y, r);
+            return r;
+        }
+        inline bool operator<=(const TracedReal& x, const TracedReal& y) {
+            bool r = x.value() <= y.value();
+            guard(KernelOp::GuardLessEqual, x, y, r);
+            return r;
+        }
+        inline bool operator==(const TracedReal& x, const TracedReal& y) {
+            bool r = x.value() == y.value();
+            guard(KernelOp::GuardEqual, x, y, r);
+            return r;
+        }
+        inline bool operator>(const TracedReal& x, const TracedReal& y) { return y < x; }
+        inline bool operator>=(const TracedReal& x, const TracedReal& y) { return y <= x; }
+        inline bool operator!=(const TracedReal& x, const TracedReal& y) { return !(x == y); }
+
+        inline TracedReal exp(const TracedReal& x) { return record(KernelOp::Exp, x); }
+        inline TracedReal log(const TracedReal& x) { return record(KernelOp::Log, x); }
+        inline TracedReal sqrt(const TracedReal& x) { return record(KernelOp::Sqrt, x); }
+        inline TracedReal erfc(const TracedReal& x) { return record(KernelOp::Erfc, x); }
+        inline TracedReal abs(const TracedReal& x) { return record(KernelOp::Abs, x); }
+        inline TracedReal fabs(const TracedReal& x) { return record(KernelOp::Abs, x); }
+        inline TracedReal pow(const TracedReal& x, const TracedReal& y) {
+            return record(KernelOp::Pow, x, y);
+        }
+        inline TracedReal max(const TracedReal& x, const TracedReal& y) {
+            return record(KernelOp::Max, x, y);
+        }
+        inline TracedReal min(const TracedReal& x, const TracedReal& y) {
+            return record(KernelOp::Min, x, y);
+        }
+
+    }
+
+    using kernels::KernelOp;
+    using kernels::KernelStatement;
+    using kernels::KernelTape;
+    using kernels::TracedReal;
+
+}
@@ -0,0 +1,277 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/errors.hpp>
+#include <ql/risks/kerneltape.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace QuantLib {
+
+    namespace kernels {
+
+        /* The partial derivatives of a kernel recording at one set of inputs, swept
+         * repeatedly in reverse to obtain adjoints, like an AAD tape.  Every operand costs a
+         * 4-byte slot and an 8-byte partial.
+         */
+        class LinearisedTape {
+          public:
+            LinearisedTape(const KernelTape& tape, const double* inputs)
+            : nInputs_(tape.numberOfInputs()), outputs_(tape.outputs()) {
+                std::vector<double> v;
+                QL_REQUIRE(values(tape, inputs, v),
+                           "the inputs take a different branch than the recording");
+                outputValues_.reserve(outputs_.size());
+                for (auto slot : outputs_)
+                    outputValues_.push_back(v[slot]);
+
+                std::vector<Linear> linear;
+                linear.reserve(v.size());
+                for (Size i = 0; i < v.size(); ++i)
+                    linear.push_back(linearise(i, tape.statements()[i], v));
+
+                size_ = linear.size();
+                for (const auto& l : linear)
+                    append(l);
+            }
+
+            Size size() const { return size_; }
+            Size numberOfInputs() const { return nInputs_; }
+            Size numberOfOutputs() const { return outputs_.size(); }
+            const std::vector<double>& outputValues() const { return outputValues_; }
+
+            // bytes used for the statements, operands and partials
+            Size memory() const {
+                return operandCount_.size() + inputIndex_.size() * sizeof(std::uint32_t) +
+                       slots_.size() * sizeof(std::uint32_t) + partials_.size() * sizeof(double);
+            }
+
+            /* Input adjoints for the given output adjoints.  The work buffer holds one adjoint
+             * per statement; it is resized as needed and can be reused across sweeps.
+             */
+            void computeAdjoints(const double* outputAdjoints,
+                                 double* inputAdjoints,
+                                 std::vector<double>& work) const {
+                std::fill(inputAdjoints, inputAdjoints + nInputs_, 0.0);
+                work.assign(size_, 0.0);
+                for (Size k = 0; k < outputs_.size(); ++k)
+                    work[outputs_[k]] += outputAdjoints[k];
+                sweep(inputAdjoints, work);
+            }
+
+            void computeAdjoints(const double* outputAdjoints, double* inputAdjoints) const {
+                std::vector<double> work;
+                computeAdjoints(outputAdjoints, inputAdjoints, work);
+            }
+
+            /* Output tangents for many input directions at once, e.g. scenario shifts.  The
+             * n x d input tangents and the m x d output tangents are row-major, with the d
+             * directions of an input or output side by side.  The forward sweep carries the
+             * d tangents of each statement together, so that its inner loops vectorise; the
+             * work buffer holds size() x d tangents.
+             *
+             * A sweep over d directions costs about as much as d reverse sweeps.  It pays off
+             * when the outputs outnumber the directions; otherwise, the reverse sweeps of the
+             * outputs multiplied by the directions are cheaper.
+             */
+            void computeTangents(const double* inputTangents,
+                                 Size directions,
+                                 double* outputTangents,
+                                 std::vector<double>& work) const {
+                QL_REQUIRE(directions > 0, "no directions given");
+                work.assign(size_ * directions, 0.0);
+                tangents(inputTangents, directions, work);
+                for (Size k = 0; k < outputs_.size(); ++k)
+                    std::copy_n(work.begin() + outputs_[k] * directions, directions,
+                                outputTangents + k * directions);
+            }
+
+            void computeTangents(const double* inputTangents,
+                                 Size directions,
+                                 double* outputTangents) const {
+                std::vector<double> work;
+                computeTangents(inputTangents, directions, outputTangents, work);
+            }
+
+          private:
+            // statement tags, the operand count of the statements with a derivative
+            enum : std::uint8_t { Passive = 0, Unary = 1, Binary = 2, Input = 3 };
+
+            // a linearised statement; the input index is in slot[0] for inputs
+            struct Linear {
+                std::uint8_t tag;
+                std::uint32_t slot[2];
+                double partial[2];
+            };
+
+            static bool
+            values(const KernelTape& tape, const double* inputs, std::vector<double>& v) {
+                const auto& statements = tape.statements();
+                v.resize(statements.size());
+                for (Size i = 0; i < statements.size(); ++i) {
+                    const auto& s = statements[i];
+                    switch (s.op) {
+                        case KernelOp::Input:
+                            v[i] = inputs[s.a];
+                            break;
+                        case KernelOp::Constant:
+                            v[i] = s.constant;
+                            break;
+                        case KernelOp::GuardLess:
+                            if ((v[s.a] < v[s.b]) != (s.constant != 0.0))
+                                return false;
+                            break;
+                        case KernelOp::GuardLessEqual:
+                            if ((v[s.a] <= v[s.b]) != (s.constant != 0.0))
+                                return false;
+                            break;
+                        case KernelOp::GuardEqual:
+                            if ((v[s.a] == v[s.b]) != (s.constant != 0.0))
+                                return false;
+                            break;
+                        default:
+                            v[i] = KernelTape::apply(s.op, v[s.a], v[s.b]);
+                    }
+                }
+                return true;
+            }
+
+            static Linear
+            linearise(Size i, const KernelStatement& s, const std::vector<double>& v) {
+                Linear l = {Passive, {s.a, s.b}, {0.0, 0.0}};
+                l.tag = partials(i, s, v, l.partial);
+                return l;
+            }
+
+            // operand count, and the partials with respect to s.a and s.b
+            static std::uint8_t
+            partials(Size i, const KernelStatement& s, const std::vector<double>& v, double d[2]) {
+                double a = v[s.a], b = v[s.b], r = v[i];
+                switch (s.op) {
+                    case KernelOp::Add:
+                        d[0] = 1.0, d[1] = 1.0;
+                        return Binary;
+                    case KernelOp::Sub:
+                        d[0] = 1.0, d[1] = -1.0;
+                        return Binary;
+                    case KernelOp::Mul:
+                        d[0] = b, d[1] = a;
+                        return Binary;
+                    case KernelOp::Div:
+                        d[0] = 1.0 / b, d[1] = -r / b;
+                        return Binary;
+                    case KernelOp::Pow:
+                        d[0] = b * std::pow(a, b - 1.0), d[1] = r * std::log(a);
+                        return Binary;
+                    case KernelOp::Max:
+                        d[0] = a >= b ? 1.0 : 0.0, d[1] = 1.0 - d[0];
+                        return Binary;
+                    case KernelOp::Min:
+                        d[0] = a <= b ? 1.0 : 0.0, d[1] = 1.0 - d[0];
+                        return Binary;
+                    case KernelOp::Neg:
+                        d[0] = -1.0;
+                        return Unary;
+                    case KernelOp::Exp:
+                        d[0] = r;
+                        return Unary;
+                    case KernelOp::Log:
+                        d[0] = 1.0 / a;
+                        return Unary;
+                    case KernelOp::Sqrt:
+                        d[0] = 0.5 / r;
+                        return Unary;
+                    case KernelOp::Erfc:
+                        d[0] = -1.1283791670955126 * std::exp(-a * a);
+                        return Unary;
+                    case KernelOp::Abs:
+                        d[0] = a < 0.0 ? -1.0 : 1.0;
+                        return Unary;
+                    default:
+                        return s.op == KernelOp::Input ? Input : Passive;
+                }
+            }
+
+            void append(const Linear& l) {
+                operandCount_.push_back(l.tag);
+                if (l.tag == Input) {
+                    inputIndex_.push_back(l.slot[0]);
+                    return;
+                }
+                for (std::uint8_t k = 0; k < l.tag; ++k) {
+                    slots_.push_back(l.slot[k]);
+                    partials_.push_back(l.partial[k]);
+                }
+            }
+
+            void sweep(double* inputAdjoints, std::vector<double>& g) const {
+                Size operand = slots_.size(), input = inputIndex_.size();
+                for (Size i = size_; i-- > 0;) {
+                    std::uint8_t tag = operandCount_[i];
+                    if (tag == Input) {
+                        inputAdjoints[inputIndex_[--input]] = g[i];
+                        continue;
+                    }
+                    operand -= tag;
+                    for (std::uint8_t k = 0; k < tag; ++k)
+                        g[slots_[operand + k]] += g[i] * partials_[operand + k];
+                }
+            }
+
+            // t += a x over the d directions
+            static void axpy(double* t, double a, const double* x, Size d) {
+                for (Size j = 0; j < d; ++j)
+                    t[j] += a * x[j];
+            }
+
+            void tangents(const double* inputTangents, Size d, std::vector<double>& t) const {
+                Size operand = 0, input = 0;
+                for (Size i = 0; i < size_; ++i) {
+                    std::uint8_t tag = operandCount_[i];
+                    if (tag == Input) {
+                        std::copy_n(inputTangents + inputIndex_[input++] * d, d, &t[i * d]);
+                        continue;
+                    }
+                    for (std::uint8_t k = 0; k < tag; ++k, ++operand)
+                        axpy(&t[i * d], partials_[operand], &t[slots_[operand] * d], d);
+                }
+            }
+
+            Size size_, nInputs_;
+            std::vector<std::uint32_t> outputs_;
+            std::vector<double> outputValues_;
+            std::vector<std::uint8_t> operandCount_;
+            std::vector<std::uint32_t> inputIndex_;
+            std::vector<std::uint32_t> slots_;
+            std::vector<double> partials_;
+        };
+
+    }
+
+    using kernels::LinearisedTape;
+
+}
@@ -0,0 +1,274 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/math/matrix.hpp>
+#include <ql/quote.hpp>
+#include <ql/risks/adjointnode.hpp>
+#include <ql/termstructures/volatility/equityfx/localvoltermstructure.hpp>
+#include <ql/termstructures/yieldtermstructure.hpp>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace QuantLib {
+
+    namespace detail {
+
+        /* Weights of the first and second derivatives at x[i] of the quadratic through the
+         * three nodes around x[i] (the line through both nodes, with no second derivative,
+         * if there are only two).
+         */
+        struct DerivativeStencil {
+            Size first;
+            std::vector<double> d1, d2;
+        };
+
+        inline DerivativeStencil derivativeStencil(const std::vector<double>& x, Size i) {
+            Size n = std::min<Size>(3, x.size());
+            DerivativeStencil s;
+            s.first = std::min<Size>(i > 0 ? i - 1 : 0, x.size() - n);
+            s.d1.assign(n, 0.0);
+            s.d2.assign(n, 0.0);
+            for (Size k = 0; k < n; ++k) {
+                double xk = x[s.first + k], denominator = 1.0;
+                for (Size l = 0; l < n; ++l)
+                    if (l != k)
+                        denominator *= xk - x[s.first + l];
+                for (Size l = 0; l < n; ++l) {
+                    if (l == k)
+                        continue;
+                    double product = 1.0;
+                    for (Size m = 0; m < n; ++m)
+                        if (m != k && m != l)
+                            product *= x[i] - x[s.first + m];
+                    s.d1[k] += product / denominator;
+                }
+                if (n == 3)
+                    s.d2[k] = 2.0 / denominator;
+            }
+            return s;
+        }
+
+        /* Dupire local volatility at node (i, j) of a grid of implied volatilities
+         * vols[i * times.size() + j] at strikes[i] and times[j], from the implied volatility
+         * and its derivatives at the node:
+         *
+         *   lv^2 = (s^2 + 2 s T (s_T + mu K s_K))
+         *        / ((1 + K d1 sqrt(T) s_K)^2 + K^2 T s (s_KK - d1 sqrt(T) s_K^2))
+         *
+         * with mu the drift at T and d1 from the forward at T.  The derivatives are those of
+         * the quadratics through the neighbouring nodes.  Adds the partials of the local
+         * volatility with respect to the implied volatilities to partials, by node index.
+         */
+        inline double dupireLocalVol(const std::vector<double>& times,
+                                     const std::vector<double>& strikes,
+                                     const std::vector<double>& vols,
+                                     Size i,
+                                     Size j,
+                                     double forward,
+                                     double drift,
+                                     std::vector<std::pair<Size, double>>& partials) {
+            const Size m = times.size();
+            auto node = [m](Size k, Size l) { return k * m + l; };
+            DerivativeStencil st = derivativeStencil(times, j), sk = derivativeStencil(strikes, i);
+            double sT = 0.0, sK = 0.0, sKK = 0.0;
+            for (Size l = 0; l < st.d1.size(); ++l)
+                sT += st.d1[l] * vols[node(i, st.first + l)];
+            for (Size k = 0; k < sk.d1.size(); ++k) {
+                sK += sk.d1[k] * vols[node(sk.first + k, j)];
+                sKK += sk.d2[k] * vols[node(sk.first + k, j)];
+            }
+
+            double s = vols[node(i, j)], T = times[j], K = strikes[i], sqrtT = std::sqrt(T);
+            double logMoneyness = std::log(forward / K);
+            double d1 = (logMoneyness + 0.5 * s * s * T) / (s * sqrtT);
+            double d1s = -logMoneyness / (s * s * sqrtT) + 0.5 * sqrtT;
+            double numerator = s * s + 2.0 * s * T * (sT + drift * K * sK);
+            double A = 1.0 + K * d1 * sqrtT * sK, B = sKK - d1 * sqrtT * sK * sK;
+            double denominator = A * A + K * K * T * s * B;
+            QL_REQUIRE(numerator > 0.0 && denominator > 0.0,
+                       "negative local variance at strike " << K << " and time " << T);
+            double lv = std::sqrt(numerator / denominator);
+
+            auto dlv = [&](double dNumerator, double dDenominator) {
+                return 0.5 / lv * (dNumerator * denominator - numerator * dDenominator) /
+                       (denominator * denominator);
+            };
+            double ds = dlv(2.0 * s + 2.0 * T * (sT + drift * K * sK),
+                            2.0 * A * K * sqrtT * sK * d1s + K * K * T * B -
+                                K * K * T * s * sqrtT * sK * sK * d1s);
+            double dsT = dlv(2.0 * s * T, 0.0);
+            double dsK = dlv(2.0 * s * T * drift * K,
+                             2.0 * A * K * d1 * sqrtT - 2.0 * K * K * T * s * d1 * sqrtT * sK);
+            double dsKK = dlv(0.0, K * K * T * s);
+
+            auto add = [&partials](Size index, double partial) {
+                for (auto& p : partials) {
+                    if (p.first == index) {
+                        p.second += partial;
+                        return;
+                    }
+                }
+                partials.emplace_back(index, partial);
+            };
+            add(node(i, j), ds);
+            for (Size l = 0; l < st.d1.size(); ++l)
+                add(node(i, st.first + l), dsT * st.d1[l]);
+            for (Size k = 0; k < sk.d1.size(); ++k)
+                add(node(sk.first + k, j), dsK * sk.d1[k] + dsKK * sk.d2[k]);
+            return lv;
+        }
+
+    }
+
+    /* Dupire local volatilities computed once on the grid of an implied volatility surface,
+     * for pricing with local volatility (e.g. with FdBlackScholesVanillaEngine and a
+     * GeneralizedBlackScholesProcess given this local volatility).
+     *
+     * Unlike LocalVolSurface, which differentiates the implied surface by finite differences
+     * at each query, the local volatility at each node of the grid is computed in closed form
+     * from the implied volatilities around it, and recorded on the tape as one node with its
+     * partials with respect to them.  A query interpolates the grid bilinearly, flat outside
+     * of it, and is recorded as one node on the four grid values around it.  Sensitivities
+     * to the implied volatilities (vega buckets) thus cost a few tape entries per query.
+     *
+     * The grid is taken for the spot and curves at construction, which only enter the local
+     * volatilities through the forward and drift: it is not updated when they change, and
+     * sensitivities to them do not flow through it.  As the grid values are recorded at
+     * construction, the grid is built in the recording that prices with it.
+     */
+    class LocalVolGrid : public LocalVolTermStructure {
+      public:
+        // blackVols: implied volatility for each strike (row) and expiry (column)
+        LocalVolGrid(const Date& referenceDate,
+                     const std::vector<Date>& expiries,
+                     const std::vector<Real>& strikes,
+                     const Matrix& blackVols,
+                     const Handle<Quote>& spot,
+                     const Handle<YieldTermStructure>& riskFreeTS,
+                     const Handle<YieldTermStructure>& dividendTS,
+                     const DayCounter& dayCounter)
+        : LocalVolTermStructure(referenceDate, Calendar(), Following, dayCounter),
+          maxDate_(expiries.back()), localVols_(strikes.size(), expiries.size()) {
+            const Size n = strikes.size(), m = expiries.size();
+            QL_REQUIRE(n >= 3, "at least three strikes required");
+            QL_REQUIRE(m >= 2, "at least two expiries required");
+            QL_REQUIRE(blackVols.rows() == n && blackVols.columns() == m,
+                       "implied volatilities (" << blackVols.rows() << "x" << blackVols.columns()
+                                                << ") do not match the strikes (" << n
+                                                << ") and expiries (" << m << ")");
+            for (Size j = 0; j < m; ++j) {
+                times_.push_back(plain(timeFromReference(expiries[j])));
+                QL_REQUIRE(times_[j] > (j > 0 ? times_[j - 1] : 0.0),
+                           "expiries must be increasing and after the reference date");
+            }
+            for (Size i = 0; i < n; ++i) {
+                strikes_.push_back(plain(strikes[i]));
+                QL_REQUIRE(i == 0 || strikes_[i] > strikes_[i - 1], "strikes must be increasing");
+            }
+            std::vector<double> vols(n * m);
+            for (Size i = 0; i < n; ++i)
+                for (Size j = 0; j < m; ++j)
+                    vols[i * m + j] = plain(blackVols[i][j]);
+
+            double s0 = plain(spot->value());
+            std::vector<std::pair<Size, double>> partials;
+#ifndef QLRISKS_DISABLE_AAD
+            std::vector<const Real*> inputs;
+            std::vector<double> derivatives;
+#endif
+            for (Size j = 0; j < m; ++j) {
+                double T = times_[j];
+                double forward = s0 * plain(dividendTS->discount(T)) /
+                                 plain(riskFreeTS->discount(T)),
+                       drift = plain(riskFreeTS->forwardRate(T, T, Continuous, NoFrequency, true)
+                                         .rate()) -
+                               plain(dividendTS->forwardRate(T, T, Continuous, NoFrequency, true)
+                                         .rate());
+                for (Size i = 0; i < n; ++i) {
+                    partials.clear();
+                    double lv = detail::dupireLocalVol(times_, strikes_, vols, i, j, forward,
+                                                       drift, partials);
+#ifndef QLRISKS_DISABLE_AAD
+                    inputs.clear();
+                    derivatives.clear();
+                    for (const auto& p : partials) {
+                        inputs.push_back(&blackVols[p.first / m][p.first % m]);
+                        derivatives.push_back(p.second);
+                    }
+                    localVols_[i][j] = detail::recordNode(lv, inputs, derivatives);
+#else
+                    localVols_[i][j] = lv;
+#endif
+                }
+            }
+        }
+
+        Date maxDate() const override { return maxDate_; }
+        Real minStrike() const override { return strikes_.front(); }
+        Real maxStrike() const override { return strikes_.back(); }
+
+        const std::vector<double>& times() const { return times_; }
+        const std::vector<double>& strikes() const { return strikes_; }
+        // local volatility for each strike (row) and time (column)
+        const Matrix& localVols() const { return localVols_; }
+
+      protected:
+        Volatility localVolImpl(Time t, Real underlyingLevel) const override {
+            Size i, j;
+            double a = weight(strikes_, plain(underlyingLevel), i),
+                   b = weight(times_, plain(t), j);
+            const Real &v00 = localVols_[i][j], &v01 = localVols_[i][j + 1],
+                       &v10 = localVols_[i + 1][j], &v11 = localVols_[i + 1][j + 1];
+            double w00 = (1.0 - a) * (1.0 - b), w01 = (1.0 - a) * b, w10 = a * (1.0 - b),
+                   w11 = a * b;
+            return recordNode(w00 * plain(v00) + w01 * plain(v01) + w10 * plain(v10) +
+                                  w11 * plain(v11),
+                              {{v00, w00}, {v01, w01}, {v10, w10}, {v11, w11}});
+        }
+
+      private:
+#ifndef QLRISKS_DISABLE_AAD
+        static double plain(const Real& x) { return xad::value(x); }
+#else
+        static double plain(double x) { return x; }
+#endif
+
+        // the interval of x in the nodes, and the weight of its upper node, flat outside
+        static double weight(const std::vector<double>& nodes, double x, Size& k) {
+            auto upper = std::upper_bound(nodes.begin(), nodes.end(), x);
+            k = std::min<Size>(std::max<Size>(upper - nodes.begin(), 1), nodes.size() - 1) - 1;
+            double a = (x - nodes[k]) / (nodes[k + 1] - nodes[k]);
+            return std::min(std::max(a, 0.0), 1.0);
+        }
+
+        Date maxDate_;
+        std::vector<double> times_;
+        std::vector<double> strikes_;
+        Matrix localVols_;
+    };
+
+}
@@ -0,0 +1,203 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/errors.hpp>
+#include <ql/math/distributions/normaldistribution.hpp>
+#include <ql/option.hpp>
+#include <ql/pricingengines/blackformula.hpp>
+#include <ql/risks/adjointnode.hpp>
+#include <cmath>
+
+namespace QuantLib {
+
+    /* Normal distribution functions and the Black formula recorded as one node each.
+     *
+     * On AReal, QuantLib's CumulativeNormalDistribution, InverseCumulativeNormal and
+     * blackFormula tape every operation of their rational approximations, i.e. dozens of
+     * statements per call.  These versions compute the value on doubles and record it with
+     * its closed-form partials.  Without AAD, they are QuantLib's functions.
+     */
+
+    namespace detail {
+
+        const double normalDensityFactor = 0.3989422804014327; // 1 / sqrt(2 pi)
+
+        inline double normalDensity(double z) {
+            return normalDensityFactor * std::exp(-0.5 * z * z);
+        }
+
+        inline double cumulativeNormal(double z) { return 0.5 * std::erfc(-z * M_SQRT1_2); }
+
+        // Acklam's rational approximation, refined by one Halley step
+        inline double inverseCumulativeNormal(double p) {
+            static const double a[] = {-3.969683028665376e+01, 2.209460984245205e+02,
+                                       -2.759285104469687e+02, 1.383577518672690e+02,
+                                       -3.066479806614716e+01, 2.506628277459239e+00};
+            static const double b[] = {-5.447609879822406e+01, 1.615858368580409e+02,
+                                       -1.556989798598866e+02, 6.680131188771972e+01,
+                                       -1.328068155288572e+01};
+            static const double c[] = {-7.784894002430293e-03, -3.223964580411365e-01,
+                                       -2.400758277161838e+00, -2.549732539343734e+00,
+                                       4.374664141464968e+00,  2.938163982698783e+00};
+            static const double d[] = {7.784695709041462e-03, 3.224671290700398e-01,
+                                       2.445134137142996e+00, 3.754408661907416e+00};
+            const double low = 0.02425;
+            double z;
+            if (p < low || p > 1.0 - low) {
+                double q = std::sqrt(-2.0 * std::log(p < low ? p : 1.0 - p));
+                z = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+                    ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.0);
+                if (p > 1.0 - low)
+                    z = -z;
+            } else {
+                double q = p - 0.5, r = q * q;
+                z = (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q /
+                    (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.0);
+            }
+            double e = cumulativeNormal(z) - p;
+            double u = e / normalDensity(z);
+            return z - u / (1.0 + 0.5 * z * u);
+        }
+
+    }
+
+    // Black price and its partials to the forward, strike, standard deviation and discount
+    struct BlackPartials {
+        double value, forward, strike, stdDev, discount;
+    };
+
+    inline BlackPartials blackFormulaPartials(Option::Type optionType,
+                                              double strike,
+                                              double forward,
+                                              double stdDev,
+                                              double discount = 1.0,
+                                              double displacement = 0.0) {
+        QL_REQUIRE(displacement >= 0.0,
+                   "displacement (" << displacement << ") must be non-negative");
+        QL_REQUIRE(strike + displacement >= 0.0, "strike + displacement (" << strike << " + "
+                                                     << displacement << ") must be non-negative");
+        QL_REQUIRE(forward + displacement > 0.0, "forward + displacement (" << forward << " + "
+                                                     << displacement << ") must be positive");
+        QL_REQUIRE(stdDev >= 0.0, "stdDev (" << stdDev << ") must be non-negative");
+        QL_REQUIRE(discount > 0.0, "discount (" << discount << ") must be positive");
+
+        double w = optionType == Option::Call ? 1.0 : -1.0;
+        double F = forward + displacement, K = strike + displacement;
+        BlackPartials p = {0.0, 0.0, 0.0, 0.0, 0.0};
+        if (stdDev == 0.0 || K == 0.0) {
+            // intrinsic value, also the limit for a zero strike
+            if (w * (F - K) > 0.0) {
+                p.discount = w * (F - K);
+                p.value = discount * p.discount;
+                p.forward = discount * w;
+                p.strike = -discount * w;
+            }
+            return p;
+        }
+        double d1 = std::log(F / K) / stdDev + 0.5 * stdDev, d2 = d1 - stdDev;
+        double Nd1 = detail::cumulativeNormal(w * d1), Nd2 = detail::cumulativeNormal(w * d2);
+        p.discount = std::max(w * (F * Nd1 - K * Nd2), 0.0);
+        p.value = discount * p.discount;
+        p.forward = discount * w * Nd1;
+        p.strike = -discount * w * Nd2;
+        p.stdDev = discount * F * detail::normalDensity(d1);
+        return p;
+    }
+
+    // CumulativeNormalDistribution, recording each value as one node
+    class CumulativeNormalNode {
+      public:
+        explicit CumulativeNormalNode(double average = 0.0, double sigma = 1.0)
+        : average_(average), sigma_(sigma) {
+            QL_REQUIRE(sigma_ > 0.0,
+                       "sigma must be greater than 0.0 (" << sigma_ << " not allowed)");
+        }
+
+        Real operator()(const Real& x) const {
+#ifndef QLRISKS_DISABLE_AAD
+            double v = xad::value(x);
+            return recordNode(detail::cumulativeNormal((v - average_) / sigma_),
+                              {{x, derivative(v)}});
+#else
+            return CumulativeNormalDistribution(average_, sigma_)(x);
+#endif
+        }
+
+        // the density, as a plain value
+        double derivative(double x) const {
+            return detail::normalDensity((x - average_) / sigma_) / sigma_;
+        }
+
+      private:
+        double average_, sigma_;
+    };
+
+    // InverseCumulativeNormal, recording each value as one node
+    class InverseCumulativeNormalNode {
+      public:
+        explicit InverseCumulativeNormalNode(double average = 0.0, double sigma = 1.0)
+        : average_(average), sigma_(sigma) {
+            QL_REQUIRE(sigma_ > 0.0,
+                       "sigma must be greater than 0.0 (" << sigma_ << " not allowed)");
+        }
+
+        Real operator()(const Real& p) const {
+#ifndef QLRISKS_DISABLE_AAD
+            double x = xad::value(p);
+            QL_REQUIRE(x > 0.0 && x < 1.0, "probability (" << x << ") must be in (0, 1)");
+            double z = detail::inverseCumulativeNormal(x);
+            return recordNode(average_ + sigma_ * z, {{p, sigma_ / detail::normalDensity(z)}});
+#else
+            return InverseCumulativeNormal(average_, sigma_)(p);
+#endif
+        }
+
+      private:
+        double average_, sigma_;
+    };
+
+    /* blackFormula, recorded as one node with its delta (forward), strike, vega (standard
+     * deviation), discount and displacement partials. */
+    inline Real blackFormulaNode(Option::Type optionType,
+                                 const Real& strike,
+                                 const Real& forward,
+                                 const Real& stdDev,
+                                 const Real& discount = 1.0,
+                                 const Real& displacement = 0.0) {
+#ifndef QLRISKS_DISABLE_AAD
+        BlackPartials p = blackFormulaPartials(optionType, xad::value(strike), xad::value(forward),
+                                               xad::value(stdDev), xad::value(discount),
+                                               xad::value(displacement));
+        return recordNode(p.value, {{strike, p.strike},
+                                    {forward, p.forward},
+                                    {stdDev, p.stdDev},
+                                    {discount, p.discount},
+                                    {displacement, p.forward + p.strike}});
+#else
+        return blackFormula(optionType, strike, forward, stdDev, discount, displacement);
+#endif
+    }
+
+}
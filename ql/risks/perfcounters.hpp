@@ -0,0 +1,315 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/risks/allocationhooks.hpp>
+#include <ql/types.hpp>
+#include <array>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(QLRISKS_ENABLE_PERF_COUNTERS) && defined(__linux__)
+#    include <linux/perf_event.h>
+#    include <sys/ioctl.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#    define QLRISKS_PERF_EVENTS
+#endif
+
+namespace QuantLib {
+
+    // hardware event counts, -1 for the events that were not counted
+    struct PerfCounts {
+        enum Event {
+            Cycles,
+            Instructions,
+            L1dMisses,
+            LlcMisses,
+            DtlbMisses,
+            BranchMisses,
+            NumberOfEvents
+        };
+
+        PerfCounts() { counts.fill(-1); }
+
+        std::int64_t operator[](Event e) const { return counts[e]; }
+
+        PerfCounts& operator+=(const PerfCounts& other) {
+            for (Size e = 0; e < NumberOfEvents; ++e)
+                counts[e] = counts[e] < 0 || other.counts[e] < 0 ? -1 :
+                                                                   counts[e] + other.counts[e];
+            return *this;
+        }
+
+        static const char* name(Event e) {
+            static const char* names[] = {"cycles",     "instructions", "L1d misses",
+                                          "LLC misses", "dTLB misses",  "branch misses"};
+            return names[e];
+        }
+
+        std::array<std::int64_t, NumberOfEvents> counts;
+    };
+
+    inline PerfCounts operator-(PerfCounts a, const PerfCounts& b) {
+        for (Size e = 0; e < PerfCounts::NumberOfEvents; ++e)
+            a.counts[e] = a.counts[e] < 0 || b.counts[e] < 0 ? -1 : a.counts[e] - b.counts[e];
+        return a;
+    }
+
+    /* Counters of the hardware events in PerfCounts for the calling thread, in user space,
+     * with Linux perf_event_open.  They are only opened when QuantLib-Risks is configured
+     * with QLRISKS_ENABLE_PERF_COUNTERS; events the machine or the kernel settings (e.g.
+     * perf_event_paranoid) do not allow are not counted.  Counts are scaled when the
+     * kernel multiplexes the counters.
+     */
+    class PerfCounters {
+      public:
+        PerfCounters() {
+            fds_.fill(-1);
+#ifdef QLRISKS_PERF_EVENTS
+            auto cache = [](std::uint64_t id) {
+                return id | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                       (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            };
+            const std::pair<std::uint32_t, std::uint64_t> events[] = {
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_L1D)},
+                {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_LL)},
+                {PERF_TYPE_HW_CACHE, cache(PERF_COUNT_HW_CACHE_DTLB)},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}};
+            for (Size e = 0; e < PerfCounts::NumberOfEvents; ++e) {
+                perf_event_attr attr = {};
+                attr.size = sizeof(attr);
+                attr.type = events[e].first;
+                attr.config = events[e].second;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                fds_[e] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            }
+#endif
+        }
+
+        ~PerfCounters() {
+#ifdef QLRISKS_PERF_EVENTS
+            for (int fd : fds_)
+                if (fd >= 0)
+                    ::close(fd);
+#endif
+        }
+
+        PerfCounters(const PerfCounters&) = delete;
+        PerfCounters& operator=(const PerfCounters&) = delete;
+
+        // whether any event is counted
+        bool available() const {
+            for (int fd : fds_)
+                if (fd >= 0)
+                    return true;
+            return false;
+        }
+
+        // the counts since the counters were opened
+        PerfCounts read() const {
+            PerfCounts result;
+#ifdef QLRISKS_PERF_EVENTS
+            for (Size e = 0; e < PerfCounts::NumberOfEvents; ++e) {
+                std::uint64_t data[3]; // value, time enabled, time running
+                if (fds_[e] < 0 || ::read(fds_[e], data, sizeof(data)) != sizeof(data))
+                    continue;
+                result.counts[e] = static_cast<std::int64_t>(
+                    data[2] == 0 || data[2] == data[1] ?
+                        data[0] :
+                        static_cast<double>(data[0]) * data[1] / data[2]);
+            }
+#endif
+            return result;
+        }
+
+      private:
+        std::array<int, PerfCounts::NumberOfEvents> fds_;
+    };
+
+    /* Hardware event counts of named phases on the calling thread, e.g. the plain pricing,
+     * the recording and the adjoint sweeps of a risk run.  While a profile exists, the
+     * phases scoped with PerfPhase on its thread add their counts to it.  Phases may be
+     * nested.  The counters are read on entry and exit of each phase, so a profile is best
+     * taken on runs separate from timed ones.
+     *
+     * With the allocation hooks installed (see QLRISKS_DEFINE_ALLOCATION_HOOKS), the
+     * phases also count their heap allocations, with or without hardware counters.
+     *
+     *     PerfProfile profile;
+     *     {
+     *         PerfPhase phase("plain");
+     *         price();
+     *     }
+     *     {
+     *         PerfPhase phase("recording");
+     *         engine.record();
+     *     }
+     *     {
+     *         PerfPhase phase("adjoints");
+     *         engine.sweep();
+     *     }
+     *     if (profile.available())
+     *         std::cout << profile;
+     */
+    class PerfProfile {
+      public:
+        struct Phase {
+            std::string name;
+            Size calls;
+            PerfCounts counts;
+            AllocationCounts allocations;
+        };
+
+        PerfProfile() : previous_(current()) { current() = this; }
+        ~PerfProfile() { current() = previous_; }
+
+        PerfProfile(const PerfProfile&) = delete;
+        PerfProfile& operator=(const PerfProfile&) = delete;
+
+        // whether hardware events or allocations are counted
+        bool available() const { return countsEvents() || countsAllocations(); }
+        bool countsEvents() const { return counters_.available(); }
+        bool countsAllocations() const { return allocationHooksInstalled(); }
+        const std::vector<Phase>& phases() const { return phases_; }
+
+        // the profile of the calling thread, if any
+        static PerfProfile* active() { return current(); }
+
+        PerfCounts read() const { return counters_.read(); }
+
+        void add(const std::string& phase,
+                 const PerfCounts& counts,
+                 const AllocationCounts& allocations = AllocationCounts()) {
+            for (auto& p : phases_) {
+                if (p.name == phase) {
+                    ++p.calls;
+                    p.counts += counts;
+                    p.allocations += allocations;
+                    return;
+                }
+            }
+            phases_.push_back({phase, 1, counts, allocations});
+        }
+
+      private:
+        static PerfProfile*& current() {
+            static thread_local PerfProfile* profile = nullptr;
+            return profile;
+        }
+
+        PerfCounters counters_;
+        std::vector<Phase> phases_;
+        PerfProfile* previous_;
+    };
+
+    // adds the counts of its scope to the active profile as a phase
+    class PerfPhase {
+      public:
+        explicit PerfPhase(const char* name) : profile_(PerfProfile::active()), name_(name) {
+            if (profile_ != nullptr && profile_->available()) {
+                start_ = profile_->read();
+                startAllocations_ = threadAllocations();
+            } else {
+                profile_ = nullptr;
+            }
+        }
+
+        ~PerfPhase() {
+            if (profile_ != nullptr) {
+                PerfCounts counts = profile_->read() - start_;
+                profile_->add(name_, counts, threadAllocations() - startAllocations_);
+            }
+        }
+
+        PerfPhase(const PerfPhase&) = delete;
+        PerfPhase& operator=(const PerfPhase&) = delete;
+
+      private:
+        PerfProfile* profile_;
+        const char* name_;
+        PerfCounts start_;
+        AllocationCounts startAllocations_ = {};
+    };
+
+    // one line per phase, with the counts per call
+    inline std::ostream& operator<<(std::ostream& out, const PerfProfile& profile) {
+        std::ostringstream line;
+        if (profile.countsEvents()) {
+            line << std::left << std::setw(12) << "Per call" << std::right;
+            for (Size e = 0; e < PerfCounts::NumberOfEvents; ++e)
+                line << std::setw(15) << PerfCounts::name(static_cast<PerfCounts::Event>(e));
+            line << std::setw(6) << "IPC";
+            out << line.str() << "\n";
+            for (const auto& p : profile.phases()) {
+                line.str("");
+                line << std::left << std::setw(12) << p.name << std::right;
+                for (Size e = 0; e < PerfCounts::NumberOfEvents; ++e) {
+                    std::int64_t c = p.counts.counts[e];
+                    if (c < 0)
+                        line << std::setw(15) << "-";
+                    else
+                        line << std::setw(15) << c / static_cast<std::int64_t>(p.calls);
+                }
+                std::int64_t cycles = p.counts[PerfCounts::Cycles],
+                             instructions = p.counts[PerfCounts::Instructions];
+                if (cycles > 0 && instructions >= 0)
+                    line << std::setw(6) << std::fixed << std::setprecision(2)
+                         << static_cast<double>(instructions) / cycles;
+                out << line.str() << "\n";
+            }
+        }
+        if (profile.countsAllocations()) {
+            // the allocations, frees and bytes, and the allocations by size
+            line.str("");
+            line << std::left << std::setw(12) << "Per call" << std::right << std::setw(12)
+                 << "allocations" << std::setw(10) << "frees" << std::setw(12) << "bytes";
+            for (Size b = 0; b < AllocationCounts::NumberOfBuckets; ++b)
+                line << std::setw(9) << AllocationCounts::bucketName(b);
+            out << line.str() << "\n";
+            for (const auto& p : profile.phases()) {
+                const AllocationCounts& a = p.allocations;
+                std::uint64_t calls = p.calls;
+                line.str("");
+                line << std::left << std::setw(12) << p.name << std::right << std::setw(12)
+                     << a.allocations / calls << std::setw(10) << a.deallocations / calls
+                     << std::setw(12) << a.bytes / calls;
+                for (Size b = 0; b < AllocationCounts::NumberOfBuckets; ++b)
+                    line << std::setw(9) << a.sizes[b] / calls;
+                out << line.str() << "\n";
+            }
+        }
+        return out;
+    }
+
+}
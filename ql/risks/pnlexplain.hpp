@@ -0,0 +1,104 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/risks/admode.hpp>
+#include <numeric>
+#include <vector>
+
+namespace QuantLib {
+
+    /* Risk-based attribution of the P&L between two market snapshots x0 and x1.
+     *
+     * With dx = x1 - x0, the first-order contribution of factor i is g0_i * dx_i, with g0
+     * the gradient at x0.  The second-order (gamma) contribution is 1/2 dx_i (H dx)_i, where
+     * the Hessian-vector product along the move is taken from the gradient at the end
+     * snapshot, H dx = g1 - g0, which is exact up to third-order terms.
+     */
+    struct PnLExplain {
+        double startValue = 0.0;
+        double endValue = 0.0;
+        std::vector<double> firstOrder;
+        std::vector<double> secondOrder; // empty if explained without gamma
+
+        double actual() const { return endValue - startValue; }
+        double explained() const {
+            return std::accumulate(firstOrder.begin(), firstOrder.end(), 0.0) +
+                   std::accumulate(secondOrder.begin(), secondOrder.end(), 0.0);
+        }
+        double unexplained() const { return actual() - explained(); }
+
+        // contribution of the factors in [begin, end)
+        double explained(Size begin, Size end) const {
+            double sum = 0.0;
+            for (Size i = begin; i < end; ++i)
+                sum += firstOrder[i] + (secondOrder.empty() ? 0.0 : secondOrder[i]);
+            return sum;
+        }
+    };
+
+#ifndef QLRISKS_DISABLE_AAD
+
+    /* Explains the P&L of a pricer Real pricer(const std::vector<Real>& factors) between two
+     * snapshots of the risk factors, using the active tape.
+     *
+     * This costs one AAD pass at each snapshot when gamma is included, as the end-snapshot
+     * pass also yields the full revaluation for the residual.  Without gamma, the end
+     * snapshot is only revalued passively.
+     */
+    template <class Pricer>
+    PnLExplain explainPnL(const Pricer& pricer,
+                          const std::vector<double>& startFactors,
+                          const std::vector<double>& endFactors,
+                          bool withGamma = true) {
+        QL_REQUIRE(startFactors.size() == endFactors.size(),
+                   "snapshots have different numbers of risk factors ("
+                       << startFactors.size() << ", " << endFactors.size() << ")");
+        Size n = startFactors.size();
+        auto task = [&pricer](const std::vector<Real>& x) { return std::vector<Real>{pricer(x)}; };
+
+        PnLExplain result;
+        std::vector<double> g0, g1;
+        result.startValue = computeJacobian(task, startFactors, ADMode::Reverse, g0)[0];
+        if (withGamma) {
+            result.endValue = computeJacobian(task, endFactors, ADMode::Reverse, g1)[0];
+        } else {
+            std::vector<Real> x1(endFactors.begin(), endFactors.end());
+            result.endValue = value(pricer(x1));
+        }
+
+        result.firstOrder.resize(n);
+        for (Size i = 0; i < n; ++i)
+            result.firstOrder[i] = g0[i] * (endFactors[i] - startFactors[i]);
+        if (withGamma) {
+            result.secondOrder.resize(n);
+            for (Size i = 0; i < n; ++i)
+                result.secondOrder[i] = 0.5 * (g1[i] - g0[i]) * (endFactors[i] - startFactors[i]);
+        }
+        return result;
+    }
+
+#endif
+
+}
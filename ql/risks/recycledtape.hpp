@@ -0,0 +1,144 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/errors.hpp>
+#include <ql/patterns/observable.hpp>
+#include <ql/risks/adjointnode.hpp>
+#include <ql/types.hpp>
+#include <algorithm>
+#include <vector>
+
+#ifndef QLRISKS_DISABLE_AAD
+
+namespace QuantLib {
+
+    /* Reuses one tape for the successive recordings of a resident process, so that its
+     * memory stays bounded by what one recording uses.
+     *
+     * An XAD tape reclaims its slots only in clearAll(), after which every variable still
+     * holding a slot refers to a statement that no longer exists.  A RecycledTape tracks
+     * the variables that outlive a recording in blocks.  Before each recording, it resets
+     * all of them to passive values, clears the tape, and registers the input blocks
+     * again, in order, on the first slots of the new recording.
+     *
+     * - Input blocks (e.g. market quotes) are inputs of every recording, so their
+     *   sensitivities are available after each sweep.
+     * - Variable blocks (e.g. values cached from an earlier recording) keep their values,
+     *   but are passive in the next recording.
+     *
+     * Nothing else survives a recycling.  Any other active variable keeps its dead slot,
+     * and so do the active values cached inside QuantLib objects (the nodes of a
+     * bootstrapped curve, interpolation coefficients, the NPVs of rate helpers): such
+     * objects must be released before newRecording() and rebuilt from the inputs in the
+     * next recording, as the RiskEngine does.  Observers are notified at the start of
+     * newRecording(), before the tape is cleared, so that they can release them.  The
+     * tracked variables must outlive their registration and must not be reallocated
+     * while registered.
+     *
+     *     RecycledTape recycled(tape);
+     *     recycled.addInputs(quotes);
+     *     for (;;) {
+     *         recycled.newRecording();
+     *         Real npv = price(bootstrap(quotes));
+     *         ...
+     *     }
+     */
+    class RecycledTape : public Observable {
+      public:
+        typedef Real::tape_type tape_type;
+
+        // uses the tape active on this thread
+        RecycledTape() : tape_(tape_type::getActive()) {
+            QL_REQUIRE(tape_ != nullptr, "no active tape on this thread");
+        }
+
+        explicit RecycledTape(tape_type& tape) : tape_(&tape) {}
+
+        void addInputs(std::vector<Real>& inputs) { add(inputs.data(), inputs.size(), true); }
+        void addInput(Real& input) { add(&input, 1, true); }
+        void addVariables(std::vector<Real>& variables) {
+            add(variables.data(), variables.size(), false);
+        }
+        void addVariable(Real& variable) { add(&variable, 1, false); }
+
+        // stops tracking the block starting at the given variable, leaving it passive
+        void remove(Real& first) {
+            auto block = std::find_if(blocks_.begin(), blocks_.end(),
+                                      [&](const Block& b) { return b.data == &first; });
+            QL_REQUIRE(block != blocks_.end(), "variable not tracked");
+            for (Size i = 0; i < block->size; ++i)
+                detail::resetToPassive(block->data[i]);
+            blocks_.erase(block);
+        }
+
+        Size numberOfInputs() const {
+            Size n = 0;
+            for (const auto& b : blocks_)
+                n += b.input ? b.size : 0;
+            return n;
+        }
+
+        // how often the tape was recycled
+        Size recyclings() const { return recyclings_; }
+
+        /* Recycles the slots of the tape: observers are notified, the tracked variables
+         * are reset to passive, the tape is cleared, and the input blocks are registered
+         * again before a new recording is started.
+         */
+        void newRecording() {
+            notifyObservers();
+            for (auto& b : blocks_)
+                for (Size i = 0; i < b.size; ++i)
+                    detail::resetToPassive(b.data[i]);
+            tape_->clearAll();
+            for (auto& b : blocks_)
+                for (Size i = 0; b.input && i < b.size; ++i)
+                    tape_->registerInput(b.data[i]);
+            tape_->newRecording();
+            ++recyclings_;
+        }
+
+      private:
+        struct Block {
+            Real* data;
+            Size size;
+            bool input;
+        };
+
+        void add(Real* data, Size size, bool input) {
+            for (const auto& b : blocks_)
+                QL_REQUIRE(data + size <= b.data || b.data + b.size <= data,
+                           "variables already tracked");
+            blocks_.push_back({data, size, input});
+        }
+
+        tape_type* tape_;
+        std::vector<Block> blocks_;
+        Size recyclings_ = 0;
+    };
+
+}
+
+#endif
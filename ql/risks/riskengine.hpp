@@ -0,0 +1,209 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/errors.hpp>
+#include <ql/risks/adjointnode.hpp>
+#include <ql/types.hpp>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef QLRISKS_DISABLE_AAD
+
+namespace QuantLib {
+
+    // Read-only view of a contiguous range of sensitivities held by a RiskEngine
+    class SensitivityView {
+      public:
+        SensitivityView(const double* data, Size size) : data_(data), size_(size) {}
+
+        const double* begin() const { return data_; }
+        const double* end() const { return data_ + size_; }
+        const double* data() const { return data_; }
+        Size size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+        double operator[](Size i) const { return data_[i]; }
+
+      private:
+        const double* data_;
+        Size size_;
+    };
+
+    /* Computes the values and sensitivities of a batch of pricers in one recording.
+     *
+     * Risk factors are registered in named blocks, in place: the pricers read the caller's
+     * variables, which are made inputs of each new recording.  The variables must outlive the
+     * engine and must not be reallocated while registered.  The values and sensitivities are
+     * kept in buffers owned by the engine, which are only allocated on the first calculation,
+     * so that repeated calculations in a risk loop do not allocate.
+     *
+     *     RiskEngine engine;
+     *     engine.addFactors("rates", rates);
+     *     engine.addFactor("vol", vol);
+     *     engine.addPricer([&]() { return priceOption(rates, vol); });
+     *     double npv = engine.calculate()[0];
+     *     SensitivityView rhos = engine.sensitivities("rates");
+     */
+    class RiskEngine {
+      public:
+        typedef std::function<Real()> Pricer;
+
+        // uses the tape active on this thread
+        RiskEngine() : tape_(Real::tape_type::getActive()) {
+            QL_REQUIRE(tape_ != nullptr, "no active tape on this thread");
+        }
+
+        explicit RiskEngine(Real::tape_type& tape) : tape_(&tape) {}
+
+        void addFactors(std::string name, std::vector<Real>& factors) {
+            addBlock(std::move(name), factors.data(), factors.size());
+        }
+
+        void addFactor(std::string name, Real& factor) { addBlock(std::move(name), &factor, 1); }
+
+        // adds a pricer and returns the index of its output
+        Size addPricer(Pricer pricer) {
+            pricers_.push_back(std::move(pricer));
+            return pricers_.size() - 1;
+        }
+
+        Size numberOfFactors() const { return nFactors_; }
+        Size numberOfOutputs() const { return pricers_.size(); }
+
+        /* Records all the pricers with the registered factors as inputs, and sweeps the
+         * recording once per output.  Returns the output values.
+         */
+        const std::vector<double>& calculate() {
+            record();
+            sweep();
+            return values_;
+        }
+
+        /* The two steps of calculate(), for callers timing or profiling them separately:
+         * record() records the pricers and returns the output values, and sweep() then
+         * computes the sensitivities of that recording.
+         */
+        const std::vector<double>& record() {
+            QL_REQUIRE(!pricers_.empty(), "no pricers added to the risk engine");
+            Size m = pricers_.size();
+
+            // the variables of the previous recording are re-created as passive ones,
+            // before the recording is cleared
+            for (auto& block : blocks_)
+                for (Size i = 0; i < block.size; ++i)
+                    detail::resetToPassive(block.data[i]);
+            for (auto& output : outputs_)
+                detail::resetToPassive(output);
+
+            tape_->clearAll();
+            for (auto& block : blocks_)
+                for (Size i = 0; i < block.size; ++i)
+                    tape_->registerInput(block.data[i]);
+            tape_->newRecording();
+
+            // the sensitivities of the previous recording are no longer valid
+            gradients_.clear();
+            outputs_.resize(m);
+            values_.resize(m);
+            for (Size k = 0; k < m; ++k) {
+                outputs_[k] = pricers_[k]();
+                tape_->registerOutput(outputs_[k]);
+                values_[k] = value(outputs_[k]);
+            }
+            recorded_ = true;
+            return values_;
+        }
+
+        void sweep() {
+            QL_REQUIRE(recorded_, "no new recording to sweep");
+            Size m = outputs_.size();
+            gradients_.resize(m * nFactors_);
+            for (Size k = 0; k < m; ++k) {
+                if (k > 0)
+                    tape_->clearDerivatives();
+                derivative(outputs_[k]) = 1.0;
+                tape_->computeAdjoints();
+                double* row = gradients_.data() + k * nFactors_;
+                for (auto& block : blocks_)
+                    for (Size i = 0; i < block.size; ++i)
+                        row[block.offset + i] = derivative(block.data[i]);
+            }
+            recorded_ = false;
+        }
+
+        const std::vector<double>& values() const { return values_; }
+
+        // sensitivities of an output to all factors, in registration order
+        SensitivityView sensitivities(Size output = 0) const {
+            checkCalculated(output);
+            return {gradients_.data() + output * nFactors_, nFactors_};
+        }
+
+        // sensitivities of an output to the factors of a block
+        SensitivityView sensitivities(const std::string& block, Size output = 0) const {
+            checkCalculated(output);
+            for (auto& b : blocks_)
+                if (b.name == block)
+                    return {gradients_.data() + output * nFactors_ + b.offset, b.size};
+            QL_FAIL("unknown risk factor block " << block);
+        }
+
+      private:
+        struct Block {
+            std::string name;
+            Real* data;
+            Size size;
+            Size offset;
+        };
+
+        void addBlock(std::string name, Real* data, Size size) {
+            for (auto& b : blocks_)
+                QL_REQUIRE(b.name != name, "risk factor block " << name << " already added");
+            blocks_.push_back({std::move(name), data, size, nFactors_});
+            nFactors_ += size;
+            gradients_.clear();
+            recorded_ = false;
+        }
+
+        void checkCalculated(Size output) const {
+            QL_REQUIRE(output < values_.size(),
+                       "no sensitivities calculated for output " << output);
+            QL_REQUIRE(gradients_.size() == values_.size() * nFactors_,
+                       "no sensitivities for the current recording and risk factors");
+        }
+
+        Real::tape_type* tape_;
+        std::vector<Block> blocks_;
+        std::vector<Pricer> pricers_;
+        std::vector<Real> outputs_;
+        std::vector<double> values_, gradients_;
+        Size nFactors_ = 0;
+        bool recorded_ = false;
+    };
+
+}
+
+#endif
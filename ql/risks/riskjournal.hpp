@@ -0,0 +1,234 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/errors.hpp>
+#include <ql/types.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace QuantLib {
+
+    namespace detail {
+
+        const std::uint64_t fnvOffsetBasis = 14695981039346656037ULL;
+
+        inline std::uint64_t fnv1a(const void* data, std::size_t size, std::uint64_t hash) {
+            auto bytes = static_cast<const unsigned char*>(data);
+            for (std::size_t i = 0; i < size; ++i) {
+                hash ^= bytes[i];
+                hash *= 1099511628211ULL;
+            }
+            return hash;
+        }
+
+    }
+
+    // Identifies the market snapshot a journal was written for (FNV-1a over the raw values)
+    inline std::uint64_t hashSnapshot(const std::vector<double>& marketData) {
+        return detail::fnv1a(marketData.data(), marketData.size() * sizeof(double),
+                             detail::fnvOffsetBasis);
+    }
+
+    // Identifies a portfolio from the terms of its trades (FNV-1a over the raw values)
+    inline std::uint64_t hashPortfolio(const std::vector<double>& tradeTerms) {
+        return detail::fnv1a(tradeTerms.data(), tradeTerms.size() * sizeof(double),
+                             detail::fnvOffsetBasis);
+    }
+
+    // How a risk job is split into shards: a journal is only reused by the same layout
+    struct RiskJobLayout {
+        Size shards = 0;
+        Size shardSize = 0;
+        std::uint64_t portfolioHash = 0; // hashPortfolio() of the trades
+    };
+
+    // Results of one shard of a risk job
+    struct RiskShard {
+        std::vector<double> npvs;      // one per trade
+        std::vector<double> gradients; // trades x inputs, row-major
+    };
+
+    /* Local journal of the completed shards of a long-running risk job.
+     *
+     * Each shard is appended and flushed as soon as it completes, so that a job killed
+     * partway through only loses the shard in flight.  On opening, shards recorded for the
+     * same market snapshot and job layout are loaded; a journal for a different snapshot,
+     * shard layout or portfolio is discarded, and a record torn by a crash is detected by
+     * its checksum and dropped.
+     *
+     * The file uses the native byte order and is meant for restarts on the same machine.
+     * It is not safe for concurrent writers.
+     */
+    class RiskJournal {
+      public:
+        RiskJournal(std::string path, std::uint64_t snapshotHash, const RiskJobLayout& layout)
+        : path_(std::move(path)), snapshotHash_(snapshotHash), layout_(layout) {
+            if (!load())
+                rewrite();
+        }
+
+        const RiskJobLayout& layout() const { return layout_; }
+
+        bool completed(Size shard) const { return shards_.count(shard) != 0; }
+        Size completedShards() const { return shards_.size(); }
+
+        const RiskShard& shard(Size shard) const {
+            auto it = shards_.find(shard);
+            QL_REQUIRE(it != shards_.end(), "shard " << shard << " not in risk journal");
+            return it->second;
+        }
+
+        void record(Size shard, const RiskShard& result) {
+            QL_REQUIRE(shard < layout_.shards,
+                       "shard " << shard << " out of the " << layout_.shards << " of the job");
+            std::vector<char> buffer;
+            append(buffer, static_cast<std::uint64_t>(shard));
+            append(buffer, static_cast<std::uint64_t>(result.npvs.size()));
+            append(buffer, static_cast<std::uint64_t>(result.gradients.size()));
+            for (double x : result.npvs)
+                append(buffer, x);
+            for (double x : result.gradients)
+                append(buffer, x);
+            append(buffer, detail::fnv1a(buffer.data(), buffer.size(), detail::fnvOffsetBasis));
+
+            std::ofstream out(path_, std::ios::binary | std::ios::app);
+            out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            out.flush();
+            QL_REQUIRE(out, "failed to write risk journal " << path_);
+            shards_[shard] = result;
+        }
+
+        // deletes the journal file, once the job has completed
+        void remove() {
+            std::remove(path_.c_str());
+            shards_.clear();
+        }
+
+      private:
+        static const std::uint64_t magic = 0x324a52514c51ULL; // "QLQRJ2"
+
+        template <class T>
+        static void append(std::vector<char>& buffer, T x) {
+            const char* bytes = reinterpret_cast<const char*>(&x);
+            buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+        }
+
+        template <class T>
+        static bool read(std::istream& in, T& x, std::uint64_t& hash) {
+            if (!in.read(reinterpret_cast<char*>(&x), sizeof(T)))
+                return false;
+            hash = detail::fnv1a(&x, sizeof(T), hash);
+            return true;
+        }
+
+        // returns false if the file needs rewriting: missing, for another snapshot or job
+        // layout, or torn
+        bool load() {
+            std::ifstream in(path_, std::ios::binary | std::ios::ate);
+            auto fileSize = static_cast<std::uint64_t>(in.tellg());
+            in.seekg(0);
+            std::uint64_t fileMagic = 0, fileHash = 0, shards = 0, shardSize = 0, portfolio = 0,
+                          unused = 0;
+            if (!read(in, fileMagic, unused) || !read(in, fileHash, unused) ||
+                !read(in, shards, unused) || !read(in, shardSize, unused) ||
+                !read(in, portfolio, unused) || fileMagic != magic || fileHash != snapshotHash_ ||
+                shards != layout_.shards || shardSize != layout_.shardSize ||
+                portfolio != layout_.portfolioHash)
+                return false;
+
+            for (;;) {
+                if (in.peek() == std::char_traits<char>::eof())
+                    return true;
+                std::uint64_t checksum = detail::fnvOffsetBasis, shard, nNpvs, nGradients;
+                RiskShard result;
+                if (!read(in, shard, checksum) || !read(in, nNpvs, checksum) ||
+                    !read(in, nGradients, checksum) || shard >= layout_.shards ||
+                    nNpvs + nGradients > fileSize / sizeof(double))
+                    return false;
+                result.npvs.resize(nNpvs);
+                result.gradients.resize(nGradients);
+                for (double& x : result.npvs)
+                    if (!read(in, x, checksum))
+                        return false;
+                for (double& x : result.gradients)
+                    if (!read(in, x, checksum))
+                        return false;
+                std::uint64_t stored;
+                if (!read(in, stored, unused) || stored != checksum)
+                    return false;
+                shards_[static_cast<Size>(shard)] = std::move(result);
+            }
+        }
+
+        // writes the header and the valid shards loaded so far
+        void rewrite() {
+            std::map<Size, RiskShard> shards;
+            shards.swap(shards_);
+            {
+                std::vector<char> header;
+                append(header, magic);
+                append(header, snapshotHash_);
+                append(header, static_cast<std::uint64_t>(layout_.shards));
+                append(header, static_cast<std::uint64_t>(layout_.shardSize));
+                append(header, layout_.portfolioHash);
+                std::ofstream out(path_, std::ios::binary | std::ios::trunc);
+                out.write(header.data(), static_cast<std::streamsize>(header.size()));
+                QL_REQUIRE(out, "failed to create risk journal " << path_);
+            }
+            for (const auto& s : shards)
+                record(s.first, s.second);
+        }
+
+        std::string path_;
+        std::uint64_t snapshotHash_;
+        RiskJobLayout layout_;
+        std::map<Size, RiskShard> shards_;
+    };
+
+    /* Runs the shards of the journal's job layout with RiskShard task(Size shard), skipping
+     * the ones already in the journal and recording the others as they complete.
+     */
+    template <class ShardTask>
+    std::vector<RiskShard> runShards(RiskJournal& journal, const ShardTask& task) {
+        const Size nShards = journal.layout().shards;
+        std::vector<RiskShard> results(nShards);
+        for (Size k = 0; k < nShards; ++k) {
+            if (journal.completed(k)) {
+                results[k] = journal.shard(k);
+            } else {
+                results[k] = task(k);
+                journal.record(k, results[k]);
+            }
+        }
+        return results;
+    }
+
+}
@@ -0,0 +1,330 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/errors.hpp>
+#include <ql/risks/risksession.hpp>
+#include <ql/risks/tapehandoff.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace QuantLib {
+
+    /* A task of a risk run, e.g. the pricing of one trade with sensitivities.  The size is
+     * the amount of work within the kind, such as the number of time steps times the grid
+     * points of a finite-difference engine, or 1 for trades of similar cost.
+     */
+    struct RiskTask {
+        std::string kind;
+        double size = 1.0;
+    };
+
+    /* Estimated run time and tape memory of risk tasks, learnt from past runs.
+     *
+     * For each kind, the model keeps exponentially weighted moving averages of the
+     * seconds and bytes per unit of size, so that it follows changes in the trades and
+     * machines while smoothing out noisy timings.  Kinds without measurements are
+     * estimated at the highest known cost per unit, so that they are scheduled early.
+     */
+    class TaskCostModel {
+      public:
+        // smoothing is the weight of the latest measurement
+        explicit TaskCostModel(double smoothing = 0.3) : smoothing_(smoothing) {
+            QL_REQUIRE(smoothing > 0.0 && smoothing <= 1.0,
+                       "smoothing (" << smoothing << ") must be in (0, 1]");
+        }
+
+        bool known(const std::string& kind) const { return rates_.count(kind) != 0; }
+
+        double seconds(const RiskTask& task) const { return rate(task.kind).seconds * task.size; }
+
+        double memory(const RiskTask& task) const { return rate(task.kind).memory * task.size; }
+
+        void observe(const RiskTask& task, double seconds, std::size_t memory) {
+            QL_REQUIRE(task.size > 0.0, "task of size " << task.size);
+            Rate measured = {seconds / task.size, static_cast<double>(memory) / task.size};
+            auto it = rates_.find(task.kind);
+            if (it == rates_.end()) {
+                rates_.emplace(task.kind, measured);
+                return;
+            }
+            it->second.seconds += smoothing_ * (measured.seconds - it->second.seconds);
+            it->second.memory += smoothing_ * (measured.memory - it->second.memory);
+        }
+
+      private:
+        struct Rate {
+            double seconds, memory;
+        };
+
+        Rate rate(const std::string& kind) const {
+            auto it = rates_.find(kind);
+            if (it != rates_.end())
+                return it->second;
+            Rate highest = {rates_.empty() ? 1.0 : 0.0, 0.0};
+            for (const auto& r : rates_) {
+                highest.seconds = std::max(highest.seconds, r.second.seconds);
+                highest.memory = std::max(highest.memory, r.second.memory);
+            }
+            return highest;
+        }
+
+        double smoothing_;
+        std::map<std::string, Rate> rates_;
+    };
+
+    namespace detail {
+
+        /* One task queue per thread, with the tasks in decreasing order of estimated cost.
+         * The owner takes its tasks from the front.  A thread without tasks steals the
+         * front task, i.e. the longest pending one, of the queue with the most estimated
+         * work pending: that is the task most likely to keep its owner busy while the
+         * others are idle at the end of the run, and taking it moves the most work at the
+         * cost of one steal.
+         */
+        class WorkStealingQueues {
+          public:
+            explicit WorkStealingQueues(Size n) : queues_(n) {}
+
+            void push(Size queue, Size task, double cost) {
+                Queue& q = queues_[queue];
+                std::lock_guard<std::mutex> lock(q.mutex);
+                q.tasks.push_back({task, cost});
+                q.pending += cost;
+            }
+
+            bool pop(Size queue, Size& task) {
+                Queue& q = queues_[queue];
+                std::lock_guard<std::mutex> lock(q.mutex);
+                if (q.tasks.empty())
+                    return false;
+                task = q.tasks.front().first;
+                q.pending -= q.tasks.front().second;
+                q.tasks.pop_front();
+                return true;
+            }
+
+            bool steal(Size thief, Size& task) {
+                for (;;) {
+                    Size victim = queues_.size();
+                    double most = 0.0;
+                    for (Size k = 0; k < queues_.size(); ++k) {
+                        if (k == thief)
+                            continue;
+                        Queue& q = queues_[k];
+                        std::lock_guard<std::mutex> lock(q.mutex);
+                        if (!q.tasks.empty() && (victim == queues_.size() || q.pending > most)) {
+                            victim = k;
+                            most = q.pending;
+                        }
+                    }
+                    if (victim == queues_.size())
+                        return false;
+                    // the victim may have emptied its queue in the meantime
+                    if (pop(victim, task)) {
+                        ++steals_;
+                        return true;
+                    }
+                }
+            }
+
+            Size steals() const { return steals_; }
+
+          private:
+            struct Queue {
+                std::mutex mutex;
+                std::deque<std::pair<Size, double>> tasks;
+                double pending = 0.0;
+            };
+            std::vector<Queue> queues_;
+            std::atomic<Size> steals_{0};
+        };
+
+        /* Deals the tasks with the given estimated costs to the queues, longest first, each
+         * to the queue with the least estimated work so far.
+         */
+        inline void dealTasks(const std::vector<double>& estimates, WorkStealingQueues& queues,
+                              Size n) {
+            std::vector<Size> order(estimates.size());
+            for (Size i = 0; i < order.size(); ++i)
+                order[i] = i;
+            std::stable_sort(order.begin(), order.end(),
+                             [&](Size i, Size j) { return estimates[i] > estimates[j]; });
+            std::vector<double> load(n, 0.0);
+            for (Size i : order) {
+                Size t = std::min_element(load.begin(), load.end()) - load.begin();
+                queues.push(t, i, estimates[i]);
+                load[t] += estimates[i];
+            }
+        }
+
+        // admits tasks while their estimated tape memory fits in the limit (0 for none)
+        class MemoryAdmission {
+          public:
+            explicit MemoryAdmission(double limit) : limit_(limit) {}
+
+            void acquire(double bytes) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                // a task larger than the limit runs alone
+                admitted_.wait(lock, [&]() {
+                    return limit_ <= 0.0 || running_ == 0 || inUse_ + bytes <= limit_;
+                });
+                inUse_ += bytes;
+                ++running_;
+            }
+
+            void release(double bytes) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    inUse_ -= bytes;
+                    --running_;
+                }
+                admitted_.notify_all();
+            }
+
+          private:
+            std::mutex mutex_;
+            std::condition_variable admitted_;
+            double limit_, inUse_ = 0.0;
+            Size running_ = 0;
+        };
+
+    }
+
+    /* Runs job(i, session) for the given tasks on the given number of threads, like
+     * runRiskSessions, balancing heterogeneous tasks with their estimated costs.
+     *
+     * The tasks are sorted longest first and dealt to the thread with the least estimated
+     * work, so that each thread starts with its longest tasks.  A thread that runs out of
+     * work steals the longest pending task of the thread with the most pending work, so
+     * that the run does not end with one thread grinding through a long task while the
+     * others are idle.  With a non-zero memoryLimit, tasks only start while the estimated
+     * tape memory of the running tasks fits in it.
+     *
+     * Each thread records on a tape of its own, including the calling thread when it runs
+     * the tasks itself: a tape active on it is suspended for the run and left untouched.
+     * The time of each task, and the memory of its thread's tape after it (the tape is
+     * cleared before each task), are fed back into the cost model once the run is done.
+     * The first exception thrown by a job stops the run and is rethrown.
+     */
+    template <class Job>
+    void runScheduledRiskSessions(const SessionContext& context,
+                                  const std::vector<RiskTask>& tasks,
+                                  Size threads,
+                                  TaskCostModel& costs,
+                                  const Job& job,
+                                  std::size_t memoryLimit = 0) {
+        QL_REQUIRE(threads > 0, "at least one thread required");
+        const Size n = tasks.size();
+        threads = std::min(threads, std::max<Size>(n, 1));
+        QL_REQUIRE(threads <= 1 || sessionsEnabled(),
+                   "concurrent risk sessions require QuantLib built with QL_ENABLE_SESSIONS");
+
+        if (n == 0)
+            return;
+
+        std::vector<double> estimates(n);
+        for (Size i = 0; i < n; ++i) {
+            QL_REQUIRE(tasks[i].size > 0.0,
+                       "task " << i << " of kind " << tasks[i].kind << " has size "
+                               << tasks[i].size);
+            estimates[i] = costs.seconds(tasks[i]);
+        }
+        detail::WorkStealingQueues queues(threads);
+        detail::dealTasks(estimates, queues, threads);
+
+        detail::MemoryAdmission admission(static_cast<double>(memoryLimit));
+        std::vector<double> seconds(n, -1.0), memory(n, 0.0);
+        std::vector<std::exception_ptr> errors(threads);
+        std::mutex stopMutex;
+        bool stopped = false;
+        auto work = [&](Size t) {
+            try {
+#ifndef QLRISKS_DISABLE_AAD
+                ActiveTapeSuspension suspension;
+#endif
+                RiskSession session(context);
+                Size i;
+                while (queues.pop(t, i) || queues.steal(t, i)) {
+                    {
+                        std::lock_guard<std::mutex> lock(stopMutex);
+                        if (stopped)
+                            return;
+                    }
+                    double bytes = costs.memory(tasks[i]);
+                    admission.acquire(bytes);
+                    struct Release {
+                        detail::MemoryAdmission& admission;
+                        double bytes;
+                        ~Release() { admission.release(bytes); }
+                    } release{admission, bytes};
+#ifndef QLRISKS_DISABLE_AAD
+                    session.tape().clearAll();
+#endif
+                    auto start = std::chrono::steady_clock::now();
+                    job(i, session);
+                    seconds[i] =
+                        std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+                            .count();
+#ifndef QLRISKS_DISABLE_AAD
+                    memory[i] = static_cast<double>(session.tape().getMemory());
+#endif
+                }
+            } catch (...) {
+                errors[t] = std::current_exception();
+                std::lock_guard<std::mutex> lock(stopMutex);
+                stopped = true;
+            }
+        };
+
+        if (threads == 1) {
+            work(0);
+        } else {
+            std::vector<std::thread> workers;
+            for (Size t = 0; t < threads; ++t)
+                workers.emplace_back(work, t);
+            for (auto& w : workers)
+                w.join();
+        }
+
+        for (Size i = 0; i < n; ++i)
+            if (seconds[i] >= 0.0)
+                costs.observe(tasks[i], seconds[i], static_cast<std::size_t>(memory[i]));
+        for (const auto& e : errors)
+            if (e)
+                std::rethrow_exception(e);
+    }
+
+}
@@ -0,0 +1,240 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/errors.hpp>
+#include <ql/indexes/indexmanager.hpp>
+#include <ql/settings.hpp>
+#include <algorithm>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef QLRISKS_DISABLE_AAD
+#    include <XAD/XAD.hpp>
+#endif
+
+namespace QuantLib {
+
+    // the part of QuantLib's global state that a risk job sets up before pricing
+    struct SessionContext {
+        Date evaluationDate; // left unchanged if null
+        bool includeReferenceDateEvents = false;
+        ext::optional<bool> includeTodaysCashFlows;
+        bool enforcesTodaysHistoricFixings = false;
+        // index fixings by index name; the values must be passive
+        std::map<std::string, TimeSeries<Real>> fixings;
+    };
+
+    // the Settings and fixings of the current thread, to price on other threads in sessions
+    // with the same state
+    inline SessionContext currentSessionContext() {
+        SessionContext context;
+        Settings& settings = Settings::instance();
+        context.evaluationDate = settings.evaluationDate();
+        context.includeReferenceDateEvents = settings.includeReferenceDateEvents();
+        context.includeTodaysCashFlows = settings.includeTodaysCashFlows();
+        context.enforcesTodaysHistoricFixings = settings.enforcesTodaysHistoricFixings();
+        IndexManager& fixings = IndexManager::instance();
+        for (const auto& name : fixings.histories())
+            context.fixings.emplace(name, fixings.getHistory(name));
+        return context;
+    }
+
+    /* Whether QuantLib keeps one Settings and IndexManager per thread.  QuantLib then
+     * leaves the definition of QuantLib::sessionId() to the program, and risk sessions
+     * need it to return the id of the calling thread, as QLRISKS_DEFINE_SESSION_ID does.
+     */
+    inline bool sessionsEnabled() {
+#ifdef QL_ENABLE_SESSIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    namespace detail {
+
+        /* Registers a session on the current thread.  Without QL_ENABLE_SESSIONS, sessions
+         * are only allowed on one thread at a time. */
+        class SessionGuard {
+          public:
+            SessionGuard() {
+                if (sessionsEnabled())
+                    return;
+                State& state = globalState();
+                std::lock_guard<std::mutex> lock(state.mutex);
+                QL_REQUIRE(state.depth == 0 || state.thread == std::this_thread::get_id(),
+                           "concurrent risk sessions require QuantLib built with "
+                           "QL_ENABLE_SESSIONS");
+                state.thread = std::this_thread::get_id();
+                ++state.depth;
+            }
+
+            ~SessionGuard() {
+                if (sessionsEnabled())
+                    return;
+                State& state = globalState();
+                std::lock_guard<std::mutex> lock(state.mutex);
+                --state.depth;
+            }
+
+            SessionGuard(const SessionGuard&) = delete;
+            SessionGuard& operator=(const SessionGuard&) = delete;
+
+          private:
+            struct State {
+                std::mutex mutex;
+                std::thread::id thread;
+                Size depth = 0;
+            };
+
+            static State& globalState() {
+                static State state;
+                return state;
+            }
+        };
+
+    }
+
+    /* Applies a SessionContext to the Settings and IndexManager of the current thread for
+     * its lifetime, and restores them afterwards.  Unless a tape is already active, it also
+     * creates a tape for the thread, so that each session records on its own.
+     *
+     * With QuantLib built with QL_ENABLE_SESSIONS, Settings and IndexManager are per thread
+     * and sessions on different threads are independent.  Otherwise they are process-wide,
+     * and opening a session while another thread has one open fails instead of silently
+     * sharing the evaluation date and fixings.  Sessions may be nested on one thread.
+     */
+    class RiskSession {
+      public:
+        explicit RiskSession(const SessionContext& context) {
+            Settings& settings = Settings::instance();
+            if (context.evaluationDate != Date())
+                settings.evaluationDate() = context.evaluationDate;
+            settings.includeReferenceDateEvents() = context.includeReferenceDateEvents;
+            settings.includeTodaysCashFlows() = context.includeTodaysCashFlows;
+            settings.enforcesTodaysHistoricFixings() = context.enforcesTodaysHistoricFixings;
+
+            IndexManager& fixings = IndexManager::instance();
+            for (const auto& history : context.fixings) {
+                savedFixings_.emplace(history.first, fixings.getHistory(history.first));
+                fixings.setHistory(history.first, history.second);
+            }
+
+#ifndef QLRISKS_DISABLE_AAD
+            if (Real::tape_type::getActive() == nullptr)
+                tape_.reset(new Real::tape_type());
+#endif
+        }
+
+        ~RiskSession() {
+#ifndef QLRISKS_DISABLE_AAD
+            tape_.reset();
+#endif
+            for (const auto& history : savedFixings_)
+                IndexManager::instance().setHistory(history.first, history.second);
+        }
+
+        RiskSession(const RiskSession&) = delete;
+        RiskSession& operator=(const RiskSession&) = delete;
+
+#ifndef QLRISKS_DISABLE_AAD
+        // the tape active on this thread
+        Real::tape_type& tape() const {
+            auto* tape = Real::tape_type::getActive();
+            QL_REQUIRE(tape != nullptr, "no active tape on this thread");
+            return *tape;
+        }
+#endif
+
+      private:
+        // declared in this order so that the settings are saved after the session is
+        // registered, and restored before it is released
+        detail::SessionGuard guard_;
+        SavedSettings saved_;
+        std::map<std::string, TimeSeries<Real>> savedFixings_;
+#ifndef QLRISKS_DISABLE_AAD
+        std::unique_ptr<Real::tape_type> tape_;
+#endif
+    };
+
+    /* Runs job(i, session) for i = 0, ..., n - 1 on the given number of threads, each
+     * thread in its own RiskSession with the given context.  The first exception thrown
+     * by a job is rethrown once all threads have finished.  More than one thread requires
+     * QuantLib built with QL_ENABLE_SESSIONS.
+     */
+    template <class Job>
+    void runRiskSessions(const SessionContext& context, Size n, Size threads, const Job& job) {
+        QL_REQUIRE(threads > 0, "at least one thread required");
+        threads = std::min(threads, n);
+        QL_REQUIRE(threads <= 1 || sessionsEnabled(),
+                   "concurrent risk sessions require QuantLib built with QL_ENABLE_SESSIONS");
+        if (threads <= 1) {
+            RiskSession session(context);
+            for (Size i = 0; i < n; ++i)
+                job(i, session);
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        std::vector<std::exception_ptr> errors(threads);
+        for (Size t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                try {
+                    RiskSession session(context);
+                    for (Size i = t; i < n; i += threads)
+                        job(i, session);
+                } catch (...) {
+                    errors[t] = std::current_exception();
+                }
+            });
+        }
+        for (auto& w : workers)
+            w.join();
+        for (const auto& e : errors)
+            if (e)
+                std::rethrow_exception(e);
+    }
+
+}
+
+/* Defines QuantLib::sessionId() as the id of the calling thread, which QuantLib built with
+ * QL_ENABLE_SESSIONS requires the program to provide, so that each thread running risk
+ * sessions has its own Settings and IndexManager.  This macro expands to nothing without
+ * QL_ENABLE_SESSIONS.  It must be used once in a program, at global scope in one of its
+ * source files, e.g. next to main().
+ */
+#ifdef QL_ENABLE_SESSIONS
+#    define QLRISKS_DEFINE_SESSION_ID                                                            \
+        namespace QuantLib {                                                                     \
+            ThreadKey sessionId() { return std::this_thread::get_id(); }                         \
+        }
+#else
+#    define QLRISKS_DEFINE_SESSION_ID
+#endif
@@ -0,0 +1,83 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/errors.hpp>
+#include <ql/risks/scenarioreal.hpp>
+#include <ql/types.hpp>
+#include <algorithm>
+#include <vector>
+
+namespace QuantLib {
+
+    /* Prices a set of market scenarios in batches of N lanes, with a pricer
+     *     ScenarioReal<N> pricer(const std::vector<ScenarioReal<N>>& factors)
+     * which, in a scenario build, is the usual Real pricer(const std::vector<Real>&).
+     *
+     * Lane k of a batch holds scenario k of the batch, and the last batch is padded with
+     * copies of the last scenario.  When the lanes of a batch diverge in control flow, the
+     * batch falls back to one pass per scenario with the factors broadcast to all lanes.
+     * The number of batches that fell back is returned in divergentBatches if given.
+     */
+    template <std::size_t N, class Pricer>
+    std::vector<double> priceScenarios(const Pricer& pricer,
+                                       const std::vector<std::vector<double>>& scenarios,
+                                       Size* divergentBatches = nullptr) {
+        std::vector<double> results;
+        if (divergentBatches != nullptr)
+            *divergentBatches = 0;
+        if (scenarios.empty())
+            return results;
+
+        Size nFactors = scenarios.front().size();
+        for (const auto& s : scenarios)
+            QL_REQUIRE(s.size() == nFactors, "scenarios have different numbers of factors ("
+                                                 << s.size() << ", " << nFactors << ")");
+
+        results.reserve(scenarios.size());
+        std::vector<ScenarioReal<N>> x(nFactors);
+        for (Size begin = 0; begin < scenarios.size(); begin += N) {
+            Size size = std::min<Size>(N, scenarios.size() - begin);
+            for (Size i = 0; i < nFactors; ++i)
+                for (Size k = 0; k < N; ++k)
+                    x[i].lane(k) = scenarios[begin + std::min<Size>(k, size - 1)][i];
+
+            try {
+                ScenarioReal<N> y = pricer(x);
+                for (Size k = 0; k < size; ++k)
+                    results.push_back(y.lane(k));
+            } catch (LaneDivergence&) {
+                if (divergentBatches != nullptr)
+                    ++*divergentBatches;
+                for (Size k = 0; k < size; ++k) {
+                    for (Size i = 0; i < nFactors; ++i)
+                        x[i] = ScenarioReal<N>(scenarios[begin + k][i]);
+                    results.push_back(pricer(x).lane(0));
+                }
+            }
+        }
+        return results;
+    }
+
+}
@@ -0,0 +1,282 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+// This header is included before any QuantLib header in scenario builds (see
+// ql/qlscenarios.hpp), so it must only depend on the standard library.
+
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+
+namespace QuantLib {
+
+    namespace scenarios {
+
+        /* Thrown when control flow depends on a comparison (or a conversion to a scalar) on
+         * which the lanes disagree.  The computation can then only be completed one scenario
+         * at a time.
+         */
+        class LaneDivergence : public std::runtime_error {
+          public:
+            LaneDivergence() : std::runtime_error("scenario lanes diverge in control flow") {}
+        };
+
+        /* A batch of N scenario values, with lane-wise arithmetic.
+         *
+         * Pricing code written for Real runs all N scenarios in one pass when Real is
+         * ScenarioReal<N>.  The lanes are a plain array, so the compiler vectorises the
+         * lane loops to the available SIMD width (e.g. N = 8 fills an AVX-512 register).
+         * Comparisons return the common result of all lanes and throw LaneDivergence if the
+         * lanes disagree.
+         */
+        template <std::size_t N>
+        class ScenarioReal {
+          public:
+            static_assert(N > 0, "at least one scenario lane required");
+            static constexpr std::size_t lanes = N;
+
+            ScenarioReal() : ScenarioReal(0.0) {}
+            ScenarioReal(double x) { // NOLINT(google-explicit-constructor): broadcast
+                for (std::size_t i = 0; i < N; ++i)
+                    v_[i] = x;
+            }
+
+            double& lane(std::size_t i) { return v_[i]; }
+            double lane(std::size_t i) const { return v_[i]; }
+
+            // true if all lanes hold the same value (NaNs compare equal here)
+            bool uniform() const {
+                for (std::size_t i = 1; i < N; ++i)
+                    if (v_[i] != v_[0] && !(std::isnan(v_[i]) && std::isnan(v_[0])))
+                        return false;
+                return true;
+            }
+
+            template <class F>
+            ScenarioReal map(F f) const {
+                ScenarioReal r;
+                for (std::size_t i = 0; i < N; ++i)
+                    r.v_[i] = f(v_[i]);
+                return r;
+            }
+
+            template <class F>
+            ScenarioReal zip(const ScenarioReal& other, F f) const {
+                ScenarioReal r;
+                for (std::size_t i = 0; i < N; ++i)
+                    r.v_[i] = f(v_[i], other.v_[i]);
+                return r;
+            }
+
+            // the common value of a lane-wise predicate, or LaneDivergence
+            template <class P>
+            bool all(const ScenarioReal& other, P p) const {
+                std::size_t count = 0;
+                for (std::size_t i = 0; i < N; ++i)
+                    count += p(v_[i], other.v_[i]) ? 1 : 0;
+                if (count != 0 && count != N)
+                    throw LaneDivergence();
+                return count == N;
+            }
+
+            ScenarioReal& operator+=(const ScenarioReal& x) {
+                for (std::size_t i = 0; i < N; ++i)
+                    v_[i] += x.v_[i];
+                return *this;
+            }
+            ScenarioReal& operator-=(const ScenarioReal& x) {
+                for (std::size_t i = 0; i < N; ++i)
+                    v_[i] -= x.v_[i];
+                return *this;
+            }
+            ScenarioReal& operator*=(const ScenarioReal& x) {
+                for (std::size_t i = 0; i < N; ++i)
+                    v_[i] *= x.v_[i];
+                return *this;
+            }
+            ScenarioReal& operator/=(const ScenarioReal& x) {
+                for (std::size_t i = 0; i < N; ++i)
+                    v_[i] /= x.v_[i];
+                return *this;
+            }
+
+            ScenarioReal operator-() const {
+                return map([](double x) { return -x; });
+            }
+            ScenarioReal operator+() const { return *this; }
+
+            // hidden friends, so that scalars convert on either side
+            friend ScenarioReal operator+(ScenarioReal a, const ScenarioReal& b) { return a += b; }
+            friend ScenarioReal operator-(ScenarioReal a, const ScenarioReal& b) { return a -= b; }
+            friend ScenarioReal operator*(ScenarioReal a, const ScenarioReal& b) { return a *= b; }
+            friend ScenarioReal operator/(ScenarioReal a, const ScenarioReal& b) { return a /= b; }
+
+            friend bool operator<(const ScenarioReal& a, const ScenarioReal& b) {
+                return a.all(b, [](double x, double y) { return x < y; });
+            }
+            friend bool operator<=(const ScenarioReal& a, const ScenarioReal& b) {
+                return a.all(b, [](double x, double y) { return x <= y; });
+            }
+            friend bool operator>(const ScenarioReal& a, const ScenarioReal& b) {
+                return a.all(b, [](double x, double y) { return x > y; });
+            }
+            friend bool operator>=(const ScenarioReal& a, const ScenarioReal& b) {
+                return a.all(b, [](double x, double y) { return x >= y; });
+            }
+            friend bool operator==(const ScenarioReal& a, const ScenarioReal& b) {
+                return a.all(b, [](double x, double y) { return x == y; });
+            }
+            friend bool operator!=(const ScenarioReal& a, const ScenarioReal& b) {
+                return a.all(b, [](double x, double y) { return x != y; });
+            }
+
+            friend std::ostream& operator<<(std::ostream& out, const ScenarioReal& x) {
+                out << '[';
+                for (std::size_t i = 0; i < N; ++i)
+                    out << (i == 0 ? "" : ", ") << x.v_[i];
+                return out << ']';
+            }
+
+          private:
+            double v_[N];
+        };
+
+        // the scalar value, if all lanes agree
+        template <std::size_t N>
+        double value(const ScenarioReal<N>& x) {
+            if (!x.uniform())
+                throw LaneDivergence();
+            return x.lane(0);
+        }
+
+#define QLRISKS_SCENARIO_UNARY(name)                                                    \
+    template <std::size_t N>                                                            \
+    ScenarioReal<N> name(const ScenarioReal<N>& x) {                                    \
+        return x.map([](double v) { return std::name(v); });                            \
+    }
+
+#define QLRISKS_SCENARIO_BINARY(name)                                                   \
+    template <std::size_t N>                                                            \
+    ScenarioReal<N> name(const ScenarioReal<N>& x, const ScenarioReal<N>& y) {          \
+        return x.zip(y, [](double a, double b) { return std::name(a, b); });            \
+    }                                                                                   \
+    template <std::size_t N>                                                            \
+    ScenarioReal<N> name(const ScenarioReal<N>& x, double y) {                          \
+        return name(x, ScenarioReal<N>(y));                                             \
+    }                                                                                   \
+    template <std::size_t N>                                                            \
+    ScenarioReal<N> name(double x, const ScenarioReal<N>& y) {                          \
+        return name(ScenarioReal<N>(x), y);                                             \
+    }
+
+        QLRISKS_SCENARIO_UNARY(exp)
+        QLRISKS_SCENARIO_UNARY(expm1)
+        QLRISKS_SCENARIO_UNARY(log)
+        QLRISKS_SCENARIO_UNARY(log10)
+        QLRISKS_SCENARIO_UNARY(log1p)
+        QLRISKS_SCENARIO_UNARY(sqrt)
+        QLRISKS_SCENARIO_UNARY(cbrt)
+        QLRISKS_SCENARIO_UNARY(abs)
+        QLRISKS_SCENARIO_UNARY(fabs)
+        QLRISKS_SCENARIO_UNARY(sin)
+        QLRISKS_SCENARIO_UNARY(cos)
+        QLRISKS_SCENARIO_UNARY(tan)
+        QLRISKS_SCENARIO_UNARY(asin)
+        QLRISKS_SCENARIO_UNARY(acos)
+        QLRISKS_SCENARIO_UNARY(atan)
+        QLRISKS_SCENARIO_UNARY(sinh)
+        QLRISKS_SCENARIO_UNARY(cosh)
+        QLRISKS_SCENARIO_UNARY(tanh)
+        QLRISKS_SCENARIO_UNARY(erf)
+        QLRISKS_SCENARIO_UNARY(erfc)
+        QLRISKS_SCENARIO_UNARY(floor)
+        QLRISKS_SCENARIO_UNARY(ceil)
+        QLRISKS_SCENARIO_UNARY(round)
+        QLRISKS_SCENARIO_UNARY(trunc)
+        QLRISKS_SCENARIO_BINARY(pow)
+        QLRISKS_SCENARIO_BINARY(atan2)
+        QLRISKS_SCENARIO_BINARY(fmod)
+        QLRISKS_SCENARIO_BINARY(fmax)
+        QLRISKS_SCENARIO_BINARY(fmin)
+        QLRISKS_SCENARIO_BINARY(hypot)
+
+#undef QLRISKS_SCENARIO_UNARY
+#undef QLRISKS_SCENARIO_BINARY
+
+        // lane-wise, so that they do not diverge
+        template <std::size_t N>
+        ScenarioReal<N> max(const ScenarioReal<N>& x, const ScenarioReal<N>& y) {
+            return fmax(x, y);
+        }
+        template <std::size_t N>
+        ScenarioReal<N> min(const ScenarioReal<N>& x, const ScenarioReal<N>& y) {
+            return fmin(x, y);
+        }
+
+        template <std::size_t N>
+        ScenarioReal<N> pow(const ScenarioReal<N>& x, int n) {
+            return x.map([n](double v) { return std::pow(v, n); });
+        }
+
+        template <std::size_t N>
+        bool isnan(const ScenarioReal<N>& x) {
+            return x.all(x, [](double v, double) { return std::isnan(v); });
+        }
+        template <std::size_t N>
+        bool isinf(const ScenarioReal<N>& x) {
+            return x.all(x, [](double v, double) { return std::isinf(v); });
+        }
+        template <std::size_t N>
+        bool isfinite(const ScenarioReal<N>& x) {
+            return x.all(x, [](double v, double) { return std::isfinite(v); });
+        }
+
+    }
+
+    using scenarios::LaneDivergence;
+    using scenarios::ScenarioReal;
+
+}
+
+namespace std {
+
+    template <std::size_t N>
+    class numeric_limits<QuantLib::ScenarioReal<N>> : public numeric_limits<double> {
+      public:
+        typedef QuantLib::ScenarioReal<N> T;
+        static T min() { return numeric_limits<double>::min(); }
+        static T max() { return numeric_limits<double>::max(); }
+        static T lowest() { return numeric_limits<double>::lowest(); }
+        static T epsilon() { return numeric_limits<double>::epsilon(); }
+        static T round_error() { return numeric_limits<double>::round_error(); }
+        static T infinity() { return numeric_limits<double>::infinity(); }
+        static T quiet_NaN() { return numeric_limits<double>::quiet_NaN(); }
+        static T signaling_NaN() { return numeric_limits<double>::signaling_NaN(); }
+        static T denorm_min() { return numeric_limits<double>::denorm_min(); }
+    };
+
+}
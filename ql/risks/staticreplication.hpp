@@ -0,0 +1,102 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/instrument.hpp>
+#include <ql/math/matrixutilities/qrdecomposition.hpp>
+#include <ql/quotes/simplequote.hpp>
+#include <ql/settings.hpp>
+#include <utility>
+#include <vector>
+
+namespace QuantLib {
+
+    /* Static replication by least squares.
+     *
+     * Chooses the hedge notionals w that minimise sum_k (V_k - sum_j w_j H_kj)^2, where V_k
+     * and H_kj are the values of the target and of hedge j at grid point k.  A grid point
+     * is an evaluation date and a spot level.  The values are all Real, so with an active
+     * tape the notionals are differentiable with respect to the market inputs and one adjoint
+     * sweep per notional gives the full hedge Jacobian.
+     */
+    class StaticReplication {
+      public:
+        struct GridPoint {
+            Date evaluationDate;
+            Real spot;
+        };
+
+        StaticReplication(ext::shared_ptr<SimpleQuote> spot, std::vector<GridPoint> grid)
+        : spot_(std::move(spot)), grid_(std::move(grid)) {
+            QL_REQUIRE(spot_ != nullptr, "null spot quote");
+            QL_REQUIRE(!grid_.empty(), "empty replication grid");
+        }
+
+        // values of the target (first column) and the hedges at each grid point
+        Matrix gridValues(const ext::shared_ptr<Instrument>& target,
+                          const std::vector<ext::shared_ptr<Instrument>>& hedges) const {
+            Matrix values(grid_.size(), hedges.size() + 1);
+            SavedSettings backup;
+            Real spot = spot_->value();
+            try {
+                for (Size k = 0; k < grid_.size(); ++k) {
+                    Settings::instance().evaluationDate() = grid_[k].evaluationDate;
+                    spot_->setValue(grid_[k].spot);
+                    values[k][0] = target->NPV();
+                    for (Size j = 0; j < hedges.size(); ++j)
+                        values[k][j + 1] = hedges[j]->NPV();
+                }
+            } catch (...) {
+                spot_->setValue(spot);
+                throw;
+            }
+            spot_->setValue(spot);
+            return values;
+        }
+
+        // least-squares hedge notionals, such that target - sum_j w_j hedge_j vanishes
+        // on the grid as closely as possible
+        Array notionals(const ext::shared_ptr<Instrument>& target,
+                        const std::vector<ext::shared_ptr<Instrument>>& hedges) const {
+            QL_REQUIRE(!hedges.empty(), "no hedge instruments given");
+            QL_REQUIRE(grid_.size() >= hedges.size(),
+                       "replication grid has fewer points (" << grid_.size() << ") than hedges ("
+                                                             << hedges.size() << ")");
+            Matrix values = gridValues(target, hedges);
+            Matrix hedgeValues(grid_.size(), hedges.size());
+            Array targetValues(grid_.size());
+            for (Size k = 0; k < grid_.size(); ++k) {
+                targetValues[k] = values[k][0];
+                for (Size j = 0; j < hedges.size(); ++j)
+                    hedgeValues[k][j] = values[k][j + 1];
+            }
+            return qrSolve(hedgeValues, targetValues);
+        }
+
+      private:
+        ext::shared_ptr<SimpleQuote> spot_;
+        std::vector<GridPoint> grid_;
+    };
+
+}
@@ -0,0 +1,249 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/errors.hpp>
+#include <ql/types.hpp>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef QLRISKS_DISABLE_AAD
+
+#    include <XAD/XAD.hpp>
+
+namespace QuantLib {
+
+    /* A finished recording, detached from the thread that recorded it so that its reverse
+     * sweep can run on another thread.
+     *
+     * An XAD tape records the operations of the thread it is active on.  A RecordedTape
+     * takes ownership of the tape once the recording is done, and deactivates it, so that
+     * the recording thread can activate a new tape for the next recording.  sweep() then
+     * activates the tape on the calling thread for the reverse sweep.
+     *
+     * The active variables of the recording must not be used afterwards on the recording
+     * thread, apart from being destroyed while no other tape is active there; recordTape()
+     * ensures that.
+     */
+    class RecordedTape {
+      public:
+        typedef Real::tape_type tape_type;
+        typedef tape_type::slot_type slot_type;
+
+        // takes the tape the inputs are registered on and the outputs were recorded on
+        RecordedTape(std::unique_ptr<tape_type> tape,
+                     const std::vector<Real>& inputs,
+                     std::vector<Real> outputs)
+        : tape_(std::move(tape)) {
+            QL_REQUIRE(tape_ != nullptr, "null tape given");
+            QL_REQUIRE(tape_->isActive(), "the recording tape is not active on this thread");
+            for (const auto& x : inputs)
+                inputs_.push_back(x.getSlot());
+            for (auto& y : outputs) {
+                tape_->registerOutput(y);
+                outputs_.push_back(y.getSlot());
+                values_.push_back(xad::value(y));
+            }
+            tape_->deactivate();
+        }
+
+        const std::vector<double>& values() const { return values_; }
+        Size inputs() const { return inputs_.size(); }
+        Size outputs() const { return outputs_.size(); }
+
+        /* Sweeps the recording on the calling thread, which must not have an active tape,
+         * and returns the adjoints of the inputs for the given output adjoints. */
+        std::vector<double> sweep(const std::vector<double>& outputAdjoints) {
+            QL_REQUIRE(outputAdjoints.size() == outputs_.size(),
+                       outputAdjoints.size() << " output adjoints given for " << outputs_.size()
+                                             << " outputs");
+            QL_REQUIRE(tape_type::getActive() == nullptr,
+                       "a tape is already active on the sweeping thread");
+            tape_->activate();
+            struct Deactivate {
+                tape_type* tape;
+                ~Deactivate() { tape->deactivate(); }
+            } guard{tape_.get()};
+
+            tape_->clearDerivatives();
+            for (Size k = 0; k < outputs_.size(); ++k)
+                tape_->derivative(outputs_[k]) = outputAdjoints[k];
+            tape_->computeAdjoints();
+            std::vector<double> adjoints;
+            adjoints.reserve(inputs_.size());
+            for (auto slot : inputs_)
+                adjoints.push_back(tape_->derivative(slot));
+            return adjoints;
+        }
+
+        /* Derivatives of the outputs along the given input directions (e.g. the shifts of
+         * stress scenarios), as an outputs() x directions.size() row-major matrix, swept on
+         * the calling thread like sweep().
+         *
+         * An XAD tape is swept in reverse only, so these are the output gradients, one
+         * sweep per output, multiplied by the directions.  For a price, that is one sweep
+         * for any number of directions instead of one bumped revaluation per direction.
+         */
+        std::vector<double> directionalDerivatives(
+            const std::vector<std::vector<double>>& directions) {
+            for (const auto& direction : directions)
+                QL_REQUIRE(direction.size() == inputs_.size(),
+                           "direction of size " << direction.size() << " given for "
+                                                << inputs_.size() << " inputs");
+            const Size d = directions.size();
+            std::vector<double> derivatives(outputs_.size() * d, 0.0);
+            std::vector<double> seeds(outputs_.size(), 0.0);
+            for (Size k = 0; k < outputs_.size(); ++k) {
+                seeds[k] = 1.0;
+                std::vector<double> gradient = sweep(seeds);
+                seeds[k] = 0.0;
+                for (Size j = 0; j < d; ++j)
+                    for (Size i = 0; i < gradient.size(); ++i)
+                        derivatives[k * d + j] += gradient[i] * directions[j][i];
+            }
+            return derivatives;
+        }
+
+      private:
+        std::unique_ptr<tape_type> tape_;
+        std::vector<slot_type> inputs_, outputs_;
+        std::vector<double> values_;
+    };
+
+    /* Deactivates the tape active on the calling thread, if any, for its lifetime and
+     * reactivates it afterwards, also on exceptions, so that recordings can be made with
+     * recordTape() from a thread that has a tape of its own.
+     */
+    class ActiveTapeSuspension {
+      public:
+        ActiveTapeSuspension() : tape_(Real::tape_type::getActive()) {
+            if (tape_ != nullptr)
+                tape_->deactivate();
+        }
+
+        ~ActiveTapeSuspension() {
+            if (tape_ != nullptr)
+                tape_->activate();
+        }
+
+        ActiveTapeSuspension(const ActiveTapeSuspension&) = delete;
+        ActiveTapeSuspension& operator=(const ActiveTapeSuspension&) = delete;
+
+      private:
+        Real::tape_type* tape_;
+    };
+
+    /* Records std::vector<Real> task(const std::vector<Real>& x) at the given inputs on a
+     * new tape, and detaches the recording.  The calling thread must not have an active
+     * tape; all active variables of the recording are destroyed before returning.
+     */
+    template <class Task>
+    RecordedTape recordTape(const Task& task, const std::vector<double>& inputs) {
+        typedef RecordedTape::tape_type tape_type;
+        QL_REQUIRE(tape_type::getActive() == nullptr,
+                   "a tape is already active on the recording thread");
+        std::unique_ptr<tape_type> tape(new tape_type());
+        std::vector<Real> x(inputs.begin(), inputs.end());
+        tape->registerInputs(x);
+        tape->newRecording();
+        std::vector<Real> y = task(x);
+        return RecordedTape(std::move(tape), x, std::move(y));
+    }
+
+    /* The sweeping stage of a record/sweep pipeline: recordings handed over with sweep()
+     * are swept in order by a pool of worker threads, while the recording thread goes on
+     * with the next recording.  The adjoints come back through a future, which also
+     * carries any exception of the sweep.  The destructor finishes the pending sweeps.
+     */
+    class AdjointPipeline {
+      public:
+        explicit AdjointPipeline(Size sweepers = 1) {
+            QL_REQUIRE(sweepers > 0, "at least one sweeping thread required");
+            for (Size i = 0; i < sweepers; ++i)
+                workers_.emplace_back([this]() { work(); });
+        }
+
+        ~AdjointPipeline() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            ready_.notify_all();
+            for (auto& w : workers_)
+                w.join();
+        }
+
+        AdjointPipeline(const AdjointPipeline&) = delete;
+        AdjointPipeline& operator=(const AdjointPipeline&) = delete;
+
+        // hands a recording over with the given output adjoints (all ones if empty)
+        std::future<std::vector<double>> sweep(RecordedTape recording,
+                                               std::vector<double> outputAdjoints = {}) {
+            if (outputAdjoints.empty())
+                outputAdjoints.assign(recording.outputs(), 1.0);
+            std::packaged_task<std::vector<double>()> task(
+                [recording = std::move(recording), outputAdjoints]() mutable {
+                    return recording.sweep(outputAdjoints);
+                });
+            auto result = task.get_future();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                queue_.push_back(std::move(task));
+            }
+            ready_.notify_one();
+            return result;
+        }
+
+      private:
+        void work() {
+            for (;;) {
+                std::packaged_task<std::vector<double>()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    ready_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+                    if (queue_.empty())
+                        return;
+                    task = std::move(queue_.front());
+                    queue_.pop_front();
+                }
+                // the recording, and its tape, are released on this thread
+                task();
+            }
+        }
+
+        std::mutex mutex_;
+        std::condition_variable ready_;
+        std::deque<std::packaged_task<std::vector<double>()>> queue_;
+        bool stopping_ = false;
+        std::vector<std::thread> workers_;
+    };
+
+}
+
+#endif
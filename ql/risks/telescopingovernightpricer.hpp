@@ -0,0 +1,150 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/cashflows/couponpricer.hpp>
+#include <ql/cashflows/overnightindexedcoupon.hpp>
+#include <ql/indexes/iborindex.hpp>
+#include <ql/risks/adjointnode.hpp>
+#include <ql/settings.hpp>
+#include <algorithm>
+
+namespace QuantLib {
+
+    /* Compounding pricer for overnight indexed coupons, recording the forecast part of
+     * the coupon as one node on the tape.
+     *
+     * Without lookback, lockout or observation shift, the forecast daily compounding
+     * factors telescope: the product of (1 + f_i dt_i) from value date d_k on is
+     * P(d_k) / P(d_n), with P the discount factors of the forecasting curve.  QuantLib's
+     * CompoundingOvernightIndexedCouponPricer uses the same identity; this pricer only
+     * records the ratio and its product with the past compounding as one node with its
+     * partials, which saves a few tape entries per coupon.  Past fixings are compounded
+     * as usual.  Coupons with lookback, lockout or observation shift, and coupons
+     * compounding their spread daily, are compounded day by day.
+     */
+    class TelescopingOvernightIndexedCouponPricer : public FloatingRateCouponPricer {
+      public:
+        void initialize(const FloatingRateCoupon& coupon) override {
+            coupon_ = dynamic_cast<const OvernightIndexedCoupon*>(&coupon);
+            QL_REQUIRE(coupon_ != nullptr, "overnight indexed coupon required");
+            index_ = ext::dynamic_pointer_cast<OvernightIndex>(coupon_->index());
+            QL_REQUIRE(index_ != nullptr, "overnight index required");
+            QL_REQUIRE(coupon_->averagingMethod() == RateAveraging::Compound,
+                       "compounded overnight coupon required");
+        }
+
+        Rate swapletRate() const override {
+            const std::vector<Date>& fixingDates = coupon_->fixingDates();
+            const std::vector<Date>& valueDates = coupon_->valueDates();
+            const std::vector<Time>& dt = coupon_->dt();
+            const Size n = dt.size();
+            const Date today = Settings::instance().evaluationDate();
+
+            const bool includeSpread = coupon_->includeSpread();
+            bool telescoping = !includeSpread && coupon_->lockoutDays() == 0 &&
+                               !coupon_->applyObservationShift() &&
+                               coupon_->fixingDays() == index_->fixingDays();
+            Real compound = 1.0;
+            Size i = 0;
+            if (telescoping) {
+                while (i < n && fixingDates[i] < today) {
+                    Rate fixing = index_->pastFixing(fixingDates[i]);
+                    QL_REQUIRE(fixing != Null<Real>(), "Missing " << index_->name()
+                                                                  << " fixing for "
+                                                                  << fixingDates[i]);
+                    compound *= 1.0 + fixing * dt[i];
+                    ++i;
+                }
+                if (i < n && fixingDates[i] == today) {
+                    // today's fixing is used if already published
+                    Rate fixing = index_->pastFixing(today);
+                    if (fixing != Null<Real>()) {
+                        compound *= 1.0 + fixing * dt[i];
+                        ++i;
+                    }
+                }
+                if (i < n)
+                    compound = forecastCompound(compound, valueDates[i], valueDates[n]);
+            } else {
+                Size lockout = coupon_->lockoutDays();
+                QL_REQUIRE(lockout < n, "lockout period longer than the coupon");
+                Spread dailySpread = includeSpread ? coupon_->spread() : Spread(0.0);
+                for (; i < n; ++i) {
+                    // fixings during the lockout period are the last one before it
+                    Size k = lockout > 0 ? std::min(i, n - lockout - 1) : i;
+                    compound *= 1.0 + (index_->fixing(fixingDates[k]) + dailySpread) * dt[i];
+                }
+            }
+
+            Time tau = index_->dayCounter().yearFraction(valueDates.front(), valueDates.back());
+            Rate rate = (compound - 1.0) / tau;
+            if (includeSpread)
+                return coupon_->gearing() * rate;
+            return coupon_->gearing() * rate + coupon_->spread();
+        }
+
+        Real swapletPrice() const override { QL_FAIL("swapletPrice not available"); }
+        Real capletPrice(Rate) const override { QL_FAIL("capletPrice not available"); }
+        Rate capletRate(Rate) const override { QL_FAIL("capletRate not available"); }
+        Real floorletPrice(Rate) const override { QL_FAIL("floorletPrice not available"); }
+        Rate floorletRate(Rate) const override { QL_FAIL("floorletRate not available"); }
+
+      private:
+        // past compounding times P(start) / P(end) on the forecasting curve
+        Real forecastCompound(const Real& past, const Date& start, const Date& end) const {
+            Handle<YieldTermStructure> curve = index_->forwardingTermStructure();
+            QL_REQUIRE(!curve.empty(),
+                       "null term structure set to this instance of " << index_->name());
+            DiscountFactor startDiscount = curve->discount(start);
+            DiscountFactor endDiscount = curve->discount(end);
+#ifndef QLRISKS_DISABLE_AAD
+            double c = xad::value(past), ps = xad::value(startDiscount),
+                   pe = xad::value(endDiscount);
+            double ratio = ps / pe;
+            return recordNode(c * ratio, {{past, ratio},
+                                          {startDiscount, c / pe},
+                                          {endDiscount, -c * ratio / pe}});
+#else
+            return past * startDiscount / endDiscount;
+#endif
+        }
+
+        const OvernightIndexedCoupon* coupon_ = nullptr;
+        ext::shared_ptr<OvernightIndex> index_;
+    };
+
+    // sets the pricer on the overnight indexed coupons of a leg
+    inline void setTelescopingCouponPricer(
+        const Leg& leg,
+        const ext::shared_ptr<TelescopingOvernightIndexedCouponPricer>& pricer =
+            ext::make_shared<TelescopingOvernightIndexedCouponPricer>()) {
+        for (const auto& cf : leg) {
+            auto coupon = ext::dynamic_pointer_cast<OvernightIndexedCoupon>(cf);
+            if (coupon != nullptr)
+                coupon->setPricer(pricer);
+        }
+    }
+
+}
@@ -0,0 +1,367 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+
+#pragma once
+
+#include <ql/errors.hpp>
+#include <ql/indexes/iborindex.hpp>
+#include <ql/instruments/vanillaswap.hpp>
+#include <ql/risks/vanillabook.hpp>
+#include <ql/time/schedule.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifndef _WIN32
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+namespace QuantLib {
+
+    enum class TradeKind : std::uint32_t { VanillaSwap = 1, EuropeanOption = 2 };
+
+    /* One trade of a trade file, in 48 bytes of plain values.  The records are read in
+     * place from the mapped file, without parsing or copying.
+     */
+    struct TradeRecord {
+        TradeKind kind;
+        std::int32_t type;                         // Swap::Type or Option::Type
+        std::int32_t start;                        // serial number of the effective date
+        std::int32_t end;                          // serial number of the maturity or expiry
+        std::uint32_t underlying;                  // index of the underlying of an option
+        std::uint16_t fixedMonths, floatingMonths; // coupon tenors of a swap
+        double nominal;
+        double rate; // fixed rate of a swap, or strike of an option
+        double spread;
+    };
+
+    static_assert(sizeof(TradeRecord) == 48 && std::is_standard_layout<TradeRecord>::value,
+                  "trade records must be 48 bytes of plain values");
+
+    namespace detail {
+
+        const std::uint64_t tradeFileMagic = 0x31454441525451ULL; // "QTRADE1"
+        const std::uint32_t tradeFileVersion = 1;
+
+        struct TradeFileHeader {
+            std::uint64_t magic;
+            std::uint32_t version;
+            std::uint32_t recordSize;
+            std::uint64_t trades;
+            std::uint64_t reserved;
+        };
+
+#ifndef QLRISKS_DISABLE_AAD
+        inline double tradeValue(const Real& x) { return xad::value(x); }
+#else
+        inline double tradeValue(double x) { return x; }
+#endif
+
+        inline std::uint16_t tenorMonths(const Period& tenor) {
+            QL_REQUIRE(tenor.units() == Months || tenor.units() == Years,
+                       "coupon tenor in months or years required, got " << tenor);
+            Integer months = tenor.units() == Years ? 12 * tenor.length() : tenor.length();
+            QL_REQUIRE(months > 0 && months <= 0xffff, "coupon tenor " << tenor << " out of range");
+            return static_cast<std::uint16_t>(months);
+        }
+
+        // read-only view of a file: mapped into memory where the platform allows it, and
+        // read into an aligned buffer on Windows
+        class MappedFile {
+          public:
+            explicit MappedFile(const std::string& path) {
+#ifndef _WIN32
+                int fd = ::open(path.c_str(), O_RDONLY);
+                QL_REQUIRE(fd >= 0, "cannot open trade file " << path);
+                struct stat status;
+                if (::fstat(fd, &status) != 0) {
+                    ::close(fd);
+                    QL_FAIL("cannot read the size of trade file " << path);
+                }
+                size_ = static_cast<std::size_t>(status.st_size);
+                void* data = size_ > 0 ? ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0) :
+                                         nullptr;
+                ::close(fd);
+                QL_REQUIRE(data != MAP_FAILED, "cannot map trade file " << path);
+                if (data != nullptr)
+                    ::madvise(data, size_, MADV_WILLNEED);
+                data_ = static_cast<const char*>(data);
+#else
+                std::ifstream in(path, std::ios::binary | std::ios::ate);
+                QL_REQUIRE(in, "cannot open trade file " << path);
+                size_ = static_cast<std::size_t>(in.tellg());
+                in.seekg(0);
+                buffer_.resize((size_ + sizeof(double) - 1) / sizeof(double));
+                in.read(reinterpret_cast<char*>(buffer_.data()),
+                        static_cast<std::streamsize>(size_));
+                QL_REQUIRE(in, "cannot read trade file " << path);
+                data_ = reinterpret_cast<const char*>(buffer_.data());
+#endif
+            }
+
+            ~MappedFile() {
+#ifndef _WIN32
+                if (data_ != nullptr)
+                    ::munmap(const_cast<char*>(data_), size_);
+#endif
+            }
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+
+            const char* data() const { return data_; }
+            std::size_t size() const { return size_; }
+
+          private:
+            const char* data_ = nullptr;
+            std::size_t size_ = 0;
+#ifdef _WIN32
+            std::vector<double> buffer_;
+#endif
+        };
+
+    }
+
+    inline TradeRecord vanillaSwapTrade(Swap::Type type,
+                                        Real nominal,
+                                        const Date& effective,
+                                        const Date& termination,
+                                        const Period& fixedTenor,
+                                        Rate fixedRate,
+                                        const Period& floatingTenor,
+                                        Spread spread = 0.0) {
+        TradeRecord trade = {};
+        trade.kind = TradeKind::VanillaSwap;
+        trade.type = static_cast<std::int32_t>(type);
+        trade.start = static_cast<std::int32_t>(effective.serialNumber());
+        trade.end = static_cast<std::int32_t>(termination.serialNumber());
+        trade.fixedMonths = detail::tenorMonths(fixedTenor);
+        trade.floatingMonths = detail::tenorMonths(floatingTenor);
+        trade.nominal = detail::tradeValue(nominal);
+        trade.rate = detail::tradeValue(fixedRate);
+        trade.spread = detail::tradeValue(spread);
+        return trade;
+    }
+
+    // the record of an existing swap, from the start and end dates of its schedules
+    inline TradeRecord vanillaSwapTrade(const VanillaSwap& swap) {
+        return vanillaSwapTrade(swap.type(), swap.nominal(), swap.fixedSchedule().startDate(),
+                                swap.fixedSchedule().endDate(), swap.fixedSchedule().tenor(),
+                                swap.fixedRate(), swap.floatingSchedule().tenor(), swap.spread());
+    }
+
+    inline TradeRecord
+    europeanOptionTrade(Option::Type type, Real strike, const Date& expiry, Size underlying = 0) {
+        QL_REQUIRE(underlying <= 0xffffffffU, "underlying index " << underlying << " out of range");
+        TradeRecord trade = {};
+        trade.kind = TradeKind::EuropeanOption;
+        trade.type = static_cast<std::int32_t>(type);
+        trade.end = static_cast<std::int32_t>(expiry.serialNumber());
+        trade.underlying = static_cast<std::uint32_t>(underlying);
+        trade.rate = detail::tradeValue(strike);
+        return trade;
+    }
+
+    /* Writes trades to a binary trade file: a 32-byte header followed by the records, in
+     * the byte order of the machine.  The file is written under a temporary name and
+     * renamed, so that a reader never maps a partial file.
+     */
+    inline void writeTradeFile(const std::string& path, const std::vector<TradeRecord>& trades) {
+        detail::TradeFileHeader header = {detail::tradeFileMagic, detail::tradeFileVersion,
+                                          static_cast<std::uint32_t>(sizeof(TradeRecord)),
+                                          static_cast<std::uint64_t>(trades.size()), 0};
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(trades.data()),
+                      static_cast<std::streamsize>(trades.size() * sizeof(TradeRecord)));
+            QL_REQUIRE(out, "failed to write trade file " << temporary);
+        }
+        if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+            // renaming over an existing file fails on some platforms
+            std::remove(path.c_str());
+            QL_REQUIRE(std::rename(temporary.c_str(), path.c_str()) == 0,
+                       "failed to write trade file " << path);
+        }
+    }
+
+    /* A binary trade file, mapped into memory and read in place: opening it costs one
+     * header check whatever the number of trades, and the records are paged in as they
+     * are read.  Files are only read on machines with the byte order they were written in.
+     */
+    class TradeFile {
+      public:
+        explicit TradeFile(const std::string& path) : file_(path) {
+            detail::TradeFileHeader header;
+            QL_REQUIRE(file_.size() >= sizeof(header), path << " is not a trade file");
+            std::memcpy(&header, file_.data(), sizeof(header));
+            QL_REQUIRE(header.magic == detail::tradeFileMagic,
+                       path << " is not a trade file, or was written with another byte order");
+            QL_REQUIRE(header.version == detail::tradeFileVersion,
+                       "unsupported version " << header.version << " of trade file " << path);
+            QL_REQUIRE(header.recordSize == sizeof(TradeRecord),
+                       "unexpected record size " << header.recordSize << " in trade file "
+                                                 << path);
+            std::uint64_t records = (file_.size() - sizeof(header)) / sizeof(TradeRecord);
+            QL_REQUIRE(header.trades == records &&
+                           (file_.size() - sizeof(header)) % sizeof(TradeRecord) == 0,
+                       "trade file " << path << " holds " << records << " trades instead of "
+                                     << header.trades);
+            trades_ = reinterpret_cast<const TradeRecord*>(file_.data() + sizeof(header));
+            size_ = static_cast<Size>(header.trades);
+        }
+
+        Size size() const { return size_; }
+        const TradeRecord& operator[](Size i) const { return trades_[i]; }
+        const TradeRecord* begin() const { return trades_; }
+        const TradeRecord* end() const { return trades_ + size_; }
+
+      private:
+        detail::MappedFile file_;
+        const TradeRecord* trades_ = nullptr;
+        Size size_ = 0;
+    };
+
+    /* Calls f(chunk, first, last) for the consecutive chunks [first, last) of chunkSize
+     * trades of a file, on the given number of threads, each taking the next chunk when
+     * done with the previous one.  The first exception thrown by f is rethrown once all
+     * threads have finished.
+     *
+     * With more than one thread, f may fill flat trade stores (e.g. one book per chunk)
+     * but not build instruments, which register with shared observables; these are built
+     * in risk sessions instead (see runRiskSessions).
+     */
+    template <class F>
+    void forEachTradeChunk(const TradeFile& file, Size chunkSize, Size threads, const F& f) {
+        QL_REQUIRE(chunkSize > 0, "positive chunk size required");
+        QL_REQUIRE(threads > 0, "at least one thread required");
+        const Size chunks = (file.size() + chunkSize - 1) / chunkSize;
+        auto run = [&](Size chunk) {
+            Size first = chunk * chunkSize, last = std::min(first + chunkSize, file.size());
+            f(chunk, file.begin() + first, file.begin() + last);
+        };
+        threads = std::min(threads, chunks);
+        if (threads <= 1) {
+            for (Size chunk = 0; chunk < chunks; ++chunk)
+                run(chunk);
+            return;
+        }
+
+        std::atomic<Size> next(0);
+        std::vector<std::thread> workers;
+        std::vector<std::exception_ptr> errors(threads);
+        for (Size t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t]() {
+                try {
+                    for (Size chunk = next++; chunk < chunks; chunk = next++)
+                        run(chunk);
+                } catch (...) {
+                    errors[t] = std::current_exception();
+                }
+            });
+        }
+        for (auto& w : workers)
+            w.join();
+        for (const auto& e : errors)
+            if (e)
+                std::rethrow_exception(e);
+    }
+
+    // conventions of the swaps of a trade file, which only stores their economics
+    struct SwapTradeConventions {
+        Calendar calendar;
+        BusinessDayConvention convention = ModifiedFollowing;
+        BusinessDayConvention terminationConvention = Following;
+        DateGeneration::Rule rule = DateGeneration::Backward;
+        DayCounter fixedDayCount, floatingDayCount;
+        ext::shared_ptr<IborIndex> index;
+    };
+
+    namespace detail {
+
+        inline void checkSwapTrade(const TradeRecord& trade,
+                                   const SwapTradeConventions& conventions) {
+            QL_REQUIRE(trade.kind == TradeKind::VanillaSwap, "vanilla swap trade required");
+            QL_REQUIRE(conventions.index != nullptr, "no index given for the swap trades");
+        }
+
+        inline Schedule swapTradeSchedule(const TradeRecord& trade,
+                                          std::uint16_t months,
+                                          const SwapTradeConventions& conventions) {
+            return Schedule(Date(static_cast<Date::serial_type>(trade.start)),
+                            Date(static_cast<Date::serial_type>(trade.end)),
+                            Period(months, Months), conventions.calendar, conventions.convention,
+                            conventions.terminationConvention, conventions.rule, false);
+        }
+
+    }
+
+    inline ext::shared_ptr<VanillaSwap> makeVanillaSwap(const TradeRecord& trade,
+                                                        const SwapTradeConventions& conventions) {
+        detail::checkSwapTrade(trade, conventions);
+        return ext::make_shared<VanillaSwap>(
+            static_cast<Swap::Type>(trade.type), trade.nominal,
+            detail::swapTradeSchedule(trade, trade.fixedMonths, conventions), trade.rate,
+            conventions.fixedDayCount,
+            detail::swapTradeSchedule(trade, trade.floatingMonths, conventions),
+            conventions.index, trade.spread, conventions.floatingDayCount);
+    }
+
+    // adds the swaps of [first, last) to a book from their schedules, without building them
+    inline void addTrades(VanillaSwapBook& book,
+                          const TradeRecord* first,
+                          const TradeRecord* last,
+                          const SwapTradeConventions& conventions) {
+        for (; first != last; ++first) {
+            detail::checkSwapTrade(*first, conventions);
+            book.add(static_cast<Swap::Type>(first->type), first->nominal,
+                     detail::swapTradeSchedule(*first, first->fixedMonths, conventions),
+                     first->rate, conventions.fixedDayCount,
+                     detail::swapTradeSchedule(*first, first->floatingMonths, conventions),
+                     conventions.index, first->spread, conventions.floatingDayCount);
+        }
+    }
+
+    inline void
+    addTrades(EuropeanOptionBook& book, const TradeRecord* first, const TradeRecord* last) {
+        for (; first != last; ++first) {
+            QL_REQUIRE(first->kind == TradeKind::EuropeanOption, "European option trade required");
+            book.add(static_cast<Option::Type>(first->type), first->rate,
+                     Date(static_cast<Date::serial_type>(first->end)), first->underlying);
+        }
+    }
+
+}
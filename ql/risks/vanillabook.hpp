@@ -0,0 +1,359 @@
+/*******************************************************************************
+
+   This file is part of QuantLib-Risks, an adaptor module to enable using XAD with
+   QuantLib. XAD is a fast and comprehensive C++ library for
+   automatic differentiation.
+
+   Copyright (C) 2010-2024 Xcelerit Computing Ltd.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+******************************************************************************/
+
+#pragma once
+
+#include <ql/cashflows/fixedratecoupon.hpp>
+#include <ql/cashflows/iborcoupon.hpp>
+#include <ql/cashflows/simplecashflow.hpp>
+#include <ql/exercise.hpp>
+#include <ql/instruments/payoffs.hpp>
+#include <ql/instruments/vanillaoption.hpp>
+#include <ql/instruments/vanillaswap.hpp>
+#include <ql/risks/normalnodes.hpp>
+#include <ql/settings.hpp>
+#include <ql/termstructures/volatility/equityfx/blackvoltermstructure.hpp>
+#include <ql/termstructures/yieldtermstructure.hpp>
+#include <ql/time/schedule.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace QuantLib {
+
+    namespace detail {
+
+        // distinct dates of a book, each priced once per valuation
+        class BookDates {
+          public:
+            std::uint32_t index(const Date& d) {
+                auto it = indices_.find(d);
+                if (it == indices_.end()) {
+                    it = indices_.emplace(d, static_cast<std::uint32_t>(dates_.size())).first;
+                    dates_.push_back(d);
+                }
+                return it->second;
+            }
+
+            std::vector<DiscountFactor> discounts(const YieldTermStructure& curve) const {
+                std::vector<DiscountFactor> result;
+                result.reserve(dates_.size());
+                for (const auto& d : dates_)
+                    result.push_back(curve.discount(d));
+                return result;
+            }
+
+            Size size() const { return dates_.size(); }
+
+          private:
+            std::vector<Date> dates_;
+            std::map<Date, std::uint32_t> indices_;
+        };
+
+    }
+
+    /* A book of fixed-vs-Ibor swaps stored as values: the swaps in contiguous arrays of
+     * nominals, rates and spreads, and their coupons in contiguous arrays of date indices
+     * and accrual periods, instead of one VanillaSwap with its legs, coupons, pricers and
+     * observers per trade.
+     *
+     * Swaps are added from VanillaSwap instruments, or from their terms without building
+     * the instruments, without the coupons paid by the evaluation date and with the coupons
+     * already fixed at their past fixings.  The NPVs
+     * look up each distinct date once on the curves, and agree with DiscountingSwapEngine
+     * on curves with the evaluation date as reference date.  They only read the book, so
+     * that ranges of trades may be valued on several threads with plain doubles.
+     */
+    class VanillaSwapBook {
+      public:
+        Size add(const VanillaSwap& swap) {
+            const Date today = Settings::instance().evaluationDate();
+            signs_.push_back(swap.type() == Swap::Payer ? 1.0 : -1.0);
+            nominals_.push_back(swap.nominal());
+            fixedRates_.push_back(swap.fixedRate());
+            spreads_.push_back(swap.spread());
+
+            for (const auto& cf : swap.fixedLeg()) {
+                if (cf->hasOccurred(today))
+                    continue;
+                auto coupon = ext::dynamic_pointer_cast<FixedRateCoupon>(cf);
+                QL_REQUIRE(coupon != nullptr, "fixed-rate coupon required");
+                fixed_.push_back({payments_.index(coupon->date()), plain(coupon->accrualPeriod())});
+            }
+            fixedEnd_.push_back(fixed_.size());
+
+            for (const auto& cf : swap.floatingLeg()) {
+                if (cf->hasOccurred(today))
+                    continue;
+                auto coupon = ext::dynamic_pointer_cast<IborCoupon>(cf);
+                QL_REQUIRE(coupon != nullptr, "Ibor coupon required");
+                QL_REQUIRE(!coupon->isInArrears(), "in-arrears coupons not supported");
+                floating_.push_back(floatingCoupon(*coupon->iborIndex(), coupon->date(),
+                                                   plain(coupon->accrualPeriod()),
+                                                   coupon->fixingDate(),
+                                                   coupon->accrualEndDate(), today));
+            }
+            floatingEnd_.push_back(floating_.size());
+            return signs_.size() - 1;
+        }
+
+        /* Adds a swap from the terms of a VanillaSwap, with the coupons its legs would
+         * have, but without building its legs, coupons and pricers.  Both legs pay on the
+         * schedule calendar with the convention of the floating schedule, and the Ibor
+         * coupons fix the index fixing days before their start, as in VanillaSwap.
+         */
+        Size add(Swap::Type type,
+                 Real nominal,
+                 const Schedule& fixedSchedule,
+                 Rate fixedRate,
+                 const DayCounter& fixedDayCount,
+                 const Schedule& floatingSchedule,
+                 const ext::shared_ptr<IborIndex>& index,
+                 Spread spread,
+                 const DayCounter& floatingDayCount) {
+            QL_REQUIRE(index != nullptr, "no index given");
+            const Date today = Settings::instance().evaluationDate();
+            const BusinessDayConvention paymentConvention =
+                floatingSchedule.businessDayConvention();
+            signs_.push_back(type == Swap::Payer ? 1.0 : -1.0);
+            nominals_.push_back(nominal);
+            fixedRates_.push_back(fixedRate);
+            spreads_.push_back(spread);
+
+            for (Size i = 1; i < fixedSchedule.size(); ++i) {
+                Date payment = fixedSchedule.calendar().adjust(fixedSchedule[i], paymentConvention);
+                if (hasOccurred(payment, today))
+                    continue;
+                Date refStart, refEnd;
+                referencePeriod(fixedSchedule, i, true, refStart, refEnd);
+                fixed_.push_back({payments_.index(payment),
+                                  plain(fixedDayCount.yearFraction(
+                                      fixedSchedule[i - 1], fixedSchedule[i], refStart, refEnd))});
+            }
+            fixedEnd_.push_back(fixed_.size());
+
+            for (Size i = 1; i < floatingSchedule.size(); ++i) {
+                Date start = floatingSchedule[i - 1], end = floatingSchedule[i];
+                Date payment = floatingSchedule.calendar().adjust(end, paymentConvention);
+                if (hasOccurred(payment, today))
+                    continue;
+                Date refStart, refEnd;
+                referencePeriod(floatingSchedule, i, false, refStart, refEnd);
+                Date fixingDate = index->fixingCalendar().advance(
+                    start, -static_cast<Integer>(index->fixingDays()), Days, Preceding);
+                floating_.push_back(floatingCoupon(
+                    *index, payment,
+                    plain(floatingDayCount.yearFraction(start, end, refStart, refEnd)),
+                    fixingDate, end, today));
+            }
+            floatingEnd_.push_back(floating_.size());
+            return signs_.size() - 1;
+        }
+
+        Size size() const { return signs_.size(); }
+
+        // NPV of each swap, with the coupons discounted and the Ibor rates forecast on curves
+        std::vector<Real> npvs(const YieldTermStructure& discounting,
+                               const YieldTermStructure& forecasting) const {
+            std::vector<DiscountFactor> discounts = payments_.discounts(discounting),
+                                        forecasts = fixings_.discounts(forecasting);
+            std::vector<Real> result(size());
+            Size fixed = 0, floating = 0;
+            for (Size k = 0; k < size(); ++k) {
+                Real annuity = 0.0;
+                for (; fixed < fixedEnd_[k]; ++fixed)
+                    annuity += fixed_[fixed].accrual * discounts[fixed_[fixed].payment];
+                Real floatingLeg = 0.0;
+                for (; floating < floatingEnd_[k]; ++floating) {
+                    const FloatingCoupon& c = floating_[floating];
+                    Rate rate = c.fixed ? c.fixing :
+                                          Rate((forecasts[c.start] / forecasts[c.end] - 1.0) /
+                                               c.spanning);
+                    floatingLeg += (rate + spreads_[k]) * c.accrual * discounts[c.payment];
+                }
+                result[k] = signs_[k] * nominals_[k] * (floatingLeg - fixedRates_[k] * annuity);
+            }
+            return result;
+        }
+
+        Real npv(const YieldTermStructure& discounting,
+                 const YieldTermStructure& forecasting) const {
+            Real total = 0.0;
+            for (const auto& x : npvs(discounting, forecasting))
+                total += x;
+            return total;
+        }
+
+      private:
+        struct FixedCoupon {
+            std::uint32_t payment;
+            double accrual;
+        };
+
+        struct FloatingCoupon {
+            std::uint32_t payment, start, end; // the forecast period on the index curve
+            double accrual, spanning;
+            bool fixed;
+            Rate fixing;
+        };
+
+#ifndef QLRISKS_DISABLE_AAD
+        static double plain(const Real& x) { return xad::value(x); }
+#else
+        static double plain(double x) { return x; }
+#endif
+
+        // as CashFlow::hasOccurred, only building a cash flow for payments on the given date
+        static bool hasOccurred(const Date& payment, const Date& today) {
+            if (payment != today)
+                return payment < today;
+            return SimpleCashFlow(0.0, payment).hasOccurred(today);
+        }
+
+        // reference period of the i-th coupon of a schedule built from a rule, as the fixed
+        // and Ibor legs set it for irregular first and last coupons
+        static void referencePeriod(
+            const Schedule& schedule, Size i, bool fixedLeg, Date& refStart, Date& refEnd) {
+            refStart = schedule[i - 1];
+            refEnd = schedule[i];
+            if (!schedule.hasTenor() || !schedule.hasIsRegular() || schedule.isRegular(i))
+                return;
+            const Size n = schedule.size() - 1;
+            const Calendar& calendar = schedule.calendar();
+            if (i == 1)
+                refStart = calendar.adjust(schedule[i] - schedule.tenor(),
+                                           schedule.businessDayConvention());
+            // a fixed leg of a single coupon only adjusts its start
+            if (i == n && (n > 1 || !fixedLeg))
+                refEnd = calendar.adjust(schedule[i - 1] + schedule.tenor(),
+                                         schedule.businessDayConvention());
+        }
+
+        // as IborCouponPricer, for par or indexed coupons
+        FloatingCoupon floatingCoupon(const IborIndex& index,
+                                      const Date& payment,
+                                      double accrual,
+                                      const Date& fixingDate,
+                                      const Date& accrualEnd,
+                                      const Date& today) {
+            FloatingCoupon c;
+            c.payment = payments_.index(payment);
+            c.accrual = accrual;
+            c.fixing = fixingDate <= today ? index.pastFixing(fixingDate) : Null<Rate>();
+            QL_REQUIRE(fixingDate >= today || c.fixing != Null<Rate>(),
+                       "Missing " << index.name() << " fixing for " << fixingDate);
+            c.fixed = c.fixing != Null<Rate>();
+
+            Date start = index.valueDate(fixingDate), end;
+            if (IborCoupon::Settings::instance().usingAtParCoupons()) {
+                Date nextFixingDate = index.fixingDate(accrualEnd);
+                end = index.fixingCalendar().advance(nextFixingDate,
+                                                     static_cast<Integer>(index.fixingDays()),
+                                                     Days);
+                end = std::max(end, start + 1);
+            } else {
+                end = index.maturityDate(start);
+            }
+            c.start = fixings_.index(start);
+            c.end = fixings_.index(end);
+            c.spanning = plain(index.dayCounter().yearFraction(start, end));
+            return c;
+        }
+
+        std::vector<double> signs_;
+        std::vector<Real> nominals_, fixedRates_, spreads_;
+        std::vector<Size> fixedEnd_, floatingEnd_;
+        std::vector<FixedCoupon> fixed_;
+        std::vector<FloatingCoupon> floating_;
+        detail::BookDates payments_, fixings_;
+    };
+
+    /* A book of European options on several underlyings stored as values: types, strikes,
+     * expiries and underlyings in contiguous arrays, instead of one VanillaOption with its
+     * payoff, exercise and engine per trade.  The NPVs look up the curves once per distinct
+     * expiry and agree with AnalyticEuropeanEngine.
+     */
+    class EuropeanOptionBook {
+      public:
+        Size add(Option::Type type, Real strike, const Date& expiry, Size underlying = 0) {
+            types_.push_back(type);
+            strikes_.push_back(strike);
+            expiryIds_.push_back(expiries_.index(expiry));
+            expiryDates_.push_back(expiry);
+            underlyings_.push_back(underlying);
+            return types_.size() - 1;
+        }
+
+        Size add(const VanillaOption& option, Size underlying = 0) {
+            auto payoff = ext::dynamic_pointer_cast<PlainVanillaPayoff>(option.payoff());
+            QL_REQUIRE(payoff != nullptr, "plain vanilla payoff required");
+            QL_REQUIRE(option.exercise()->type() == Exercise::European,
+                       "European exercise required");
+            return add(payoff->optionType(), payoff->strike(), option.exercise()->lastDate(),
+                       underlying);
+        }
+
+        Size size() const { return types_.size(); }
+
+        // NPV of each option, given the spots of the underlyings
+        std::vector<Real> npvs(const std::vector<Real>& spots,
+                               const YieldTermStructure& riskFree,
+                               const YieldTermStructure& dividend,
+                               const BlackVolTermStructure& volatility) const {
+            std::vector<DiscountFactor> discounts = expiries_.discounts(riskFree),
+                                        dividendDiscounts = expiries_.discounts(dividend);
+            std::vector<Real> result(size());
+            for (Size k = 0; k < size(); ++k) {
+                QL_REQUIRE(underlyings_[k] < spots.size(),
+                           "no spot given for underlying " << underlyings_[k]);
+                DiscountFactor df = discounts[expiryIds_[k]];
+                Real forward = spots[underlyings_[k]] * dividendDiscounts[expiryIds_[k]] / df;
+                Real variance = volatility.blackVariance(expiryDates_[k], strikes_[k]);
+                result[k] =
+                    blackFormulaNode(types_[k], strikes_[k], forward, std::sqrt(variance), df);
+            }
+            return result;
+        }
+
+        Real npv(const std::vector<Real>& spots,
+                 const YieldTermStructure& riskFree,
+                 const YieldTermStructure& dividend,
+                 const BlackVolTermStructure& volatility) const {
+            Real total = 0.0;
+            for (const auto& x : npvs(spots, riskFree, dividend, volatility))
+                total += x;
+            return total;
+        }
+
+      private:
+        std::vector<Option::Type> types_;
+        std::vector<Real> strikes_;
+        std::vector<std::uint32_t> expiryIds_;
+        std::vector<Date> expiryDates_;
+        std::vector<Size> underlyings_;
+        detail::BookDates expiries_;
+    };
+
+}
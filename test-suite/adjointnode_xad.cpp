@@ -0,0 +1,69 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/risks/adjointnode.hpp>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(AdjointNodeXadTests)
+
+BOOST_AUTO_TEST_CASE(testNodeAdjoints) {
+
+    BOOST_TEST_MESSAGE("Testing single-node recording with given partials...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    Real x = 2.0, y = 3.0, passive = 5.0;
+    tape.registerInput(x);
+    tape.registerInput(y);
+    tape.newRecording();
+
+    // f(x, y) = x^2 y, recorded as one node, then used in further taped operations
+    Real a = 2.0 * x;
+    Real f = recordNode(value(a) * value(a) * value(y) / 4.0,
+                        {{a, value(a) * value(y) / 2.0},
+                         {y, value(a) * value(a) / 4.0},
+                         {passive, 1.0}});
+    Real z = 3.0 * f + y;
+    tape.registerOutput(z);
+    derivative(z) = 1.0;
+    tape.computeAdjoints();
+
+    QL_CHECK_CLOSE(value(z), 39.0, 1e-12);
+    QL_CHECK_CLOSE(derivative(x), 36.0, 1e-12);
+    QL_CHECK_CLOSE(derivative(y), 13.0, 1e-12);
+
+    // a node without active inputs is passive
+    Real c = recordNode(1.0, std::vector<Real>(1, passive), std::vector<double>(1, 2.0));
+    BOOST_CHECK(!c.shouldRecord());
+    BOOST_CHECK_THROW(recordNode(1.0, std::vector<Real>(2), std::vector<double>(1)), Error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,181 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/exercise.hpp>
+#include <ql/instruments/vanillaoption.hpp>
+#include <ql/pricingengines/vanilla/analyticeuropeanengine.hpp>
+#include <ql/quotes/simplequote.hpp>
+#include <ql/risks/admode.hpp>
+#include <ql/termstructures/volatility/equityfx/blackconstantvol.hpp>
+#include <ql/termstructures/yield/flatforward.hpp>
+#include <ql/time/calendars/target.hpp>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(ADModeXadTests)
+
+namespace {
+
+    // inputs: spot, risk-free rate, dividend yield, volatility; outputs: call and put NPVs
+    std::vector<Real> priceCallAndPut(const std::vector<Real>& x) {
+        Date today(15, May, 1998);
+        Settings::instance().evaluationDate() = today;
+        DayCounter dc = Actual365Fixed();
+        auto exercise = ext::make_shared<EuropeanExercise>(Date(17, May, 1999));
+
+        Handle<Quote> spot(ext::make_shared<SimpleQuote>(x[0]));
+        Handle<YieldTermStructure> rTS(flatRate(today, x[1], dc));
+        Handle<YieldTermStructure> qTS(flatRate(today, x[2], dc));
+        Handle<BlackVolTermStructure> volTS(flatVol(today, x[3], dc));
+        auto engine = ext::make_shared<AnalyticEuropeanEngine>(
+            ext::make_shared<BlackScholesMertonProcess>(spot, qTS, rTS, volTS));
+
+        std::vector<Real> npvs;
+        for (auto type : {Option::Call, Option::Put}) {
+            VanillaOption option(ext::make_shared<PlainVanillaPayoff>(type, 100.0), exercise);
+            option.setPricingEngine(engine);
+            npvs.push_back(option.NPV());
+        }
+        return npvs;
+    }
+
+    std::vector<Real> priceCall(const std::vector<Real>& x) {
+        return {priceCallAndPut(x)[0]};
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testJacobianAgreesAcrossModes) {
+
+    BOOST_TEST_MESSAGE("Testing Jacobians in forward-difference and vector-reverse mode...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    std::vector<double> inputs = {95.0, 0.05, 0.02, 0.25};
+
+    std::vector<double> jacForward, jacReverse;
+    auto vForward = computeJacobian(priceCallAndPut, inputs, ADMode::ForwardDifference, jacForward);
+    auto vReverse = computeJacobian(priceCallAndPut, inputs, ADMode::VectorReverse, jacReverse);
+
+    BOOST_REQUIRE_EQUAL(vForward.size(), 2U);
+    BOOST_REQUIRE_EQUAL(jacForward.size(), jacReverse.size());
+    for (Size k = 0; k < vForward.size(); ++k)
+        QL_CHECK_CLOSE(vForward[k], vReverse[k], 1e-12);
+    for (Size i = 0; i < jacForward.size(); ++i)
+        QL_CHECK_CLOSE(jacForward[i], jacReverse[i], 1e-2);
+
+    // put-call parity: d(C - P)/dS = exp(-qT) for the spot column
+    Time T = Actual365Fixed().yearFraction(Date(15, May, 1998), Date(17, May, 1999));
+    QL_CHECK_CLOSE(jacReverse[0] - jacReverse[4], std::exp(-inputs[2] * value(T)), 1e-8);
+}
+
+BOOST_AUTO_TEST_CASE(testReverseModeRequiresScalarTask) {
+
+    BOOST_TEST_MESSAGE("Testing scalar reverse mode...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    std::vector<double> inputs = {95.0, 0.05, 0.02, 0.25};
+    std::vector<double> jacobian, jacobianBlock;
+    computeJacobian(priceCall, inputs, ADMode::Reverse, jacobian);
+    computeJacobian(priceCallAndPut, inputs, ADMode::VectorReverse, jacobianBlock);
+    for (Size i = 0; i < inputs.size(); ++i)
+        QL_CHECK_CLOSE(jacobian[i], jacobianBlock[i], 1e-12);
+
+    BOOST_CHECK_THROW(computeJacobian(priceCallAndPut, inputs, ADMode::Reverse, jacobian),
+                      Error);
+}
+
+BOOST_AUTO_TEST_CASE(testModeSelection) {
+
+    BOOST_TEST_MESSAGE("Testing AD mode selection from the tape cost model...");
+
+    TapeCostModel cost;
+    cost.plainTime = 1.0;
+    cost.recordingTime = 4.0;
+    cost.sweepTime = 2.0;
+    cost.tapeMemory = 1000;
+
+    // few inputs: bumping beats recording
+    BOOST_CHECK(selectADMode(2, 1, cost) == ADMode::ForwardDifference);
+    // many inputs, one output
+    BOOST_CHECK(selectADMode(55, 1, cost) == ADMode::Reverse);
+    // many inputs, a block of outputs
+    BOOST_CHECK(selectADMode(55, 10, cost) == ADMode::VectorReverse);
+    // many outputs, few inputs
+    BOOST_CHECK(selectADMode(5, 50, cost) == ADMode::ForwardDifference);
+    // recording does not fit the memory limit
+    BOOST_CHECK(selectADMode(55, 1, cost, 500) == ADMode::ForwardDifference);
+
+    // count-only heuristic
+    BOOST_CHECK(selectADMode(1, 1) == ADMode::ForwardDifference);
+    BOOST_CHECK(selectADMode(55, 1) == ADMode::Reverse);
+}
+
+BOOST_AUTO_TEST_CASE(testDifferentiateTaskMeasuresAndSelects) {
+
+    BOOST_TEST_MESSAGE("Testing automatic AD mode selection for a pricing task...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    std::vector<double> inputs = {95.0, 0.05, 0.02, 0.25};
+    auto measured = measureTapeCost(priceCallAndPut, inputs);
+    BOOST_CHECK(measured.plainTime > 0.0);
+    BOOST_CHECK(measured.recordingTime > 0.0);
+    BOOST_CHECK(measured.tapeMemory > 0);
+    BOOST_CHECK(measured.measured());
+
+    Size calls = 0;
+    auto task = [&](const std::vector<Real>& x) {
+        ++calls;
+        return priceCallAndPut(x);
+    };
+
+    std::vector<double> jacobian, expected;
+    computeJacobian(priceCallAndPut, inputs, ADMode::VectorReverse, expected);
+    TapeCostModel cost;
+    for (Size run = 0; run < 3; ++run) {
+        calls = 0;
+        ADMode mode;
+        auto values = differentiateTask(task, inputs, 2, jacobian, cost, &mode);
+        BOOST_CHECK(mode == ADMode::ForwardDifference || mode == ADMode::VectorReverse);
+        BOOST_REQUIRE_EQUAL(values.size(), 2U);
+        for (Size i = 0; i < expected.size(); ++i)
+            QL_CHECK_CLOSE(jacobian[i], expected[i], 1e-2);
+
+        // the model is measured on the first run only, and then updated by each run
+        Size computing = mode == ADMode::ForwardDifference ? inputs.size() + 1 : 1;
+        BOOST_CHECK_EQUAL(calls, run == 0 ? computing + 2 : computing);
+        BOOST_CHECK_EQUAL(cost.samples, run + 2);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
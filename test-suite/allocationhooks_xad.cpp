@@ -0,0 +1,100 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/risks/allocationhooks.hpp>
+#include <ql/risks/perfcounters.hpp>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// counts the allocations of the test suite, with QLRISKS_ENABLE_ALLOCATION_HOOKS
+QLRISKS_DEFINE_ALLOCATION_HOOKS
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(AllocationHooksXadTests)
+
+BOOST_AUTO_TEST_CASE(testAllocationSizeBuckets) {
+
+    BOOST_TEST_MESSAGE("Testing allocation size buckets...");
+
+    BOOST_CHECK_EQUAL(AllocationCounts::bucket(0), 0U);
+    BOOST_CHECK_EQUAL(AllocationCounts::bucket(16), 0U);
+    BOOST_CHECK_EQUAL(AllocationCounts::bucket(17), 1U);
+    BOOST_CHECK_EQUAL(AllocationCounts::bucket(800), 5U);
+    BOOST_CHECK_EQUAL(AllocationCounts::bucket(4096), 6U);
+    BOOST_CHECK_EQUAL(AllocationCounts::bucket(1 << 20), 7U);
+    BOOST_CHECK_EQUAL(std::string(AllocationCounts::bucketName(7)), ">4K");
+}
+
+BOOST_AUTO_TEST_CASE(testAllocationPhases) {
+
+    BOOST_TEST_MESSAGE("Testing allocation counts of profiled phases...");
+
+    const Size n = 10;
+    // kept until the end, so that the allocations are not optimised away
+    std::vector<std::shared_ptr<std::vector<double>>> kept(n);
+    PerfProfile profile;
+    {
+        PerfPhase phase("outer");
+        for (Size k = 0; k < n; ++k) {
+            PerfPhase inner("vectors");
+            kept[k] = std::make_shared<std::vector<double>>(100, 1.0);
+            kept[k]->resize(50);
+            kept[k]->shrink_to_fit();
+        }
+    }
+    BOOST_CHECK_EQUAL(kept.back()->size(), 50U);
+
+    if (!profile.countsAllocations()) {
+        BOOST_TEST_MESSAGE("  allocation hooks not installed, skipped");
+        BOOST_CHECK(!allocationHooksInstalled());
+        return;
+    }
+
+    BOOST_REQUIRE_EQUAL(profile.phases().size(), 2U);
+    const PerfProfile::Phase& vectors = profile.phases()[0];
+    const PerfProfile::Phase& outer = profile.phases()[1];
+    BOOST_CHECK_EQUAL(vectors.name, "vectors");
+    BOOST_CHECK_EQUAL(vectors.calls, n);
+    // a shared vector per call, whose buffer is reallocated once
+    BOOST_CHECK_GE(vectors.allocations.allocations, 3 * n);
+    BOOST_CHECK_GE(vectors.allocations.deallocations, n);
+    BOOST_CHECK_GE(vectors.allocations.bytes, n * 1200);
+    BOOST_CHECK_GE(vectors.allocations.sizes[AllocationCounts::bucket(800)], n);
+    // the enclosing phase counts at least the nested ones
+    BOOST_CHECK_GE(outer.allocations.allocations, vectors.allocations.allocations);
+
+    std::ostringstream report;
+    report << profile;
+    BOOST_CHECK(report.str().find("allocations") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
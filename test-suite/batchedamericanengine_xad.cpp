@@ -0,0 +1,181 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/instruments/vanillaoption.hpp>
+#include <ql/pricingengines/vanilla/baroneadesiwhaleyengine.hpp>
+#include <ql/quotes/simplequote.hpp>
+#include <ql/risks/batchedamericanengine.hpp>
+#include <ql/termstructures/volatility/equityfx/blackconstantvol.hpp>
+#include <ql/termstructures/yield/flatforward.hpp>
+#include <ql/time/daycounters/actual360.hpp>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(BatchedAmericanEngineXadTests)
+
+namespace {
+
+    struct AmericanOptionData {
+        Option::Type type;
+        Real strike;
+        Real s;       // spot
+        Rate q;       // dividend
+        Rate r;       // risk-free rate
+        Time t;       // time to maturity
+        Volatility v; // volatility
+    };
+
+    // calls and puts in and out of the money, with and without dividends
+    std::vector<AmericanOptionData> book() {
+        return {{Option::Call, 100.0, 90.0, 0.10, 0.10, 0.10, 0.15},
+                {Option::Call, 100.0, 110.0, 0.10, 0.10, 0.50, 0.35},
+                {Option::Call, 100.0, 100.0, 0.00, 0.08, 0.25, 0.30},
+                {Option::Call, 40.0, 42.0, 0.04, 0.02, 3.00, 0.20},
+                {Option::Put, 100.0, 90.0, 0.10, 0.10, 0.10, 0.15},
+                {Option::Put, 100.0, 100.0, 0.00, 0.08, 0.50, 0.25},
+                {Option::Put, 40.0, 36.0, 0.00, 0.06, 1.00, 0.20},
+                {Option::Put, 100.0, 120.0, 0.03, 0.05, 3.00, 0.35}};
+    }
+
+    struct MarketData {
+        ext::shared_ptr<PlainVanillaPayoff> payoff;
+        ext::shared_ptr<Exercise> exercise;
+        ext::shared_ptr<GeneralizedBlackScholesProcess> process;
+    };
+
+    MarketData marketData(const AmericanOptionData& value) {
+        Date today = Settings::instance().evaluationDate();
+        DayCounter dc = Actual360();
+        auto spot = ext::make_shared<SimpleQuote>(value.s);
+        auto qRate = ext::make_shared<SimpleQuote>(value.q);
+        auto rRate = ext::make_shared<SimpleQuote>(value.r);
+        auto vol = ext::make_shared<SimpleQuote>(value.v);
+        MarketData data;
+        data.payoff = ext::make_shared<PlainVanillaPayoff>(value.type, value.strike);
+        data.exercise =
+            ext::make_shared<AmericanExercise>(today, today + timeToDays(value.t));
+        data.process = ext::make_shared<BlackScholesMertonProcess>(
+            Handle<Quote>(spot), Handle<YieldTermStructure>(flatRate(today, qRate, dc)),
+            Handle<YieldTermStructure>(flatRate(today, rRate, dc)),
+            Handle<BlackVolTermStructure>(flatVol(today, vol, dc)));
+        return data;
+    }
+
+    Real engineValue(const AmericanOptionData& value) {
+        MarketData data = marketData(value);
+        VanillaOption option(data.payoff, data.exercise);
+        option.setPricingEngine(
+            ext::make_shared<BaroneAdesiWhaleyApproximationEngine>(data.process));
+        return option.NPV();
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testValuesAgainstEngine) {
+
+    BOOST_TEST_MESSAGE("Testing batched Barone-Adesi-Whaley values against the engine...");
+
+    AmericanOptionBatch batch;
+    for (const auto& option : book()) {
+        MarketData data = marketData(option);
+        batch.add(data.payoff, data.exercise, data.process);
+    }
+    BOOST_CHECK_EQUAL(batch.size(), book().size());
+    BOOST_CHECK(batch.european(2));
+    BOOST_CHECK(!batch.european(4));
+
+    std::vector<Real> values = batch.baroneAdesiWhaleyValues();
+    std::vector<Real> criticals = batch.criticalPrices();
+    for (Size i = 0; i < batch.size(); ++i) {
+        QL_CHECK_CLOSE(values[i], engineValue(book()[i]), 1e-8);
+        if (batch.european(i))
+            BOOST_CHECK(criticals[i] == Null<Real>());
+        else
+            BOOST_CHECK(batch.types()[i] == Option::Call ? criticals[i] > batch.strikes()[i] :
+                                                           criticals[i] < batch.strikes()[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testBookGreeksInOneSweep) {
+
+    BOOST_TEST_MESSAGE("Testing batched Barone-Adesi-Whaley greeks of a book in one sweep...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    // engine greeks, one recording per option
+    std::vector<AmericanOptionData> expected;
+    for (auto option : book()) {
+        tape.registerInput(option.q);
+        tape.registerInput(option.r);
+        tape.registerInput(option.s);
+        tape.registerInput(option.strike);
+        tape.registerInput(option.v);
+        tape.newRecording();
+        Real price = engineValue(option);
+        tape.registerOutput(price);
+        derivative(price) = 1.0;
+        tape.computeAdjoints();
+        expected.push_back({option.type, derivative(option.strike), derivative(option.s),
+                            derivative(option.q), derivative(option.r), option.t,
+                            derivative(option.v)});
+        tape.clearAll();
+    }
+
+    // all options recorded together, and one sweep seeded with all values
+    std::vector<AmericanOptionData> options = book();
+    for (auto& option : options) {
+        tape.registerInput(option.q);
+        tape.registerInput(option.r);
+        tape.registerInput(option.s);
+        tape.registerInput(option.strike);
+        tape.registerInput(option.v);
+    }
+    tape.newRecording();
+    AmericanOptionBatch batch;
+    for (const auto& option : options) {
+        MarketData data = marketData(option);
+        batch.add(data.payoff, data.exercise, data.process);
+    }
+    std::vector<Real> values = batch.baroneAdesiWhaleyValues();
+    tape.registerOutputs(values);
+    for (auto& v : values)
+        derivative(v) = 1.0;
+    tape.computeAdjoints();
+
+    for (Size i = 0; i < options.size(); ++i) {
+        QL_CHECK_CLOSE(derivative(options[i].q), expected[i].q, 1e-3);
+        QL_CHECK_CLOSE(derivative(options[i].r), expected[i].r, 1e-3);
+        QL_CHECK_CLOSE(derivative(options[i].s), expected[i].s, 1e-3);
+        QL_CHECK_CLOSE(derivative(options[i].strike), expected[i].strike, 1e-3);
+        QL_CHECK_CLOSE(derivative(options[i].v), expected[i].v, 1e-3);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,186 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/indexes/ibor/euribor.hpp>
+#include <ql/math/interpolations/loginterpolation.hpp>
+#include <ql/quotes/simplequote.hpp>
+#include <ql/risks/curvesnapshot.hpp>
+#include <ql/termstructures/yield/discountcurve.hpp>
+#include <ql/termstructures/yield/piecewiseyieldcurve.hpp>
+#include <ql/termstructures/yield/ratehelpers.hpp>
+#include <ql/time/calendars/target.hpp>
+#include <ql/time/daycounters/actual360.hpp>
+#include <ql/time/daycounters/actual365fixed.hpp>
+#include <ql/time/daycounters/thirty360.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(CurveSnapshotXadTests)
+
+namespace {
+
+    const std::string snapshotPath = "curvesnapshot_xad.snapshot";
+    const std::string conventions = "deposits+swaps;loglinear discount;act365";
+
+    typedef PiecewiseYieldCurve<Discount, LogLinear> BootstrappedCurve;
+
+    // 3M and 6M deposits, then swaps from 1 to 10 years
+    const std::vector<double> quotes = {0.0310, 0.0325, 0.0340, 0.0352, 0.0360,
+                                        0.0366, 0.0371, 0.0375, 0.0378, 0.0381,
+                                        0.0383, 0.0385};
+
+    ext::shared_ptr<BootstrappedCurve> bootstrap(const std::vector<Real>& q) {
+        Date today = Settings::instance().evaluationDate();
+        std::vector<ext::shared_ptr<RateHelper>> helpers;
+        for (Size i = 0; i < 2; ++i)
+            helpers.push_back(ext::make_shared<DepositRateHelper>(
+                Handle<Quote>(ext::make_shared<SimpleQuote>(q[i])), (3 * (i + 1)) * Months, 2,
+                TARGET(), ModifiedFollowing, false, Actual360()));
+        auto euribor6M = ext::make_shared<Euribor6M>();
+        for (Size i = 2; i < q.size(); ++i)
+            helpers.push_back(ext::make_shared<SwapRateHelper>(
+                Handle<Quote>(ext::make_shared<SimpleQuote>(q[i])), Integer(i - 1) * Years,
+                TARGET(), Annual, Unadjusted, Thirty360(Thirty360::BondBasis), euribor6M));
+        return ext::make_shared<BootstrappedCurve>(today, helpers, Actual365Fixed());
+    }
+
+    // discount factors off the pillars, which depend on several nodes
+    std::vector<Real> discounts(const YieldTermStructure& curve) {
+        Date today = Settings::instance().evaluationDate();
+        return {curve.discount(today + 100), curve.discount(today + 1000),
+                curve.discount(today + 3000)};
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testRestoredCurveSensitivities) {
+
+    BOOST_TEST_MESSAGE("Testing curves restored from snapshots against bootstrapping...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+    Settings::instance().evaluationDate() = Date(15, May, 2024);
+
+    // the snapshot of the morning, saved and loaded back
+    CurveSnapshot snapshot = takeCurveSnapshot(bootstrap, quotes, conventions);
+    BOOST_CHECK_EQUAL(snapshot.values.size(), quotes.size() + 1);
+    BOOST_CHECK_EQUAL(snapshot.key, curveSnapshotKey(quotes, Date(15, May, 2024), conventions));
+    saveCurveSnapshot(snapshotPath, snapshot);
+    CurveSnapshot loaded;
+    BOOST_REQUIRE(loadCurveSnapshot(snapshotPath, snapshot.key, loaded));
+    BOOST_CHECK_EQUAL(loaded.conventions, conventions);
+    BOOST_CHECK(loaded.dates == snapshot.dates);
+    BOOST_CHECK(loaded.values == snapshot.values);
+    BOOST_CHECK(loaded.jacobian == snapshot.jacobian);
+
+    // sensitivities of off-pillar discounts through bootstrapping and the restored curve
+    auto task = [&](const CurveSnapshot* restoreFrom) {
+        return [restoreFrom](const std::vector<Real>& q) {
+            if (restoreFrom == nullptr)
+                return discounts(*bootstrap(q));
+            return discounts(*restoreCurve<InterpolatedDiscountCurve<LogLinear>>(
+                *restoreFrom, q, Actual365Fixed()));
+        };
+    };
+    std::vector<double> expectedJacobian, actualJacobian;
+    auto expected = computeJacobian(task(nullptr), quotes, ADMode::VectorReverse,
+                                    expectedJacobian);
+    auto actual = computeJacobian(task(&loaded), quotes, ADMode::VectorReverse, actualJacobian);
+    for (Size k = 0; k < expected.size(); ++k)
+        QL_CHECK_CLOSE(actual[k], expected[k], 1e-12);
+    for (Size i = 0; i < expectedJacobian.size(); ++i)
+        BOOST_CHECK_SMALL(actualJacobian[i] - expectedJacobian[i], 1e-10);
+    tape.clearAll();
+
+    std::remove(snapshotPath.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(testStaleSnapshots) {
+
+    BOOST_TEST_MESSAGE("Testing that stale or damaged curve snapshots are not loaded...");
+
+    const std::vector<double> q = {0.0310, 0.0325};
+    const Date today(15, May, 2024);
+    CurveSnapshot snapshot;
+    snapshot.key = curveSnapshotKey(q, today, conventions);
+    snapshot.conventions = conventions;
+    snapshot.quotes = 2;
+    snapshot.dates = {Date(15, May, 2024), Date(15, May, 2025)};
+    snapshot.values = {1.0, 0.96};
+    snapshot.jacobian = {0.0, 0.0, -0.96, 0.0};
+    saveCurveSnapshot(snapshotPath, snapshot);
+
+    CurveSnapshot loaded;
+    BOOST_CHECK(loadCurveSnapshot(snapshotPath, snapshot.key, loaded));
+    // the same curve restored from its quotes
+    BOOST_CHECK_NO_THROW(restoreCurve<InterpolatedDiscountCurve<LogLinear>>(
+        loaded, std::vector<Real>(q.begin(), q.end()), Actual365Fixed()));
+    // another market snapshot
+    BOOST_CHECK(
+        !loadCurveSnapshot(snapshotPath, curveSnapshotKey({0.01, 0.02}, today, conventions),
+                           loaded));
+    // the same quotes on another date, or for a curve with other conventions
+    BOOST_CHECK(
+        !loadCurveSnapshot(snapshotPath, curveSnapshotKey(q, today + 1, conventions), loaded));
+    BOOST_CHECK(!loadCurveSnapshot(
+        snapshotPath, curveSnapshotKey(q, today, "deposits+swaps;linear zero;act365"), loaded));
+    // quotes not matching the snapshot
+    BOOST_CHECK_THROW(restoreCurve<InterpolatedDiscountCurve<LogLinear>>(
+                          loaded, std::vector<Real>{0.01, 0.02}, Actual365Fixed()),
+                      Error);
+    // a damaged file
+    {
+        std::fstream file(snapshotPath, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(48);
+        file.put('x');
+    }
+    BOOST_CHECK(!loadCurveSnapshot(snapshotPath, snapshot.key, loaded));
+    // a damaged header, with node or quote counts whose product overflows or exceeds the file
+    for (std::streamoff offset : {16, 24}) {
+        saveCurveSnapshot(snapshotPath, snapshot);
+        {
+            std::fstream file(snapshotPath, std::ios::binary | std::ios::in | std::ios::out);
+            file.seekp(offset);
+            const std::uint64_t count = 0x4000000000000001ULL;
+            file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        }
+        bool found = true;
+        BOOST_CHECK_NO_THROW(found = loadCurveSnapshot(snapshotPath, snapshot.key, loaded));
+        BOOST_CHECK(!found);
+    }
+    std::remove(snapshotPath.c_str());
+    BOOST_CHECK(!loadCurveSnapshot(snapshotPath, snapshot.key, loaded));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
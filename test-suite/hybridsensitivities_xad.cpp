@@ -0,0 +1,143 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/exercise.hpp>
+#include <ql/instruments/vanillaoption.hpp>
+#include <ql/pricingengines/blackformula.hpp>
+#include <ql/pricingengines/vanilla/analyticeuropeanengine.hpp>
+#include <ql/processes/blackscholesprocess.hpp>
+#include <ql/quotes/simplequote.hpp>
+#include <ql/risks/hybridsensitivities.hpp>
+#include <ql/time/daycounters/actual365fixed.hpp>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(HybridSensitivitiesXadTests)
+
+namespace {
+
+    // inputs: strike, forward, standard deviation, discount
+    Real priceCall(const std::vector<Real>& x) {
+        return blackFormula(Option::Call, x[0], x[1], x[2], x[3]);
+    }
+
+    const std::vector<double> inputs = {100.0, 104.0, 0.25, 0.95};
+
+    /* inputs: spot, rate, volatility.  The curves and volatility move with the evaluation
+     * date, and the expiry is fixed, so that the value depends on the evaluation date. */
+    Real priceOption(const std::vector<Real>& x) {
+        DayCounter dc = Actual365Fixed();
+        auto process = ext::make_shared<BlackScholesMertonProcess>(
+            Handle<Quote>(ext::make_shared<SimpleQuote>(x[0])),
+            Handle<YieldTermStructure>(flatRate(0.01, dc)),
+            Handle<YieldTermStructure>(flatRate(x[1], dc)),
+            Handle<BlackVolTermStructure>(flatVol(x[2], dc)));
+        VanillaOption option(ext::make_shared<PlainVanillaPayoff>(Option::Put, 100.0),
+                             ext::make_shared<EuropeanExercise>(Date(17, May, 2001)));
+        option.setPricingEngine(ext::make_shared<AnalyticEuropeanEngine>(process));
+        return option.NPV();
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testHybridAgreesWithAdjoint) {
+
+    BOOST_TEST_MESSAGE("Testing hybrid adjoint and bumped sensitivities...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    std::vector<double> adjoint, hybrid;
+    std::vector<SensitivityMethod> allAdjoint(inputs.size(), SensitivityMethod::Adjoint);
+    std::vector<SensitivityMethod> mixed = {SensitivityMethod::Bump, SensitivityMethod::Adjoint,
+                                            SensitivityMethod::Bump, SensitivityMethod::Adjoint};
+    double v1 = computeHybridGradient(priceCall, inputs, allAdjoint, adjoint);
+    double v2 = computeHybridGradient(priceCall, inputs, mixed, hybrid);
+
+    QL_CHECK_CLOSE(v1, v2, 1e-12);
+    BOOST_REQUIRE_EQUAL(hybrid.size(), inputs.size());
+    for (Size i = 0; i < inputs.size(); ++i) {
+        if (mixed[i] == SensitivityMethod::Adjoint)
+            QL_CHECK_CLOSE(hybrid[i], adjoint[i], 1e-12);
+        else
+            QL_CHECK_CLOSE(hybrid[i], adjoint[i], 1e-4);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testParallelBumps) {
+
+    BOOST_TEST_MESSAGE("Testing bumped sensitivities on several threads...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    std::vector<SensitivityMethod> allBump(inputs.size(), SensitivityMethod::Bump);
+    std::vector<double> serial, parallel;
+    double v1 = computeHybridGradient(priceCall, inputs, allBump, serial);
+    if (!sessionsEnabled()) {
+        // the bumped revaluations would share QuantLib's global state
+        BOOST_CHECK_THROW(computeHybridGradient(priceCall, inputs, allBump, parallel, 1e-5, 3),
+                          Error);
+    } else {
+        double v2 = computeHybridGradient(priceCall, inputs, allBump, parallel, 1e-5, 3);
+        QL_CHECK_CLOSE(v1, v2, 1e-12);
+        for (Size i = 0; i < inputs.size(); ++i)
+            QL_CHECK_CLOSE(serial[i], parallel[i], 1e-12);
+    }
+
+    std::vector<double> gradient;
+    BOOST_CHECK_THROW(computeHybridGradient(priceCall, inputs, {SensitivityMethod::Bump}, gradient),
+                      Error);
+}
+
+BOOST_AUTO_TEST_CASE(testParallelBumpsOnEvaluationDate) {
+
+    BOOST_TEST_MESSAGE("Testing bumped sensitivities of an instrument on several threads...");
+
+    if (!sessionsEnabled())
+        return;
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    // far from today, so that a bumped revaluation on today's date would be noticed
+    Settings::instance().evaluationDate() = Date(15, May, 1998);
+    std::vector<double> optionInputs = {95.0, 0.05, 0.25};
+    std::vector<SensitivityMethod> allAdjoint(optionInputs.size(), SensitivityMethod::Adjoint),
+        allBump(optionInputs.size(), SensitivityMethod::Bump);
+    std::vector<double> adjoint, parallel;
+    double v1 = computeHybridGradient(priceOption, optionInputs, allAdjoint, adjoint);
+    double v2 = computeHybridGradient(priceOption, optionInputs, allBump, parallel, 1e-5, 3);
+
+    QL_CHECK_CLOSE(v1, v2, 1e-12);
+    for (Size i = 0; i < optionInputs.size(); ++i)
+        QL_CHECK_CLOSE(parallel[i], adjoint[i], 1e-4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,140 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/indexes/ibor/euribor.hpp>
+#include <ql/math/optimization/levenbergmarquardt.hpp>
+#include <ql/models/shortrate/calibrationhelpers/swaptionhelper.hpp>
+#include <ql/pricingengines/swaption/jamshidianswaptionengine.hpp>
+#include <ql/quotes/simplequote.hpp>
+#include <ql/risks/jamshidianbasketengine.hpp>
+#include <ql/time/daycounters/actual365fixed.hpp>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(JamshidianBasketEngineXadTests)
+
+namespace {
+
+    // co-terminal 1x5 ... 5x1 swaption helpers on a flat curve
+    std::vector<ext::shared_ptr<BlackCalibrationHelper>>
+    coterminalHelpers(const Handle<YieldTermStructure>& curve, const std::vector<Real>& vols) {
+        auto index = ext::make_shared<Euribor6M>(curve);
+        std::vector<ext::shared_ptr<BlackCalibrationHelper>> helpers;
+        for (Size i = 0; i < vols.size(); ++i) {
+            auto vol = ext::make_shared<SimpleQuote>(vols[i]);
+            helpers.push_back(ext::make_shared<SwaptionHelper>(
+                Period(static_cast<Integer>(i + 1), Years),
+                Period(static_cast<Integer>(vols.size() - i), Years), Handle<Quote>(vol), index,
+                index->tenor(), index->dayCounter(), index->dayCounter(), curve));
+        }
+        return helpers;
+    }
+
+    // sum of the helper model values, and its derivatives to the rate, a and sigma
+    Real basketValue(bool basket, std::vector<double>& gradient) {
+        using tape_type = Real::tape_type;
+        tape_type tape;
+
+        std::vector<Real> x = {0.04, 0.05, 0.012};
+        tape.registerInputs(x);
+        tape.newRecording();
+
+        Date today = Settings::instance().evaluationDate();
+        Handle<YieldTermStructure> curve(flatRate(today, x[0], Actual365Fixed()));
+        auto model = ext::make_shared<HullWhite>(curve, x[1], x[2]);
+        auto helpers = coterminalHelpers(curve, {0.15, 0.14, 0.13, 0.12, 0.11});
+        auto shared = ext::make_shared<JamshidianBasket>(model);
+        for (const auto& h : helpers) {
+            if (basket)
+                h->setPricingEngine(ext::make_shared<JamshidianBasketSwaptionEngine>(shared));
+            else
+                h->setPricingEngine(ext::make_shared<JamshidianSwaptionEngine>(model));
+        }
+
+        Real total = 0.0;
+        for (const auto& h : helpers)
+            total += h->modelValue();
+        tape.registerOutput(total);
+        derivative(total) = 1.0;
+        tape.computeAdjoints();
+
+        gradient.clear();
+        for (const auto& xi : x)
+            gradient.push_back(derivative(xi));
+        return total;
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testBasketMatchesJamshidian) {
+
+    BOOST_TEST_MESSAGE("Testing Jamshidian basket engine against single engines...");
+
+    std::vector<double> expected, actual;
+    Real v1 = basketValue(false, expected);
+    Real v2 = basketValue(true, actual);
+
+    QL_CHECK_CLOSE(v2, v1, 1e-8);
+    for (Size i = 0; i < expected.size(); ++i)
+        QL_CHECK_CLOSE(actual[i], expected[i], 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(testBasketCalibration) {
+
+    BOOST_TEST_MESSAGE("Testing Hull-White calibration with the Jamshidian basket engine...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    Date today = Settings::instance().evaluationDate();
+    Handle<YieldTermStructure> curve(flatRate(today, 0.04, Actual365Fixed()));
+    std::vector<Real> vols = {0.15, 0.14, 0.13, 0.12, 0.11};
+
+    std::vector<Array> params;
+    for (bool basket : {false, true}) {
+        auto model = ext::make_shared<HullWhite>(curve);
+        auto helpers = coterminalHelpers(curve, vols);
+        auto shared = ext::make_shared<JamshidianBasket>(model);
+        for (const auto& h : helpers) {
+            if (basket)
+                h->setPricingEngine(ext::make_shared<JamshidianBasketSwaptionEngine>(shared));
+            else
+                h->setPricingEngine(ext::make_shared<JamshidianSwaptionEngine>(model));
+        }
+        std::vector<ext::shared_ptr<CalibrationHelper>> calibrationHelpers(helpers.begin(),
+                                                                           helpers.end());
+        LevenbergMarquardt om;
+        model->calibrate(calibrationHelpers, om, EndCriteria(400, 100, 1.0e-8, 1.0e-8, 1.0e-8));
+        params.push_back(model->params());
+    }
+
+    for (Size i = 0; i < params[0].size(); ++i)
+        QL_CHECK_CLOSE(params[1][i], params[0][i], 1e-4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
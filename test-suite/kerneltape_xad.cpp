@@ -0,0 +1,99 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/risks/kerneltape.hpp>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(KernelTapeXadTests)
+
+namespace {
+
+    // undiscounted Black call on spot, strike, volatility, maturity, floored at intrinsic
+    template <class R>
+    R blackCall(const R& s, const R& k, const R& v, const R& t) {
+        using std::erfc;
+        using std::log;
+        using std::max;
+        using std::sqrt;
+        R sd = v * sqrt(t);
+        R d1 = log(s / k) / sd + 0.5 * sd;
+        R d2 = d1 - sd;
+        R price = 0.5 * s * erfc(-d1 / M_SQRT2) - 0.5 * k * erfc(-d2 / M_SQRT2);
+        if (s > k)
+            return max(price, R(s - k));
+        return price;
+    }
+
+    void recordBlackCall(KernelTape& kernel, const std::vector<double>& x) {
+        TracedReal s = kernel.input(x[0]), k = kernel.input(x[1]), v = kernel.input(x[2]),
+                   t = kernel.input(x[3]);
+        kernel.output(blackCall(s, k, v, t));
+        kernel.deactivate();
+    }
+
+    const std::vector<double> recorded = {105.0, 100.0, 0.2, 1.5};
+
+}
+
+BOOST_AUTO_TEST_CASE(testKernelMatchesAdjoints) {
+
+    BOOST_TEST_MESSAGE("Testing kernel recordings against XAD adjoints...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    KernelTape kernel;
+    recordBlackCall(kernel, recorded);
+    BOOST_CHECK_EQUAL(kernel.numberOfInputs(), 4U);
+    BOOST_CHECK_EQUAL(kernel.numberOfOutputs(), 1U);
+
+    for (double spot : {101.0, 110.0, 150.0}) {
+        std::vector<Real> x = {spot, 98.0, 0.25, 2.0};
+        tape.registerInputs(x);
+        tape.newRecording();
+        Real y = blackCall(x[0], x[1], x[2], x[3]);
+        tape.registerOutput(y);
+        derivative(y) = 1.0;
+        tape.computeAdjoints();
+
+        double in[4] = {spot, 98.0, 0.25, 2.0}, out, gradient[4], seed = 1.0;
+        BOOST_REQUIRE(kernel.adjoint(in, &seed, &out, gradient));
+        QL_CHECK_CLOSE(out, value(y), 1e-12);
+        for (Size i = 0; i < 4; ++i)
+            QL_CHECK_CLOSE(gradient[i], derivative(x[i]), 1e-10);
+        tape.clearAll();
+    }
+
+    // below the strike, the recorded branch does not apply
+    double in[4] = {95.0, 98.0, 0.25, 2.0}, out;
+    BOOST_CHECK(!kernel.forward(in, &out));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,141 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/risks/linearisedtape.hpp>
+#include <cmath>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(LinearisedTapeXadTests)
+
+namespace {
+
+    // a book of discounted payoffs on a handful of rates and spreads
+    template <class R>
+    R bookValue(const std::vector<R>& x) {
+        using std::exp;
+        using std::log;
+        using std::sqrt;
+        R sum = 0.0;
+        for (Size i = 0; i < 500; ++i) {
+            const R& r = x[i % x.size()];
+            const R& s = x[(7 * i + 1) % x.size()];
+            sum += exp(-(r + s) * (0.1 * i)) * sqrt(r * r + 1.0) - log(1.0 + s) / (1.0 + i);
+        }
+        return sum;
+    }
+
+    std::vector<double> marketInputs() {
+        std::vector<double> x;
+        for (Size i = 0; i < 12; ++i)
+            x.push_back(0.01 + 0.002 * i);
+        return x;
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testSweepMatchesAdjoints) {
+
+    BOOST_TEST_MESSAGE("Testing linearised tape sweeps against XAD adjoints...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    std::vector<double> inputs = marketInputs();
+    std::vector<Real> x(inputs.begin(), inputs.end());
+    tape.registerInputs(x);
+    tape.newRecording();
+    Real y = bookValue(x);
+    tape.registerOutput(y);
+    derivative(y) = 1.0;
+    tape.computeAdjoints();
+
+    KernelTape kernel;
+    std::vector<TracedReal> traced;
+    for (double xi : inputs)
+        traced.push_back(kernel.input(xi));
+    kernel.output(bookValue(traced));
+    kernel.deactivate();
+
+    LinearisedTape linearised(kernel, inputs.data());
+    QL_CHECK_CLOSE(linearised.outputValues()[0], value(y), 1e-12);
+
+    double seed = 1.0;
+    std::vector<double> gradient(inputs.size()), work;
+    // repeated sweeps reuse the work buffer
+    for (Size sweep = 0; sweep < 2; ++sweep) {
+        linearised.computeAdjoints(&seed, gradient.data(), work);
+        for (Size i = 0; i < inputs.size(); ++i)
+            QL_CHECK_CLOSE(gradient[i], derivative(x[i]), 1e-10);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testTangentSweeps) {
+
+    BOOST_TEST_MESSAGE("Testing batched tangent sweeps of linearised tapes...");
+
+    std::vector<double> inputs = marketInputs();
+    const Size n = inputs.size(), d = 7;
+
+    KernelTape kernel;
+    std::vector<TracedReal> traced;
+    for (double xi : inputs)
+        traced.push_back(kernel.input(xi));
+    kernel.output(bookValue(traced));
+    kernel.output(exp(-traced[2] * traced[3]));
+    kernel.deactivate();
+
+    // the directions, side by side for each input
+    std::vector<double> directions(n * d);
+    for (Size i = 0; i < n; ++i)
+        for (Size j = 0; j < d; ++j)
+            directions[i * d + j] = std::sin(1.0 + i + 3.0 * j);
+
+    // the expected tangents from the gradients of the outputs
+    LinearisedTape plain(kernel, inputs.data());
+    std::vector<double> expected(2 * d, 0.0);
+    for (Size k = 0; k < 2; ++k) {
+        double seeds[] = {k == 0 ? 1.0 : 0.0, k == 1 ? 1.0 : 0.0};
+        std::vector<double> gradient(n);
+        plain.computeAdjoints(seeds, gradient.data());
+        for (Size j = 0; j < d; ++j)
+            for (Size i = 0; i < n; ++i)
+                expected[k * d + j] += gradient[i] * directions[i * d + j];
+    }
+
+    std::vector<double> tangents(2 * d), work;
+    // repeated sweeps reuse the work buffer
+    for (Size sweep = 0; sweep < 2; ++sweep) {
+        plain.computeTangents(directions.data(), d, tangents.data(), work);
+        for (Size k = 0; k < 2 * d; ++k)
+            QL_CHECK_CLOSE(tangents[k], expected[k], 1e-10);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
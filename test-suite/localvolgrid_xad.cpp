@@ -0,0 +1,175 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/exercise.hpp>
+#include <ql/instruments/vanillaoption.hpp>
+#include <ql/pricingengines/vanilla/analyticeuropeanengine.hpp>
+#include <ql/pricingengines/vanilla/fdblackscholesvanillaengine.hpp>
+#include <ql/processes/blackscholesprocess.hpp>
+#include <ql/quotes/simplequote.hpp>
+#include <ql/risks/localvolgrid.hpp>
+#include <ql/time/daycounters/actual365fixed.hpp>
+#include <cmath>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(LocalVolGridXadTests)
+
+namespace {
+
+    struct Surface {
+        Date today;
+        DayCounter dc = Actual365Fixed();
+        std::vector<Date> expiries;
+        std::vector<Real> strikes = {60.0, 75.0, 85.0, 95.0, 100.0, 105.0, 115.0, 130.0, 150.0};
+        Handle<Quote> spot{ext::make_shared<SimpleQuote>(100.0)};
+        Handle<YieldTermStructure> riskFree, dividend;
+
+        Surface() : today(Settings::instance().evaluationDate()) {
+            for (Integer months : {3, 6, 12, 18, 24})
+                expiries.push_back(today + months * Months);
+            riskFree = Handle<YieldTermStructure>(flatRate(today, 0.04, dc));
+            dividend = Handle<YieldTermStructure>(flatRate(today, 0.01, dc));
+        }
+
+        // implied volatilities with skew, smile and term structure
+        Matrix skewed() const {
+            Matrix vols(strikes.size(), expiries.size());
+            for (Size i = 0; i < strikes.size(); ++i) {
+                for (Size j = 0; j < expiries.size(); ++j) {
+                    double x = std::log(value(strikes[i]) / 100.0),
+                           t = value(dc.yearFraction(today, expiries[j]));
+                    vols[i][j] = 0.2 - 0.05 * x + 0.1 * x * x + 0.02 * t - 0.03 * x * t;
+                }
+            }
+            return vols;
+        }
+
+        ext::shared_ptr<LocalVolGrid> grid(const Matrix& vols) const {
+            return ext::make_shared<LocalVolGrid>(today, expiries, strikes, vols, spot, riskFree,
+                                                  dividend, dc);
+        }
+    };
+
+    // local volatilities between and outside of the grid nodes
+    Real queries(const LocalVolGrid& grid) {
+        Real sum = 0.0;
+        for (Time t : {0.1, 0.4, 0.8, 1.3, 2.5})
+            for (Real s : {50.0, 80.0, 98.0, 102.0, 120.0, 160.0})
+                sum += grid.localVol(t, s, true);
+        return sum;
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testVegaBuckets) {
+
+    BOOST_TEST_MESSAGE("Testing local volatility grid sensitivities to implied volatilities...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    Surface surface;
+    Matrix vols = surface.skewed();
+    for (Size i = 0; i < vols.rows(); ++i)
+        for (Size j = 0; j < vols.columns(); ++j)
+            tape.registerInput(vols[i][j]);
+    tape.newRecording();
+    Real y = queries(*surface.grid(vols));
+    tape.registerOutput(y);
+    derivative(y) = 1.0;
+    tape.computeAdjoints();
+
+    Matrix bumped = surface.skewed();
+    const double h = 1.0e-6;
+    for (Size i = 0; i < vols.rows(); ++i) {
+        for (Size j = 0; j < vols.columns(); ++j) {
+            Real v = bumped[i][j];
+            bumped[i][j] = v + h;
+            Real up = queries(*surface.grid(bumped));
+            bumped[i][j] = v - h;
+            Real down = queries(*surface.grid(bumped));
+            bumped[i][j] = v;
+            Real expected = (up - down) / (2.0 * h);
+            if (std::fabs(value(expected)) > 1.0e-8)
+                QL_CHECK_CLOSE(derivative(vols[i][j]), value(expected), 1e-3);
+            else
+                BOOST_CHECK_SMALL(derivative(vols[i][j]), 1e-6);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testFlatSurfacePricing) {
+
+    BOOST_TEST_MESSAGE("Testing local volatility grid pricing on a flat surface...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    Surface surface;
+    const Volatility sigma = 0.25;
+    Matrix vols(surface.strikes.size(), surface.expiries.size(), sigma);
+    for (Size i = 0; i < vols.rows(); ++i)
+        for (Size j = 0; j < vols.columns(); ++j)
+            tape.registerInput(vols[i][j]);
+    tape.newRecording();
+
+    auto grid = surface.grid(vols);
+    for (Size i = 0; i < vols.rows(); ++i)
+        for (Size j = 0; j < vols.columns(); ++j)
+            QL_CHECK_CLOSE(grid->localVols()[i][j], sigma, 1e-10);
+
+    Handle<BlackVolTermStructure> flat(flatVol(surface.today, sigma, surface.dc));
+    Handle<LocalVolTermStructure> localVol(grid);
+    auto process = ext::make_shared<GeneralizedBlackScholesProcess>(
+        surface.spot, surface.dividend, surface.riskFree, flat, localVol);
+    VanillaOption option(ext::make_shared<PlainVanillaPayoff>(Option::Put, 95.0),
+                         ext::make_shared<EuropeanExercise>(surface.today + 12 * Months));
+    option.setPricingEngine(ext::make_shared<FdBlackScholesVanillaEngine>(
+        process, 100, 200, 0, FdmSchemeDesc::Douglas(), true));
+    Real npv = option.NPV();
+    tape.registerOutput(npv);
+    derivative(npv) = 1.0;
+    tape.computeAdjoints();
+
+    // a parallel shift of the implied volatilities is the Black-Scholes vega
+    Real vega = 0.0;
+    for (Size i = 0; i < vols.rows(); ++i)
+        for (Size j = 0; j < vols.columns(); ++j)
+            vega += derivative(vols[i][j]);
+
+    auto bsProcess = ext::make_shared<GeneralizedBlackScholesProcess>(
+        surface.spot, surface.dividend, surface.riskFree, flat);
+    option.setPricingEngine(ext::make_shared<AnalyticEuropeanEngine>(bsProcess));
+    QL_CHECK_CLOSE(value(npv), value(option.NPV()), 0.1);
+    QL_CHECK_CLOSE(value(vega), value(option.vega()), 1.0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,147 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/math/distributions/normaldistribution.hpp>
+#include <ql/pricingengines/blackformula.hpp>
+#include <ql/risks/normalnodes.hpp>
+#include <cmath>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(NormalNodesXadTests)
+
+namespace {
+
+    // Black prices of a strip of options on one tape, with the adjoints of the inputs
+    // (strike, forward, stdDev, discount, displacement) and the tape memory
+    template <class Formula>
+    std::vector<double> blackStrip(Option::Type type,
+                                   double displacement,
+                                   const Formula& formula,
+                                   Size& memory) {
+        Real::tape_type tape;
+        std::vector<Real> x = {95.0, 100.0, 0.25, 0.97, displacement};
+        tape.registerInputs(x);
+        tape.newRecording();
+        Real total = 0.0;
+        for (Size k = 0; k < 100; ++k)
+            total += formula(type, x[0] + 0.5 * k, x[1], x[2], x[3], x[4]);
+        tape.registerOutput(total);
+        derivative(total) = 1.0;
+        tape.computeAdjoints();
+        memory = tape.getMemory();
+        std::vector<double> result = {value(total)};
+        for (auto& xi : x)
+            result.push_back(derivative(xi));
+        return result;
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testNormalDistributionNodes) {
+
+    BOOST_TEST_MESSAGE("Testing single-node normal distribution functions...");
+
+    Real::tape_type tape;
+    CumulativeNormalDistribution expected(0.1, 1.5);
+    CumulativeNormalNode N(0.1, 1.5);
+    InverseCumulativeNormalNode inverse(0.1, 1.5);
+    for (double x = -8.0; x <= 8.0; x += 0.25) {
+        Real y = x, yNode = x;
+        tape.registerInput(y);
+        tape.registerInput(yNode);
+        tape.newRecording();
+        Real p = expected(y), pNode = N(yNode);
+        tape.registerOutput(p);
+        tape.registerOutput(pNode);
+        derivative(p) = 1.0;
+        derivative(pNode) = 1.0;
+        tape.computeAdjoints();
+        QL_CHECK_CLOSE(value(pNode), value(p), 1e-10);
+        QL_CHECK_CLOSE(derivative(yNode), derivative(y), 1e-10);
+        tape.clearAll();
+
+        // the inverse recovers x, with the reciprocal of the density as derivative
+        if (value(pNode) <= 0.0 || value(pNode) >= 1.0)
+            continue;
+        Real q = value(pNode);
+        tape.registerInput(q);
+        tape.newRecording();
+        Real z = inverse(q);
+        tape.registerOutput(z);
+        derivative(z) = 1.0;
+        tape.computeAdjoints();
+        QL_CHECK_SMALL(value(z) - x, 1e-6);
+        QL_CHECK_CLOSE(derivative(q), 1.0 / N.derivative(value(z)), 1e-6);
+        tape.clearAll();
+    }
+
+    BOOST_CHECK_THROW(inverse(Real(1.0)), Error);
+    BOOST_CHECK_THROW(CumulativeNormalNode(0.0, 0.0), Error);
+}
+
+BOOST_AUTO_TEST_CASE(testBlackFormulaNode) {
+
+    BOOST_TEST_MESSAGE("Testing single-node Black formula prices and greeks...");
+
+    auto taped = [](Option::Type type, const Real& strike, const Real& forward,
+                    const Real& stdDev, const Real& discount, const Real& displacement) {
+        return blackFormula(type, strike, forward, stdDev, discount, displacement);
+    };
+    auto node = [](Option::Type type, const Real& strike, const Real& forward,
+                   const Real& stdDev, const Real& discount, const Real& displacement) {
+        return blackFormulaNode(type, strike, forward, stdDev, discount, displacement);
+    };
+
+    for (Option::Type type : {Option::Call, Option::Put}) {
+        for (double displacement : {0.0, 10.0}) {
+            Size tapedMemory, nodeMemory;
+            std::vector<double> expected = blackStrip(type, displacement, taped, tapedMemory);
+            std::vector<double> actual = blackStrip(type, displacement, node, nodeMemory);
+            // value, and the strike, forward, vega, discount and displacement sensitivities
+            for (Size k = 0; k < expected.size(); ++k)
+                QL_CHECK_CLOSE(actual[k], expected[k], 1e-9);
+            BOOST_CHECK_LT(nodeMemory, tapedMemory);
+        }
+    }
+
+    // intrinsic values without volatility
+    BlackPartials p = blackFormulaPartials(Option::Put, 110.0, 100.0, 0.0, 0.9);
+    QL_CHECK_CLOSE(p.value, 9.0, 1e-12);
+    QL_CHECK_CLOSE(p.forward, -0.9, 1e-12);
+    QL_CHECK_CLOSE(p.strike, 0.9, 1e-12);
+    QL_CHECK_CLOSE(p.discount, 10.0, 1e-12);
+    BOOST_CHECK_EQUAL(p.stdDev, 0.0);
+
+    BOOST_CHECK_THROW(blackFormulaPartials(Option::Call, 100.0, -1.0, 0.2), Error);
+    BOOST_CHECK_THROW(blackFormulaPartials(Option::Call, 100.0, 100.0, -0.2), Error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,116 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/risks/perfcounters.hpp>
+#include <ql/risks/riskengine.hpp>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(PerfCountersXadTests)
+
+namespace {
+
+    const PerfProfile::Phase* findPhase(const PerfProfile& profile, const std::string& name) {
+        for (const auto& p : profile.phases())
+            if (p.name == name)
+                return &p;
+        return nullptr;
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testRiskEnginePhases) {
+
+    BOOST_TEST_MESSAGE("Testing hardware event counts of nested risk phases...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    std::vector<Real> x = {0.01, 0.02, 0.03, 0.04};
+    RiskEngine engine(tape);
+    engine.addFactors("x", x);
+    engine.addPricer([&]() {
+        Real y = 0.0;
+        for (Size i = 0; i < 1000; ++i)
+            y += std::exp(-x[i % x.size()] * Real(i));
+        return y;
+    });
+
+    // without a profile, the phases are not counted
+    {
+        PerfPhase phase("risk");
+        engine.calculate();
+    }
+
+    PerfProfile profile;
+    const Size runs = 3;
+    {
+        PerfPhase phase("risk");
+        for (Size k = 0; k < runs; ++k) {
+            {
+                PerfPhase recording("recording");
+                engine.record();
+            }
+            PerfPhase adjoints("adjoints");
+            engine.sweep();
+        }
+    }
+
+    if (!profile.available()) {
+        BOOST_TEST_MESSAGE("  no hardware counters available, skipped");
+        BOOST_CHECK(profile.phases().empty());
+        return;
+    }
+
+    const PerfProfile::Phase* risk = findPhase(profile, "risk");
+    const PerfProfile::Phase* recording = findPhase(profile, "recording");
+    const PerfProfile::Phase* adjoints = findPhase(profile, "adjoints");
+    BOOST_REQUIRE(risk != nullptr && recording != nullptr && adjoints != nullptr);
+    BOOST_CHECK_EQUAL(risk->calls, 1U);
+    BOOST_CHECK_EQUAL(recording->calls, runs);
+    BOOST_CHECK_EQUAL(adjoints->calls, runs);
+
+    // the enclosing phase counts at least the nested ones
+    for (Size e = 0; e < PerfCounts::NumberOfEvents; ++e) {
+        std::int64_t outer = risk->counts.counts[e], inner = recording->counts.counts[e],
+                     sweeps = adjoints->counts.counts[e];
+        if (outer < 0)
+            continue;
+        BOOST_CHECK(inner >= 0 && sweeps >= 0);
+        BOOST_CHECK(outer >= inner + sweeps);
+    }
+    if (recording->counts[PerfCounts::Instructions] >= 0)
+        BOOST_CHECK(recording->counts[PerfCounts::Instructions] > 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,108 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/exercise.hpp>
+#include <ql/instruments/vanillaoption.hpp>
+#include <ql/pricingengines/vanilla/analyticeuropeanengine.hpp>
+#include <ql/quotes/simplequote.hpp>
+#include <ql/risks/pnlexplain.hpp>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(PnLExplainXadTests)
+
+namespace {
+
+    // risk factors: spot, risk-free rate, volatility
+    Real priceCall(const std::vector<Real>& x) {
+        Date today(15, May, 1998);
+        Settings::instance().evaluationDate() = today;
+        DayCounter dc = Actual365Fixed();
+
+        Handle<Quote> spot(ext::make_shared<SimpleQuote>(x[0]));
+        Handle<YieldTermStructure> rTS(flatRate(today, x[1], dc));
+        Handle<YieldTermStructure> qTS(flatRate(today, 0.0, dc));
+        Handle<BlackVolTermStructure> volTS(flatVol(today, x[2], dc));
+        VanillaOption option(ext::make_shared<PlainVanillaPayoff>(Option::Call, 100.0),
+                             ext::make_shared<EuropeanExercise>(Date(17, May, 1999)));
+        option.setPricingEngine(ext::make_shared<AnalyticEuropeanEngine>(
+            ext::make_shared<BlackScholesMertonProcess>(spot, qTS, rTS, volTS)));
+        return option.NPV();
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testExplainWithGamma) {
+
+    BOOST_TEST_MESSAGE("Testing P&L explain from first and second-order AAD risk...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    std::vector<double> start = {100.0, 0.05, 0.20};
+    std::vector<double> end = {103.0, 0.051, 0.21};
+
+    auto firstOrder = explainPnL(priceCall, start, end, false);
+    auto secondOrder = explainPnL(priceCall, start, end, true);
+
+    // both revalue the snapshots fully
+    QL_CHECK_CLOSE(firstOrder.startValue, secondOrder.startValue, 1e-12);
+    QL_CHECK_CLOSE(firstOrder.endValue, secondOrder.endValue, 1e-12);
+    BOOST_CHECK(firstOrder.secondOrder.empty());
+    BOOST_REQUIRE_EQUAL(secondOrder.secondOrder.size(), start.size());
+
+    // the attribution adds up to the actual P&L
+    QL_CHECK_CLOSE(secondOrder.explained() + secondOrder.unexplained(), secondOrder.actual(),
+                   1e-10);
+
+    // first-order terms match the gradient at the start snapshot
+    std::vector<Real> x(start.begin(), start.end());
+    Real base = priceCall(x);
+    x[0] += 1e-4;
+    Real delta = (priceCall(x) - base) / 1e-4;
+    QL_CHECK_CLOSE(secondOrder.firstOrder[0], delta * 3.0, 1e-2);
+
+    // gamma captures most of what the first-order explain misses
+    BOOST_CHECK(std::fabs(secondOrder.unexplained()) <
+                0.1 * std::fabs(firstOrder.unexplained()));
+    BOOST_CHECK(std::fabs(secondOrder.unexplained()) < 1e-3 * std::fabs(secondOrder.actual()));
+}
+
+BOOST_AUTO_TEST_CASE(testExplainRequiresMatchingSnapshots) {
+
+    BOOST_TEST_MESSAGE("Testing P&L explain with mismatched snapshots...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    std::vector<double> start = {100.0, 0.05, 0.20};
+    std::vector<double> end = {103.0, 0.051};
+    BOOST_CHECK_THROW(explainPnL(priceCall, start, end), Error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
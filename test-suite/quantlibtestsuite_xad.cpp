@@ -30,3 +30,7 @@
 #if !defined(BOOST_ALL_NO_LIB) && defined(BOOST_MSVC)
 #    include <ql/auto_link.hpp>
 #endif
+#include <ql/risks/risksession.hpp>
+
+// per-thread sessions, with QuantLib built with QL_ENABLE_SESSIONS
+QLRISKS_DEFINE_SESSION_ID
@@ -0,0 +1,175 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/indexes/ibor/euribor.hpp>
+#include <ql/math/interpolations/loginterpolation.hpp>
+#include <ql/quotes/simplequote.hpp>
+#include <ql/risks/recycledtape.hpp>
+#include <ql/termstructures/yield/piecewiseyieldcurve.hpp>
+#include <ql/termstructures/yield/ratehelpers.hpp>
+#include <ql/time/calendars/target.hpp>
+#include <ql/time/daycounters/actual360.hpp>
+#include <ql/time/daycounters/actual365fixed.hpp>
+#include <ql/time/daycounters/thirty360.hpp>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(RecycledTapeXadTests)
+
+namespace {
+
+    // 3M and 6M deposits, then swaps from 1 to 5 years
+    ext::shared_ptr<YieldTermStructure> bootstrap(const std::vector<Real>& quotes) {
+        Date today = Settings::instance().evaluationDate();
+        std::vector<ext::shared_ptr<RateHelper>> helpers;
+        for (Size i = 0; i < 2; ++i)
+            helpers.push_back(ext::make_shared<DepositRateHelper>(
+                Handle<Quote>(ext::make_shared<SimpleQuote>(quotes[i])), (3 * (i + 1)) * Months,
+                2, TARGET(), ModifiedFollowing, false, Actual360()));
+        auto euribor6M = ext::make_shared<Euribor6M>();
+        for (Size i = 2; i < quotes.size(); ++i)
+            helpers.push_back(ext::make_shared<SwapRateHelper>(
+                Handle<Quote>(ext::make_shared<SimpleQuote>(quotes[i])), Integer(i - 1) * Years,
+                TARGET(), Annual, Unadjusted, Thirty360(Thirty360::BondBasis), euribor6M));
+        return ext::make_shared<PiecewiseYieldCurve<Discount, LogLinear>>(today, helpers,
+                                                                          Actual365Fixed());
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testRecyclingAcrossRecordings) {
+
+    BOOST_TEST_MESSAGE("Testing recycled tape slots across recordings...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    std::vector<Real> quotes = {0.01, 0.02, 0.03};
+    Real cached = 0.0;
+    auto recycled = ext::make_shared<RecycledTape>(tape);
+    recycled->addInputs(quotes);
+    recycled->addVariable(cached);
+    BOOST_CHECK_EQUAL(recycled->numberOfInputs(), 3U);
+
+    Flag flag;
+    flag.registerWith(recycled);
+
+    std::size_t memory = 0;
+    for (Size run = 0; run < 50; ++run) {
+        flag.lower();
+        recycled->newRecording();
+        BOOST_CHECK(flag.isUp());
+        // the value cached by the first run is passive in the later ones
+        if (run == 0)
+            cached = quotes[0] * quotes[1];
+        else
+            BOOST_CHECK(!cached.shouldRecord());
+
+        Real y = 0.0;
+        for (auto& q : quotes)
+            y += q * q * (1.0 + cached);
+        tape.registerOutput(y);
+        derivative(y) = 1.0;
+        tape.computeAdjoints();
+
+        double c = value(quotes[0]) * value(quotes[1]);
+        for (Size i = 0; i < quotes.size(); ++i) {
+            double expected = 2.0 * value(quotes[i]) * (1.0 + c);
+            if (run == 0 && i < 2) {
+                double other = value(quotes[1 - i]);
+                expected += other * (0.01 * 0.01 + 0.02 * 0.02 + 0.03 * 0.03);
+            }
+            QL_CHECK_CLOSE(derivative(quotes[i]), expected, 1e-10);
+        }
+
+        // the tape does not grow over the runs
+        if (run == 0)
+            memory = tape.getMemory();
+        else
+            BOOST_CHECK_LE(tape.getMemory(), memory);
+    }
+    BOOST_CHECK_EQUAL(recycled->recyclings(), 50U);
+
+    recycled->remove(quotes[0]);
+    BOOST_CHECK_EQUAL(recycled->numberOfInputs(), 0U);
+    BOOST_CHECK(!quotes[0].shouldRecord());
+    BOOST_CHECK_EQUAL(value(quotes[2]), 0.03);
+}
+
+BOOST_AUTO_TEST_CASE(testCurveRebuiltInEachRecording) {
+
+    BOOST_TEST_MESSAGE("Testing a bootstrapped curve rebuilt in recycled recordings...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+    Settings::instance().evaluationDate() = Date(15, May, 2024);
+
+    std::vector<Real> quotes = {0.0310, 0.0325, 0.0340, 0.0352, 0.0360, 0.0366, 0.0371};
+    RecycledTape recycled(tape);
+    recycled.addInputs(quotes);
+
+    // the same quotes give the same sensitivities in every recording
+    std::vector<double> expected;
+    std::size_t memory = 0;
+    for (Size run = 0; run < 10; ++run) {
+        recycled.newRecording();
+        Real discount = bootstrap(quotes)->discount(4.5);
+        tape.registerOutput(discount);
+        derivative(discount) = 1.0;
+        tape.computeAdjoints();
+
+        for (Size i = 0; i < quotes.size(); ++i) {
+            if (run == 0)
+                expected.push_back(derivative(quotes[i]));
+            else
+                BOOST_CHECK_EQUAL(derivative(quotes[i]), expected[i]);
+        }
+        if (run == 0)
+            memory = tape.getMemory();
+        else
+            BOOST_CHECK_LE(tape.getMemory(), memory);
+    }
+    BOOST_CHECK(expected[quotes.size() - 1] < 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(testTrackingErrors) {
+
+    BOOST_TEST_MESSAGE("Testing errors of recycled tapes...");
+
+    Real::tape_type tape;
+    RecycledTape recycled;
+    std::vector<Real> quotes(4, 0.01);
+    recycled.addInputs(quotes);
+    BOOST_CHECK_THROW(recycled.addInput(quotes[2]), Error);
+    Real other = 1.0;
+    BOOST_CHECK_THROW(recycled.remove(other), Error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,145 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/exercise.hpp>
+#include <ql/instruments/vanillaoption.hpp>
+#include <ql/pricingengines/vanilla/analyticeuropeanengine.hpp>
+#include <ql/quotes/simplequote.hpp>
+#include <ql/risks/riskengine.hpp>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(RiskEngineXadTests)
+
+namespace {
+
+    Real priceOption(Option::Type type, Real spot, const std::vector<Real>& rates, Real vol) {
+        Date today(15, May, 1998);
+        Settings::instance().evaluationDate() = today;
+        DayCounter dc = Actual365Fixed();
+
+        Handle<Quote> spotH(ext::make_shared<SimpleQuote>(spot));
+        Handle<YieldTermStructure> rTS(flatRate(today, rates[0], dc));
+        Handle<YieldTermStructure> qTS(flatRate(today, rates[1], dc));
+        Handle<BlackVolTermStructure> volTS(flatVol(today, vol, dc));
+        VanillaOption option(ext::make_shared<PlainVanillaPayoff>(type, 100.0),
+                             ext::make_shared<EuropeanExercise>(Date(17, May, 1999)));
+        option.setPricingEngine(ext::make_shared<AnalyticEuropeanEngine>(
+            ext::make_shared<BlackScholesMertonProcess>(spotH, qTS, rTS, volTS)));
+        return option.NPV();
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testBatchOfPricers) {
+
+    BOOST_TEST_MESSAGE("Testing risk engine with a batch of pricers...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    Real spot = 95.0, vol = 0.25;
+    std::vector<Real> rates = {0.05, 0.02};
+
+    RiskEngine engine;
+    engine.addFactor("spot", spot);
+    engine.addFactors("rates", rates);
+    engine.addFactor("vol", vol);
+    engine.addPricer([&]() { return priceOption(Option::Call, spot, rates, vol); });
+    engine.addPricer([&]() { return priceOption(Option::Put, spot, rates, vol); });
+    BOOST_CHECK_EQUAL(engine.numberOfFactors(), 4U);
+    BOOST_CHECK_EQUAL(engine.numberOfOutputs(), 2U);
+
+    const std::vector<double>& values = engine.calculate();
+    BOOST_REQUIRE_EQUAL(values.size(), 2U);
+
+    // put-call parity: C - P = S exp(-qT) - K exp(-rT)
+    Time T = Actual365Fixed().yearFraction(Date(15, May, 1998), Date(17, May, 1999));
+    double dq = std::exp(-value(rates[1]) * value(T));
+    double dr = std::exp(-value(rates[0]) * value(T));
+    QL_CHECK_CLOSE(values[0] - values[1], 95.0 * dq - 100.0 * dr, 1e-10);
+    QL_CHECK_CLOSE(engine.sensitivities("spot", 0)[0] - engine.sensitivities("spot", 1)[0], dq,
+                   1e-10);
+    QL_CHECK_CLOSE(engine.sensitivities("rates", 0)[0] - engine.sensitivities("rates", 1)[0],
+                   100.0 * value(T) * dr, 1e-10);
+    QL_CHECK_CLOSE(engine.sensitivities("vol", 0)[0], engine.sensitivities("vol", 1)[0], 1e-10);
+
+    // the whole gradient holds the blocks in registration order
+    SensitivityView all = engine.sensitivities(1);
+    BOOST_REQUIRE_EQUAL(all.size(), 4U);
+    BOOST_CHECK_EQUAL(all[1], engine.sensitivities("rates", 1)[0]);
+    BOOST_CHECK_EQUAL(all[3], engine.sensitivities("vol", 1)[0]);
+
+    BOOST_CHECK_THROW(engine.sensitivities("dividend"), Error);
+    BOOST_CHECK_THROW(engine.sensitivities(2), Error);
+}
+
+BOOST_AUTO_TEST_CASE(testRepeatedCalculation) {
+
+    BOOST_TEST_MESSAGE("Testing repeated risk engine calculations...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    Real spot = 95.0, vol = 0.25;
+    std::vector<Real> rates = {0.05, 0.02};
+
+    RiskEngine engine;
+    engine.addFactor("spot", spot);
+    engine.addFactors("rates", rates);
+    engine.addFactor("vol", vol);
+    engine.addPricer([&]() { return priceOption(Option::Call, spot, rates, vol); });
+
+    double v1 = engine.calculate()[0];
+    std::vector<double> g1(engine.sensitivities().begin(), engine.sensitivities().end());
+    const double* buffer = engine.sensitivities().data();
+
+    // the factors keep their values, and the buffers are reused
+    for (int i = 0; i < 3; ++i) {
+        QL_CHECK_CLOSE(engine.calculate()[0], v1, 1e-12);
+        BOOST_CHECK(engine.sensitivities().data() == buffer);
+        for (Size j = 0; j < g1.size(); ++j)
+            QL_CHECK_CLOSE(engine.sensitivities()[j], g1[j], 1e-12);
+    }
+
+    // the two steps of a calculation, one at a time; each recording is swept once
+    BOOST_CHECK_THROW(engine.sweep(), Error);
+    QL_CHECK_CLOSE(engine.record()[0], v1, 1e-12);
+    BOOST_CHECK_THROW(engine.sensitivities(), Error);
+    engine.sweep();
+    BOOST_CHECK(engine.sensitivities().data() == buffer);
+    for (Size j = 0; j < g1.size(); ++j)
+        QL_CHECK_CLOSE(engine.sensitivities()[j], g1[j], 1e-12);
+
+    // changes to the factors are picked up by the next calculation
+    value(spot) = 96.0;
+    BOOST_CHECK(engine.calculate()[0] > v1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,153 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/risks/riskjournal.hpp>
+#include <ql/utilities/null.hpp>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(RiskJournalXadTests)
+
+namespace {
+
+    const std::string journalPath = "riskjournal_xad.journal";
+
+    // trade t of shard k has NPV 10k + t and gradient (k, t)
+    struct CountingTask {
+        Size* calls;
+        Size failing = Null<Size>(); // a shard on which the job dies
+        RiskShard operator()(Size k) const {
+            QL_REQUIRE(k != failing, "job killed in shard " << k);
+            ++*calls;
+            RiskShard shard;
+            for (Size t = 0; t < 3; ++t) {
+                shard.npvs.push_back(10.0 * k + t);
+                shard.gradients.push_back(static_cast<double>(k));
+                shard.gradients.push_back(static_cast<double>(t));
+            }
+            return shard;
+        }
+    };
+
+    RiskJobLayout layout(Size shards, Size shardSize = 3, std::uint64_t portfolio = 42) {
+        RiskJobLayout result;
+        result.shards = shards;
+        result.shardSize = shardSize;
+        result.portfolioHash = portfolio;
+        return result;
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testRestartSkipsCompletedShards) {
+
+    BOOST_TEST_MESSAGE("Testing restart of a risk job from its journal...");
+
+    std::vector<double> snapshot = {0.01, 0.02, 0.03};
+    Size calls = 0;
+    CountingTask task = {&calls};
+
+    // a job that dies after two shards
+    {
+        RiskJournal journal(journalPath, hashSnapshot(snapshot), layout(5));
+        CountingTask dying = {&calls, 2};
+        BOOST_CHECK_THROW(runShards(journal, dying), Error);
+    }
+    // a torn record at the end of the file, as left by a crash while writing
+    {
+        std::ofstream out(journalPath, std::ios::binary | std::ios::app);
+        out << "torn";
+    }
+
+    RiskJournal journal(journalPath, hashSnapshot(snapshot), layout(5));
+    BOOST_CHECK_EQUAL(journal.completedShards(), 2U);
+    auto shards = runShards(journal, task);
+    BOOST_CHECK_EQUAL(calls, 5U);
+    BOOST_REQUIRE_EQUAL(shards.size(), 5U);
+    for (Size k = 0; k < shards.size(); ++k) {
+        BOOST_REQUIRE_EQUAL(shards[k].npvs.size(), 3U);
+        BOOST_CHECK_EQUAL(shards[k].npvs[2], 10.0 * k + 2);
+        BOOST_CHECK_EQUAL(shards[k].gradients[4], static_cast<double>(k));
+    }
+
+    // all shards are now in the journal
+    RiskJournal completed(journalPath, hashSnapshot(snapshot), layout(5));
+    BOOST_CHECK_EQUAL(completed.completedShards(), 5U);
+    runShards(completed, task);
+    BOOST_CHECK_EQUAL(calls, 5U);
+    completed.remove();
+}
+
+BOOST_AUTO_TEST_CASE(testJournalForOtherSnapshotIsDiscarded) {
+
+    BOOST_TEST_MESSAGE("Testing risk journal written for another market snapshot...");
+
+    Size calls = 0;
+    CountingTask task = {&calls};
+    {
+        RiskJournal journal(journalPath, hashSnapshot({0.01, 0.02, 0.03}), layout(2));
+        runShards(journal, task);
+    }
+
+    RiskJournal journal(journalPath, hashSnapshot({0.01, 0.02, 0.0301}), layout(2));
+    BOOST_CHECK_EQUAL(journal.completedShards(), 0U);
+    BOOST_CHECK_THROW(journal.shard(0), Error);
+    runShards(journal, task);
+    BOOST_CHECK_EQUAL(calls, 4U);
+    journal.remove();
+}
+
+BOOST_AUTO_TEST_CASE(testJournalForOtherJobLayoutIsDiscarded) {
+
+    BOOST_TEST_MESSAGE("Testing risk journal written for another job layout...");
+
+    std::vector<double> snapshot = {0.01, 0.02, 0.03};
+    Size calls = 0;
+    CountingTask task = {&calls};
+    {
+        RiskJournal journal(journalPath, hashSnapshot(snapshot), layout(2));
+        runShards(journal, task);
+    }
+
+    // same snapshot, but other shard counts, shard sizes or trades
+    for (const auto& other : {layout(3), layout(2, 4), layout(2, 3, 43)}) {
+        RiskJournal journal(journalPath, hashSnapshot(snapshot), other);
+        BOOST_CHECK_EQUAL(journal.completedShards(), 0U);
+    }
+
+    RiskJournal journal(journalPath, hashSnapshot(snapshot), layout(2, 3, 43));
+    BOOST_CHECK_THROW(journal.record(2, RiskShard()), Error);
+    journal.remove();
+
+    // the portfolio hash depends on the terms of the trades
+    BOOST_CHECK(hashPortfolio({1.0e6, 0.02}) != hashPortfolio({1.0e6, 0.021}));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,233 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/risks/riskscheduler.hpp>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(RiskSchedulerXadTests)
+
+namespace {
+
+    SessionContext context() {
+        SessionContext context;
+        context.evaluationDate = Date(1, July, 2024);
+        return context;
+    }
+
+    // a book of cheap swaps with a few expensive Bermudans, sized in time steps
+    std::vector<RiskTask> book() {
+        std::vector<RiskTask> tasks;
+        for (Size i = 0; i < 40; ++i) {
+            tasks.push_back({"swap", 1.0});
+            if (i % 10 == 0)
+                tasks.push_back({"bermudan", 10.0 + i});
+        }
+        return tasks;
+    }
+
+    // prices a task by sleeping for its cost, and records a small tape
+    struct Pricer {
+        const std::vector<RiskTask>& tasks;
+        std::vector<std::atomic<int>>& runs;
+
+        void operator()(Size i, RiskSession& session) const {
+            double millis = (tasks[i].kind == "swap" ? 0.2 : 1.0) * tasks[i].size;
+            std::this_thread::sleep_for(std::chrono::microseconds(Size(1000 * millis)));
+            Real x = 1.0;
+            session.tape().registerInput(x);
+            Real y = x;
+            for (Size k = 0; k < 100 * tasks[i].size; ++k)
+                y = y * 1.001;
+            ++runs[i];
+        }
+    };
+
+}
+
+BOOST_AUTO_TEST_CASE(testCostModel) {
+
+    BOOST_TEST_MESSAGE("Testing the learnt costs of risk tasks...");
+
+    TaskCostModel costs(0.5);
+    BOOST_CHECK(!costs.known("swap"));
+    BOOST_CHECK_EQUAL(costs.seconds({"swap", 2.0}), 2.0);
+
+    costs.observe({"swap", 2.0}, 0.002, 2000);
+    costs.observe({"bermudan", 100.0}, 1.0, 100000);
+    BOOST_CHECK(costs.known("swap"));
+    QL_CHECK_CLOSE(costs.seconds({"swap", 1.0}), 0.001, 1e-10);
+    QL_CHECK_CLOSE(costs.memory({"bermudan", 50.0}), 50000.0, 1e-10);
+
+    // moving averages of the seconds per unit
+    costs.observe({"swap", 1.0}, 0.003, 1000);
+    QL_CHECK_CLOSE(costs.seconds({"swap", 1.0}), 0.002, 1e-10);
+    QL_CHECK_CLOSE(costs.memory({"swap", 1.0}), 1000.0, 1e-10);
+
+    // unknown kinds are estimated at the highest known cost
+    QL_CHECK_CLOSE(costs.seconds({"american", 10.0}), 0.1, 1e-10);
+
+    BOOST_CHECK_THROW(TaskCostModel(0.0), Error);
+    BOOST_CHECK_THROW(costs.observe({"swap", 0.0}, 1.0, 0), Error);
+}
+
+BOOST_AUTO_TEST_CASE(testScheduledRiskSessions) {
+
+    BOOST_TEST_MESSAGE("Testing cost-driven scheduling of heterogeneous risk tasks...");
+
+    std::vector<RiskTask> tasks = book();
+    std::vector<std::atomic<int>> runs(tasks.size());
+    for (auto& r : runs)
+        r = 0;
+    Pricer pricer = {tasks, runs};
+
+    // the first run learns the costs
+    TaskCostModel costs;
+    runScheduledRiskSessions(context(), tasks, 1, costs, pricer);
+    BOOST_CHECK(costs.known("swap"));
+    BOOST_CHECK(costs.known("bermudan"));
+    BOOST_CHECK_GT(costs.seconds({"bermudan", 1.0}), costs.seconds({"swap", 1.0}));
+    BOOST_CHECK_GT(costs.memory({"bermudan", 10.0}), 0.0);
+
+    Size threads = sessionsEnabled() ? 4 : 1;
+    // the later ones are balanced with them, also when only one task fits in memory
+    runScheduledRiskSessions(context(), tasks, threads, costs, pricer);
+    runScheduledRiskSessions(context(), tasks, threads, costs, pricer, 1);
+    for (Size i = 0; i < tasks.size(); ++i)
+        BOOST_CHECK_EQUAL(runs[i].load(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(testSchedulingOrderAndSteals) {
+
+    BOOST_TEST_MESSAGE("Testing the order and work stealing of scheduled risk tasks...");
+
+    // fixed costs, so that the estimates are 0.01, 0.06, 0.02, 0.04 and 0.03 seconds
+    TaskCostModel costs(1.0);
+    costs.observe({"swap", 1.0}, 0.001, 1000);
+    costs.observe({"bermudan", 1.0}, 0.01, 10000);
+    std::vector<RiskTask> tasks = {
+        {"swap", 10.0}, {"bermudan", 6.0}, {"swap", 20.0}, {"bermudan", 4.0}, {"swap", 30.0}};
+    std::vector<double> estimates;
+    for (const auto& task : tasks)
+        estimates.push_back(costs.seconds(task));
+
+    // a single thread runs the tasks longest first
+    std::vector<Size> order;
+    runScheduledRiskSessions(context(), tasks, 1, costs,
+                             [&](Size i, RiskSession&) { order.push_back(i); });
+    std::vector<Size> expected = {1, 3, 4, 2, 0};
+    BOOST_CHECK_EQUAL_COLLECTIONS(order.begin(), order.end(), expected.begin(), expected.end());
+
+    // two threads are dealt 1, 2 and 3, 4, 0, each longest first
+    detail::WorkStealingQueues queues(2);
+    detail::dealTasks(estimates, queues, 2);
+    Size task;
+    BOOST_CHECK(queues.pop(0, task));
+    BOOST_CHECK_EQUAL(task, 1U);
+    BOOST_CHECK(queues.pop(0, task));
+    BOOST_CHECK_EQUAL(task, 2U);
+    BOOST_CHECK(!queues.pop(0, task));
+    // the idle thread steals the longest pending task of the other one
+    BOOST_CHECK(queues.steal(0, task));
+    BOOST_CHECK_EQUAL(task, 3U);
+    BOOST_CHECK_EQUAL(queues.steals(), 1U);
+    BOOST_CHECK(queues.pop(1, task));
+    BOOST_CHECK_EQUAL(task, 4U);
+    BOOST_CHECK(queues.pop(1, task));
+    BOOST_CHECK_EQUAL(task, 0U);
+    BOOST_CHECK(!queues.steal(1, task));
+    BOOST_CHECK_EQUAL(queues.steals(), 1U);
+
+    // the victim is the thread with the most pending work, not the longest task
+    detail::WorkStealingQueues three(3);
+    three.push(0, 0, 2.0);
+    three.push(1, 1, 1.5);
+    three.push(1, 2, 1.5);
+    BOOST_CHECK(three.steal(2, task));
+    BOOST_CHECK_EQUAL(task, 1U);
+}
+
+BOOST_AUTO_TEST_CASE(testCallerTapeUntouched) {
+
+    BOOST_TEST_MESSAGE("Testing that scheduled risk sessions leave the caller's tape alone...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+    Real x = 3.0;
+    tape.registerInput(x);
+    tape.newRecording();
+    Real y = x * x;
+
+    // a single thread runs the tasks on the calling thread, on a tape of its own
+    TaskCostModel costs;
+    std::vector<RiskTask> tasks = book();
+    std::vector<std::atomic<int>> runs(tasks.size());
+    for (auto& r : runs)
+        r = 0;
+    Pricer pricer = {tasks, runs};
+    runScheduledRiskSessions(context(), tasks, 1, costs,
+                             [&](Size i, RiskSession& session) {
+                                 BOOST_CHECK(&session.tape() != &tape);
+                                 pricer(i, session);
+                             });
+    BOOST_CHECK(tape_type::getActive() == &tape);
+
+    // the recording started before the run goes on
+    Real z = y * 2.0 + x;
+    tape.registerOutput(z);
+    derivative(z) = 1.0;
+    tape.computeAdjoints();
+    QL_CHECK_CLOSE(derivative(x), 13.0, 1e-12);
+}
+
+BOOST_AUTO_TEST_CASE(testSchedulingErrors) {
+
+    BOOST_TEST_MESSAGE("Testing errors of scheduled risk sessions...");
+
+    TaskCostModel costs;
+    std::vector<RiskTask> tasks = book();
+    BOOST_CHECK_THROW(runScheduledRiskSessions(context(), tasks, 1, costs,
+                                               [](Size i, RiskSession&) {
+                                                   QL_REQUIRE(i != 3, "pricing failed");
+                                               }),
+                      Error);
+    // the tasks priced before the failure are measured
+    BOOST_CHECK(costs.known("swap") || costs.known("bermudan"));
+
+    tasks.push_back({"swap", 0.0});
+    BOOST_CHECK_THROW(runScheduledRiskSessions(context(), tasks, 1, costs,
+                                               [](Size, RiskSession&) {}),
+                      Error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,158 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/indexes/ibor/euribor.hpp>
+#include <ql/risks/risksession.hpp>
+#include <ql/termstructures/yield/flatforward.hpp>
+#include <ql/time/calendars/target.hpp>
+#include <ql/time/daycounters/actual365fixed.hpp>
+#include <chrono>
+#include <future>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(RiskSessionXadTests)
+
+namespace {
+
+    const Date fixingDate(3, June, 2024);
+    const Date paymentDate(1, July, 2026);
+
+    SessionContext context() {
+        SessionContext context;
+        context.evaluationDate = Date(1, July, 2024);
+        TimeSeries<Real> fixings;
+        fixings[fixingDate] = 0.0375;
+        context.fixings[Euribor6M().name()] = fixings;
+        return context;
+    }
+
+    // a past Euribor fixing paid at a fixed date, discounted on a curve moving with the
+    // evaluation date, with its derivative to the curve rate
+    std::pair<double, double> fixingValue(Real::tape_type& tape) {
+        Real rate = 0.03;
+        tape.registerInput(rate);
+        tape.newRecording();
+        Handle<YieldTermStructure> curve(
+            ext::make_shared<FlatForward>(0, TARGET(), rate, Actual365Fixed()));
+        Euribor6M index(curve);
+        Real v = index.fixing(fixingDate) * curve->discount(paymentDate);
+        tape.registerOutput(v);
+        derivative(v) = 1.0;
+        tape.computeAdjoints();
+        std::pair<double, double> result(value(v), derivative(rate));
+        tape.clearAll();
+        return result;
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testSessionRestoresSettings) {
+
+    BOOST_TEST_MESSAGE("Testing that risk sessions restore settings and fixings...");
+
+    Date today(15, March, 2024);
+    Settings::instance().evaluationDate() = today;
+    std::string name = Euribor6M().name();
+    {
+        RiskSession session(context());
+        BOOST_CHECK_EQUAL(Date(Settings::instance().evaluationDate()), context().evaluationDate);
+        BOOST_CHECK_EQUAL(value(IndexManager::instance().getHistory(name)[fixingDate]), 0.0375);
+        {
+            // nested sessions on the same thread
+            SessionContext inner;
+            inner.evaluationDate = Date(2, July, 2024);
+            RiskSession nested(inner);
+            BOOST_CHECK_EQUAL(Date(Settings::instance().evaluationDate()), inner.evaluationDate);
+            BOOST_CHECK(&nested.tape() == &session.tape());
+        }
+        BOOST_CHECK_EQUAL(Date(Settings::instance().evaluationDate()), context().evaluationDate);
+
+        auto v = fixingValue(session.tape());
+        Time t = Actual365Fixed().yearFraction(context().evaluationDate, paymentDate);
+        QL_CHECK_CLOSE(v.first, 0.0375 * std::exp(-0.03 * t), 1e-12);
+        QL_CHECK_CLOSE(v.second, -t * v.first, 1e-10);
+    }
+    BOOST_CHECK_EQUAL(Date(Settings::instance().evaluationDate()), today);
+    BOOST_CHECK(IndexManager::instance().getHistory(name).empty());
+    BOOST_CHECK(Real::tape_type::getActive() == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(testConcurrentSessions) {
+
+    BOOST_TEST_MESSAGE("Testing concurrent risk sessions under stress...");
+
+    if (!sessionsEnabled()) {
+        // a second thread cannot open a session while this one has one open
+        RiskSession session(context());
+        bool refused = std::async(std::launch::async, []() {
+                           try {
+                               RiskSession other(context());
+                               return false;
+                           } catch (Error&) {
+                               return true;
+                           }
+                       }).get();
+        BOOST_CHECK(refused);
+        BOOST_CHECK_THROW(runRiskSessions(context(), 4, 2, [](Size, RiskSession&) {}), Error);
+        BOOST_TEST_MESSAGE("  QuantLib built without QL_ENABLE_SESSIONS, stress test skipped");
+        return;
+    }
+
+    Date today = Settings::instance().evaluationDate();
+
+    // each job moves its thread's evaluation date, which would race on shared settings
+    const Size jobs = 256, threads = 8;
+    auto job = [](std::vector<std::pair<double, double>>& results) {
+        return [&results](Size i, RiskSession& session) {
+            Settings::instance().evaluationDate() = Date(1, July, 2024) + Integer(i % 17);
+            results[i] = fixingValue(session.tape());
+        };
+    };
+
+    std::vector<std::pair<double, double>> expected(jobs), actual(jobs);
+    auto start = std::chrono::steady_clock::now();
+    runRiskSessions(context(), jobs, 1, job(expected));
+    auto serial = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+    start = std::chrono::steady_clock::now();
+    runRiskSessions(context(), jobs, threads, job(actual));
+    auto parallel = std::chrono::duration<double>(std::chrono::steady_clock::now() - start);
+
+    for (Size i = 0; i < jobs; ++i) {
+        BOOST_CHECK_EQUAL(actual[i].first, expected[i].first);
+        BOOST_CHECK_EQUAL(actual[i].second, expected[i].second);
+    }
+    // the evaluation date of this thread is untouched by the workers
+    BOOST_CHECK_EQUAL(Date(Settings::instance().evaluationDate()), today);
+    BOOST_TEST_MESSAGE("  " << jobs << " jobs: " << serial.count() << "s on 1 thread, "
+                            << parallel.count() << "s on " << threads << " threads");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,129 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/risks/scenariopricing.hpp>
+#include <cmath>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(ScenarioRealXadTests)
+
+namespace {
+
+    // Black-Scholes call with factors spot, rate, volatility, written once for any real type
+    template <class R>
+    R blackScholesCall(const std::vector<R>& x) {
+        using std::exp;
+        using std::log;
+        using std::sqrt;
+        using std::erfc;
+        double strike = 100.0, T = 1.0;
+        R stdDev = x[2] * sqrt(T);
+        R d1 = (log(x[0] / strike) + (x[1] + 0.5 * x[2] * x[2]) * T) / stdDev;
+        R d2 = d1 - stdDev;
+        R n1 = 0.5 * erfc(-d1 / std::sqrt(2.0));
+        R n2 = 0.5 * erfc(-d2 / std::sqrt(2.0));
+        return x[0] * n1 - strike * exp(-x[1] * T) * n2;
+    }
+
+    // a knock-out check, which branches on the spot
+    template <class R>
+    R knockOutCall(const std::vector<R>& x) {
+        if (x[0] > 120.0)
+            return R(0.0);
+        return blackScholesCall(x);
+    }
+
+    std::vector<std::vector<double>> spotScenarios(Size n, double from, double step) {
+        std::vector<std::vector<double>> scenarios;
+        for (Size i = 0; i < n; ++i)
+            scenarios.push_back({from + step * i, 0.03, 0.2});
+        return scenarios;
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testLaneWiseArithmetic) {
+
+    BOOST_TEST_MESSAGE("Testing lane-wise scenario arithmetic...");
+
+    ScenarioReal<4> x, y(2.0);
+    for (Size k = 0; k < 4; ++k)
+        x.lane(k) = 1.0 + k;
+
+    ScenarioReal<4> z = exp(x) * y - x / 2.0 + pow(x, 2);
+    for (Size k = 0; k < 4; ++k) {
+        double xk = 1.0 + k;
+        QL_CHECK_CLOSE(z.lane(k), std::exp(xk) * 2.0 - xk / 2.0 + xk * xk, 1e-12);
+    }
+
+    // comparisons and scalar conversion need all lanes to agree
+    BOOST_CHECK(x < 10.0);
+    BOOST_CHECK(!(x > 10.0));
+    BOOST_CHECK_THROW((void)(x < 2.5), LaneDivergence);
+    BOOST_CHECK_EQUAL(value(y), 2.0);
+    BOOST_CHECK_THROW(value(x), LaneDivergence);
+
+    // lane-wise max does not diverge
+    ScenarioReal<4> m = max(x, ScenarioReal<4>(2.5));
+    BOOST_CHECK_EQUAL(m.lane(0), 2.5);
+    BOOST_CHECK_EQUAL(m.lane(3), 4.0);
+}
+
+BOOST_AUTO_TEST_CASE(testScenarioPricing) {
+
+    BOOST_TEST_MESSAGE("Testing scenario pricing in batches of lanes...");
+
+    // 10 scenarios in batches of 4, the last one padded
+    auto scenarios = spotScenarios(10, 90.0, 2.0);
+    Size divergent;
+    auto results = priceScenarios<4>(blackScholesCall<ScenarioReal<4>>, scenarios, &divergent);
+
+    BOOST_REQUIRE_EQUAL(results.size(), scenarios.size());
+    BOOST_CHECK_EQUAL(divergent, 0U);
+    for (Size i = 0; i < scenarios.size(); ++i)
+        QL_CHECK_CLOSE(results[i], blackScholesCall(scenarios[i]), 1e-12);
+}
+
+BOOST_AUTO_TEST_CASE(testDivergenceFallback) {
+
+    BOOST_TEST_MESSAGE("Testing scenario pricing with divergent control flow...");
+
+    // the second batch straddles the knock-out level
+    auto scenarios = spotScenarios(12, 100.0, 3.0);
+    Size divergent;
+    auto results = priceScenarios<4>(knockOutCall<ScenarioReal<4>>, scenarios, &divergent);
+
+    BOOST_REQUIRE_EQUAL(results.size(), scenarios.size());
+    BOOST_CHECK_EQUAL(divergent, 1U);
+    for (Size i = 0; i < scenarios.size(); ++i)
+        QL_CHECK_CLOSE(results[i], knockOutCall(scenarios[i]), 1e-12);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
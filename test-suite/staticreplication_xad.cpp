@@ -0,0 +1,119 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/exercise.hpp>
+#include <ql/instruments/compositeinstrument.hpp>
+#include <ql/instruments/vanillaoption.hpp>
+#include <ql/pricingengines/vanilla/analyticeuropeanengine.hpp>
+#include <ql/quotes/simplequote.hpp>
+#include <ql/risks/admode.hpp>
+#include <ql/risks/staticreplication.hpp>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(StaticReplicationXadTests)
+
+namespace {
+
+    // inputs: spot, risk-free rate, volatility; outputs: notionals of puts replicating a
+    // portfolio of 2 short-dated and 3 long-dated puts
+    std::vector<Real> replicatePuts(const std::vector<Real>& x) {
+        Date today(15, May, 1998);
+        Settings::instance().evaluationDate() = today;
+        DayCounter dc = Actual365Fixed();
+
+        auto spot = ext::make_shared<SimpleQuote>(x[0]);
+        Handle<YieldTermStructure> rTS(flatRate(today, x[1], dc));
+        Handle<YieldTermStructure> qTS(flatRate(today, 0.0, dc));
+        Handle<BlackVolTermStructure> volTS(flatVol(today, x[2], dc));
+        auto engine =
+            ext::make_shared<AnalyticEuropeanEngine>(ext::make_shared<BlackScholesMertonProcess>(
+                Handle<Quote>(spot), qTS, rTS, volTS));
+
+        std::vector<ext::shared_ptr<Instrument>> hedges;
+        for (auto maturity : {Date(17, Nov, 1998), Date(17, May, 1999)}) {
+            auto put = ext::make_shared<VanillaOption>(
+                ext::make_shared<PlainVanillaPayoff>(Option::Put, 100.0),
+                ext::make_shared<EuropeanExercise>(maturity));
+            put->setPricingEngine(engine);
+            hedges.push_back(put);
+        }
+        auto target = ext::make_shared<CompositeInstrument>();
+        target->add(hedges[0], 2.0);
+        target->add(hedges[1], 3.0);
+
+        std::vector<StaticReplication::GridPoint> grid;
+        for (auto date : {today, Date(15, Aug, 1998)})
+            for (Real s : {90.0, 100.0, 110.0})
+                grid.push_back({date, s});
+
+        StaticReplication replication(spot, grid);
+        Array w = replication.notionals(target, hedges);
+
+        // the spot and evaluation date are restored
+        QL_REQUIRE(spot->value() == x[0], "spot not restored");
+        QL_REQUIRE(Settings::instance().evaluationDate() == today,
+                   "evaluation date not restored");
+        return std::vector<Real>(w.begin(), w.end());
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testExactReplication) {
+
+    BOOST_TEST_MESSAGE("Testing least-squares replication with AAD notional sensitivities...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    std::vector<double> inputs = {95.0, 0.05, 0.25};
+    std::vector<double> jacobian;
+    auto w = computeJacobian(replicatePuts, inputs, ADMode::VectorReverse, jacobian);
+
+    BOOST_REQUIRE_EQUAL(w.size(), 2U);
+    QL_CHECK_CLOSE(w[0], 2.0, 1e-8);
+    QL_CHECK_CLOSE(w[1], 3.0, 1e-8);
+
+    // an exact replication does not depend on the market
+    BOOST_REQUIRE_EQUAL(jacobian.size(), 6U);
+    for (auto d : jacobian)
+        BOOST_CHECK_SMALL(d, 1e-8);
+}
+
+BOOST_AUTO_TEST_CASE(testReplicationRequiresEnoughGridPoints) {
+
+    BOOST_TEST_MESSAGE("Testing least-squares replication with too few grid points...");
+
+    auto spot = ext::make_shared<SimpleQuote>(100.0);
+    StaticReplication replication(spot, {{Date(15, May, 1998), 100.0}});
+    std::vector<ext::shared_ptr<Instrument>> hedges(2, ext::make_shared<CompositeInstrument>());
+    BOOST_CHECK_THROW(replication.notionals(ext::make_shared<CompositeInstrument>(), hedges),
+                      Error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
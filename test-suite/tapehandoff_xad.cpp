@@ -0,0 +1,193 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/math/distributions/normaldistribution.hpp>
+#include <ql/pricingengines/blackformula.hpp>
+#include <ql/risks/tapehandoff.hpp>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(TapeHandOffXadTests)
+
+namespace {
+
+    // discounted call and put on forward, strike, volatility and rate
+    std::vector<Real> callAndPut(const std::vector<Real>& x) {
+        Real stdDev = x[2] * std::sqrt(2.0);
+        Real discount = std::exp(-x[3] * 2.0);
+        return {blackFormula(Option::Call, x[1], x[0], stdDev, discount),
+                blackFormula(Option::Put, x[1], x[0], stdDev, discount)};
+    }
+
+    std::vector<double> scenario(Size i) {
+        return {100.0 + 2.0 * i, 100.0, 0.15 + 0.01 * i, 0.02};
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testPipelinedSweeps) {
+
+    BOOST_TEST_MESSAGE("Testing reverse sweeps of recordings handed off to other threads...");
+
+    using tape_type = Real::tape_type;
+    const Size n = 20;
+    const std::vector<double> seeds = {1.0, -0.5};
+
+    // reference adjoints, recorded and swept on this thread
+    std::vector<std::vector<double>> expected;
+    {
+        tape_type tape;
+        for (Size i = 0; i < n; ++i) {
+            std::vector<double> inputs = scenario(i);
+            std::vector<Real> x(inputs.begin(), inputs.end());
+            tape.registerInputs(x);
+            tape.newRecording();
+            std::vector<Real> y = callAndPut(x);
+            tape.registerOutputs(y);
+            derivative(y[0]) = seeds[0];
+            derivative(y[1]) = seeds[1];
+            tape.computeAdjoints();
+            std::vector<double> adjoints;
+            for (auto& xi : x)
+                adjoints.push_back(derivative(xi));
+            expected.push_back(adjoints);
+            tape.clearAll();
+        }
+    }
+
+    // recorded here, swept on two worker threads
+    AdjointPipeline pipeline(2);
+    std::vector<std::future<std::vector<double>>> results;
+    for (Size i = 0; i < n; ++i) {
+        RecordedTape recording = recordTape(callAndPut, scenario(i));
+        BOOST_CHECK_EQUAL(recording.inputs(), 4U);
+        BOOST_CHECK_EQUAL(recording.outputs(), 2U);
+        BOOST_CHECK(tape_type::getActive() == nullptr);
+        results.push_back(pipeline.sweep(std::move(recording), seeds));
+    }
+    for (Size i = 0; i < n; ++i) {
+        std::vector<double> adjoints = results[i].get();
+        BOOST_REQUIRE_EQUAL(adjoints.size(), expected[i].size());
+        for (Size j = 0; j < adjoints.size(); ++j)
+            QL_CHECK_CLOSE(adjoints[j], expected[i][j], 1e-12);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testHandOffErrors) {
+
+    BOOST_TEST_MESSAGE("Testing errors of tape hand-offs...");
+
+    AdjointPipeline pipeline;
+
+    // sweep errors are returned through the future
+    auto result = pipeline.sweep(recordTape(callAndPut, scenario(0)), {1.0});
+    BOOST_CHECK_THROW(result.get(), Error);
+
+    // default seeds of one for all outputs
+    RecordedTape recording = recordTape(callAndPut, scenario(1));
+    Real parity = recording.values()[0] - recording.values()[1];
+    std::vector<double> adjoints = pipeline.sweep(std::move(recording)).get();
+    QL_CHECK_CLOSE(parity, (102.0 - 100.0) * std::exp(-0.04), 1e-10);
+    // the sum of call and put has delta D (2 N(d1) - 1)
+    double stdDev = 0.16 * std::sqrt(2.0), d1 = std::log(102.0 / 100.0) / stdDev + 0.5 * stdDev;
+    QL_CHECK_CLOSE(adjoints[0],
+                   std::exp(-0.04) * (2.0 * CumulativeNormalDistribution()(d1) - 1.0), 1e-10);
+
+    // no recording while a tape is active on the thread
+    Real::tape_type tape;
+    BOOST_CHECK_THROW(recordTape(callAndPut, scenario(0)), Error);
+}
+
+BOOST_AUTO_TEST_CASE(testDirectionalDerivatives) {
+
+    BOOST_TEST_MESSAGE("Testing directional derivatives of recordings...");
+
+    const std::vector<double> inputs = scenario(3);
+    const std::vector<std::vector<double>> directions = {
+        {1.0, 0.0, 0.0, 0.0}, {0.5, -0.5, 0.01, 0.0}, {-2.0, 1.0, 0.02, 0.001}};
+
+    RecordedTape recording = recordTape(callAndPut, inputs);
+    std::vector<double> derivatives = recording.directionalDerivatives(directions);
+    BOOST_REQUIRE_EQUAL(derivatives.size(), 2U * directions.size());
+
+    // central differences along each direction
+    const double h = 1e-5;
+    for (Size j = 0; j < directions.size(); ++j) {
+        std::vector<Real> up, down;
+        for (Size i = 0; i < inputs.size(); ++i) {
+            up.push_back(inputs[i] + h * directions[j][i]);
+            down.push_back(inputs[i] - h * directions[j][i]);
+        }
+        std::vector<Real> yUp = callAndPut(up), yDown = callAndPut(down);
+        for (Size k = 0; k < 2; ++k)
+            QL_CHECK_CLOSE(derivatives[k * directions.size() + j],
+                           value((yUp[k] - yDown[k]) / (2.0 * h)), 1e-5);
+    }
+
+    BOOST_CHECK_THROW(recording.directionalDerivatives({{1.0, 0.0}}), Error);
+}
+
+BOOST_AUTO_TEST_CASE(testActiveTapeSuspension) {
+
+    BOOST_TEST_MESSAGE("Testing recordings made while the thread's tape is suspended...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+    BOOST_REQUIRE(tape_type::getActive() == &tape);
+
+    std::vector<double> adjoints;
+    {
+        ActiveTapeSuspension suspension;
+        BOOST_CHECK(tape_type::getActive() == nullptr);
+        RecordedTape recording = recordTape(callAndPut, scenario(0));
+        adjoints = recording.sweep({1.0, 0.0});
+    }
+    BOOST_CHECK(tape_type::getActive() == &tape);
+    BOOST_CHECK_EQUAL(adjoints.size(), 4U);
+
+    // the tape is reactivated when the recording fails
+    try {
+        ActiveTapeSuspension suspension;
+        recordTape([](const std::vector<Real>&) -> std::vector<Real> { QL_FAIL("failed"); },
+                   scenario(0));
+    } catch (Error&) {
+    }
+    BOOST_CHECK(tape_type::getActive() == &tape);
+
+    // without an active tape, it does nothing
+    tape.deactivate();
+    {
+        ActiveTapeSuspension suspension;
+        BOOST_CHECK(tape_type::getActive() == nullptr);
+    }
+    BOOST_CHECK(tape_type::getActive() == nullptr);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
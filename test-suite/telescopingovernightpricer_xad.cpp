@@ -0,0 +1,170 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/cashflows/overnightindexedcouponpricer.hpp>
+#include <ql/indexes/ibor/eonia.hpp>
+#include <ql/instruments/makeois.hpp>
+#include <ql/quotes/simplequote.hpp>
+#include <ql/risks/telescopingovernightpricer.hpp>
+#include <ql/time/daycounters/actual365fixed.hpp>
+#include <ql/time/schedule.hpp>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(TelescopingOvernightPricerXadTests)
+
+namespace {
+
+    struct Results {
+        Real npv;
+        double sensitivity;
+        Size memory;
+    };
+
+    // adds the fixings of the month before today
+    void addPastFixings(const ext::shared_ptr<OvernightIndex>& index, const Date& start) {
+        Date today = Settings::instance().evaluationDate();
+        for (Date d = start; d < today; ++d)
+            if (index->isValidFixingDate(d))
+                index->addFixing(d, 0.01, true);
+    }
+
+    // NPV of a 10Y OIS started a month ago, and its sensitivity to the flat curve rate
+    Results priceOis(double rate, bool telescoping) {
+        using tape_type = Real::tape_type;
+        tape_type tape;
+
+        Date today = Settings::instance().evaluationDate();
+        Real r = rate;
+        tape.registerInput(r);
+        tape.newRecording();
+
+        Handle<YieldTermStructure> curve(flatRate(today, r, Actual365Fixed()));
+        auto eonia = ext::make_shared<Eonia>(curve);
+        Date start = eonia->fixingCalendar().advance(today, -1, Months);
+        addPastFixings(eonia, start);
+
+        ext::shared_ptr<OvernightIndexedSwap> swap =
+            MakeOIS(10 * Years, eonia, 0.02).withEffectiveDate(start).withNominal(1000000.0);
+        if (telescoping)
+            setTelescopingCouponPricer(swap->overnightLeg());
+        else
+            for (const auto& cf : swap->overnightLeg())
+                ext::dynamic_pointer_cast<OvernightIndexedCoupon>(cf)->setPricer(
+                    ext::make_shared<CompoundingOvernightIndexedCouponPricer>());
+
+        Real npv = swap->NPV();
+        tape.registerOutput(npv);
+        derivative(npv) = 1.0;
+        tape.computeAdjoints();
+        return {npv, derivative(r), tape.getMemory()};
+    }
+
+    struct CouponResults {
+        std::vector<double> rates;
+        double sensitivity;
+    };
+
+    // rates of the quarterly coupons of a 2Y overnight leg started a month ago with a
+    // 50bp spread, and the sensitivity of their sum to the flat curve rate
+    CouponResults couponRates(double rate,
+                              bool includeSpread,
+                              const ext::shared_ptr<FloatingRateCouponPricer>& pricer) {
+        using tape_type = Real::tape_type;
+        tape_type tape;
+
+        Date today = Settings::instance().evaluationDate();
+        Real r = rate;
+        tape.registerInput(r);
+        tape.newRecording();
+
+        Handle<YieldTermStructure> curve(flatRate(today, r, Actual365Fixed()));
+        auto eonia = ext::make_shared<Eonia>(curve);
+        Date start = eonia->fixingCalendar().advance(today, -1, Months);
+        addPastFixings(eonia, start);
+
+        Schedule schedule = MakeSchedule()
+                                .from(start)
+                                .to(start + 2 * Years)
+                                .withFrequency(Quarterly)
+                                .withCalendar(eonia->fixingCalendar());
+        Leg leg = OvernightLeg(schedule, eonia)
+                      .withNotionals(1000000.0)
+                      .withSpreads(0.005)
+                      .includeSpread(includeSpread);
+
+        CouponResults results;
+        Real sum = 0.0;
+        for (const auto& cf : leg) {
+            auto coupon = ext::dynamic_pointer_cast<OvernightIndexedCoupon>(cf);
+            coupon->setPricer(pricer);
+            Rate couponRate = coupon->rate();
+            results.rates.push_back(value(couponRate));
+            sum += couponRate;
+        }
+        tape.registerOutput(sum);
+        derivative(sum) = 1.0;
+        tape.computeAdjoints();
+        results.sensitivity = derivative(r);
+        return results;
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testTelescopingMatchesDailyCompounding) {
+
+    BOOST_TEST_MESSAGE("Testing telescoping overnight coupon pricer...");
+
+    Results daily = priceOis(0.015, false);
+    Results telescoping = priceOis(0.015, true);
+
+    QL_CHECK_CLOSE(telescoping.npv, daily.npv, 1e-6);
+    QL_CHECK_CLOSE(telescoping.sensitivity, daily.sensitivity, 1e-6);
+    BOOST_TEST_MESSAGE("    tape memory " << telescoping.memory << " bytes against "
+                                          << daily.memory << " with QuantLib's pricer");
+    BOOST_CHECK_LE(telescoping.memory, daily.memory);
+}
+
+BOOST_AUTO_TEST_CASE(testTelescopingMatchesQuantLibCouponRates) {
+
+    BOOST_TEST_MESSAGE("Testing telescoping overnight coupon rates against QuantLib's pricer...");
+
+    for (bool includeSpread : {false, true}) {
+        CouponResults expected = couponRates(
+            0.015, includeSpread, ext::make_shared<CompoundingOvernightIndexedCouponPricer>());
+        CouponResults calculated = couponRates(
+            0.015, includeSpread, ext::make_shared<TelescopingOvernightIndexedCouponPricer>());
+
+        BOOST_REQUIRE_EQUAL(calculated.rates.size(), expected.rates.size());
+        for (Size i = 0; i < expected.rates.size(); ++i)
+            QL_CHECK_CLOSE(calculated.rates[i], expected.rates[i], 1e-8);
+        QL_CHECK_CLOSE(calculated.sensitivity, expected.sensitivity, 1e-6);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
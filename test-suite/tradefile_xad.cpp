@@ -0,0 +1,206 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/indexes/ibor/euribor.hpp>
+#include <ql/risks/tradefile.hpp>
+#include <ql/termstructures/volatility/equityfx/blackconstantvol.hpp>
+#include <ql/time/calendars/target.hpp>
+#include <ql/time/daycounters/actual360.hpp>
+#include <ql/time/daycounters/actual365fixed.hpp>
+#include <ql/time/daycounters/thirty360.hpp>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(TradeFileXadTests)
+
+namespace {
+
+    const std::string tradePath = "tradefile_xad.trades";
+
+    SwapTradeConventions conventions(const ext::shared_ptr<IborIndex>& index) {
+        SwapTradeConventions result;
+        result.calendar = TARGET();
+        result.fixedDayCount = Thirty360(Thirty360::BondBasis);
+        result.floatingDayCount = Actual360();
+        result.index = index;
+        return result;
+    }
+
+    std::vector<TradeRecord> options(const Date& today, Size n) {
+        std::vector<TradeRecord> result;
+        for (Size k = 0; k < n; ++k)
+            result.push_back(europeanOptionTrade(k % 2 == 0 ? Option::Call : Option::Put,
+                                                 80.0 + static_cast<Real>(k % 41),
+                                                 today + static_cast<Integer>(30 + 7 * (k % 50)),
+                                                 k % 3));
+        return result;
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testSwapRoundTrip) {
+
+    BOOST_TEST_MESSAGE("Testing swaps loaded from a trade file...");
+
+    Date today = Settings::instance().evaluationDate();
+    Handle<YieldTermStructure> forecasting(flatRate(today, 0.03, Actual365Fixed()));
+    Handle<YieldTermStructure> discounting(flatRate(today, 0.025, Actual365Fixed()));
+    auto index = ext::make_shared<Euribor6M>(forecasting);
+    SwapTradeConventions c = conventions(index);
+
+    VanillaSwapBook expected;
+    std::vector<TradeRecord> trades;
+    for (Size k = 0; k < 5; ++k) {
+        Date effective = c.calendar.advance(today, 2 + static_cast<Integer>(k) * 30, Days);
+        Date termination = c.calendar.advance(effective, 2 + static_cast<Integer>(k), Years);
+        Schedule fixedSchedule(effective, termination, 1 * Years, c.calendar, c.convention,
+                               c.terminationConvention, c.rule, false);
+        Schedule floatSchedule(effective, termination, 6 * Months, c.calendar, c.convention,
+                               c.terminationConvention, c.rule, false);
+        VanillaSwap swap(k % 2 == 0 ? Swap::Payer : Swap::Receiver, 1000000.0 * (k + 1),
+                         fixedSchedule, 0.02 + 0.005 * k, c.fixedDayCount, floatSchedule, index,
+                         0.001 * k, c.floatingDayCount);
+        expected.add(swap);
+        trades.push_back(vanillaSwapTrade(swap));
+    }
+    writeTradeFile(tradePath, trades);
+
+    {
+        TradeFile file(tradePath);
+        BOOST_REQUIRE_EQUAL(file.size(), trades.size());
+        BOOST_CHECK(file[1].kind == TradeKind::VanillaSwap);
+        BOOST_CHECK_EQUAL(file[1].type, static_cast<std::int32_t>(Swap::Receiver));
+        BOOST_CHECK_EQUAL(file[1].fixedMonths, 12);
+        BOOST_CHECK_EQUAL(file[1].floatingMonths, 6);
+        BOOST_CHECK_EQUAL(file[3].nominal, 4000000.0);
+
+        VanillaSwapBook book;
+        addTrades(book, file.begin(), file.end(), c);
+        BOOST_REQUIRE_EQUAL(book.size(), expected.size());
+        std::vector<Real> npvs = book.npvs(*discounting, *forecasting),
+                          expectedNpvs = expected.npvs(*discounting, *forecasting);
+        for (Size k = 0; k < npvs.size(); ++k)
+            QL_CHECK_CLOSE(npvs[k], expectedNpvs[k], 1e-12);
+    }
+    std::remove(tradePath.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(testChunkedLoading) {
+
+    BOOST_TEST_MESSAGE("Testing loading of a trade file in chunks on several threads...");
+
+    Date today = Settings::instance().evaluationDate();
+    DayCounter dc = Actual365Fixed();
+    auto riskFree = flatRate(today, 0.04, dc);
+    auto dividend = flatRate(today, 0.01, dc);
+    BlackConstantVol volatility(today, TARGET(), 0.2, dc);
+    std::vector<Real> spots = {90.0, 100.0, 110.0};
+
+    writeTradeFile(tradePath, options(today, 1000));
+    {
+        TradeFile file(tradePath);
+        EuropeanOptionBook book;
+        addTrades(book, file.begin(), file.end());
+        Real expected = book.npv(spots, *riskFree, *dividend, volatility);
+
+        const Size chunkSize = 64;
+        std::vector<EuropeanOptionBook> chunks((file.size() + chunkSize - 1) / chunkSize);
+        forEachTradeChunk(file, chunkSize, 4,
+                          [&](Size chunk, const TradeRecord* first, const TradeRecord* last) {
+                              addTrades(chunks[chunk], first, last);
+                          });
+        Size loaded = 0;
+        Real total = 0.0;
+        for (const auto& chunk : chunks) {
+            loaded += chunk.size();
+            total += chunk.npv(spots, *riskFree, *dividend, volatility);
+        }
+        BOOST_CHECK_EQUAL(loaded, file.size());
+        QL_CHECK_CLOSE(total, expected, 1e-10);
+
+        // errors in a chunk are rethrown
+        BOOST_CHECK_THROW(forEachTradeChunk(file, chunkSize, 4,
+                                            [](Size chunk, const TradeRecord*,
+                                               const TradeRecord*) {
+                                                QL_REQUIRE(chunk != 7, "chunk failed");
+                                            }),
+                          Error);
+    }
+    std::remove(tradePath.c_str());
+}
+
+BOOST_AUTO_TEST_CASE(testInvalidFiles) {
+
+    BOOST_TEST_MESSAGE("Testing that invalid trade files are rejected...");
+
+    Date today = Settings::instance().evaluationDate();
+    BOOST_CHECK_THROW(TradeFile("tradefile_xad.missing"), Error);
+
+    writeTradeFile(tradePath, options(today, 10));
+    std::string bytes;
+    {
+        std::ifstream in(tradePath, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    auto rewrite = [&](const std::string& contents) {
+        std::ofstream out(tradePath, std::ios::binary | std::ios::trunc);
+        out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+    };
+
+    // a truncated file
+    rewrite(bytes.substr(0, bytes.size() - 20));
+    BOOST_CHECK_THROW(TradeFile{tradePath}, Error);
+
+    // another file format
+    std::string other = bytes;
+    other[0] = 'X';
+    rewrite(other);
+    BOOST_CHECK_THROW(TradeFile{tradePath}, Error);
+
+    // an empty file
+    rewrite(std::string());
+    BOOST_CHECK_THROW(TradeFile{tradePath}, Error);
+
+    // swaps are not loaded into option books
+    writeTradeFile(tradePath, {vanillaSwapTrade(Swap::Payer, 1.0e6, today, today + 365,
+                                                1 * Years, 0.02, 6 * Months)});
+    {
+        TradeFile file(tradePath);
+        EuropeanOptionBook book;
+        BOOST_CHECK_THROW(addTrades(book, file.begin(), file.end()), Error);
+    }
+    std::remove(tradePath.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,219 @@
+/* -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 4 -*- */
+
+/*
+ Copyright (C) 2024 Xcelerit Computing Limited
+
+ This file is part of QuantLib / XAD integration module.
+ It is modified from QuantLib, a free-software/open-source library
+ for financial quantitative analysts and developers - http://quantlib.org/
+
+ QuantLib is free software: you can redistribute it and/or modify it
+ under the terms of the QuantLib license.  You should have received a
+ copy of the license along with this program; if not, please email
+ <quantlib-dev@lists.sf.net>. The license is also available online at
+ <http://quantlib.org/license.shtml>.
+
+ This program is distributed in the hope that it will be useful, but WITHOUT
+ ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ FOR A PARTICULAR PURPOSE.  See the license for more details.
+*/
+
+
+
+#include "toplevelfixture.hpp"
+#include "utilities_xad.hpp"
+#include <ql/indexes/ibor/euribor.hpp>
+#include <ql/pricingengines/swap/discountingswapengine.hpp>
+#include <ql/pricingengines/vanilla/analyticeuropeanengine.hpp>
+#include <ql/processes/blackscholesprocess.hpp>
+#include <ql/quotes/simplequote.hpp>
+#include <ql/risks/vanillabook.hpp>
+#include <ql/termstructures/volatility/equityfx/blackvariancesurface.hpp>
+#include <ql/time/calendars/target.hpp>
+#include <ql/time/daycounters/actual360.hpp>
+#include <ql/time/daycounters/actual365fixed.hpp>
+#include <ql/time/daycounters/actualactual.hpp>
+#include <ql/time/daycounters/thirty360.hpp>
+#include <ql/time/schedule.hpp>
+#include <vector>
+
+using namespace QuantLib;
+using namespace boost::unit_test_framework;
+
+BOOST_FIXTURE_TEST_SUITE(QuantLibRisksTests, TopLevelFixture)
+
+BOOST_AUTO_TEST_SUITE(VanillaBookXadTests)
+
+namespace {
+
+    // seasoned, spot and forward-starting payer and receiver swaps
+    std::vector<ext::shared_ptr<VanillaSwap>>
+    swaps(const ext::shared_ptr<IborIndex>& index, const Date& today) {
+        Calendar calendar = TARGET();
+        std::vector<ext::shared_ptr<VanillaSwap>> result;
+        const Integer startMonths[] = {-3, 0, 0, 12, -9};
+        const Integer years[] = {5, 2, 10, 7, 3};
+        for (Size k = 0; k < 5; ++k) {
+            Date effective =
+                calendar.advance(calendar.advance(today, 2, Days), startMonths[k], Months);
+            Date termination = calendar.advance(effective, years[k], Years);
+            Schedule fixedSchedule(effective, termination, 1 * Years, calendar, ModifiedFollowing,
+                                   ModifiedFollowing, DateGeneration::Backward, false);
+            Schedule floatSchedule(effective, termination, 6 * Months, calendar,
+                                   ModifiedFollowing, ModifiedFollowing, DateGeneration::Backward,
+                                   false);
+            result.push_back(ext::make_shared<VanillaSwap>(
+                k % 2 == 0 ? Swap::Payer : Swap::Receiver, 1000000.0 * (k + 1), fixedSchedule,
+                0.02 + 0.005 * k, Thirty360(Thirty360::BondBasis), floatSchedule, index,
+                0.001 * k, Actual360()));
+        }
+        return result;
+    }
+
+}
+
+BOOST_AUTO_TEST_CASE(testSwapBook) {
+
+    BOOST_TEST_MESSAGE("Testing swap books against the discounting swap engine...");
+
+    using tape_type = Real::tape_type;
+    tape_type tape;
+
+    Date today = Settings::instance().evaluationDate();
+    Real forecastRate = 0.03, discountRate = 0.025;
+    tape.registerInput(forecastRate);
+    tape.registerInput(discountRate);
+    tape.newRecording();
+
+    Handle<YieldTermStructure> forecasting(flatRate(today, forecastRate, Actual365Fixed()));
+    Handle<YieldTermStructure> discounting(flatRate(today, discountRate, Actual365Fixed()));
+    auto index = ext::make_shared<Euribor6M>(forecasting);
+    // fixings of the seasoned swaps
+    for (Date d = today - 300; d <= today; ++d)
+        if (index->isValidFixingDate(d))
+            index->addFixing(d, 0.021);
+
+    auto portfolio = swaps(index, today);
+    VanillaSwapBook book;
+    for (const auto& swap : portfolio)
+        book.add(*swap);
+    BOOST_CHECK_EQUAL(book.size(), portfolio.size());
+
+    std::vector<Real> npvs = book.npvs(*discounting, *forecasting);
+    auto engine = ext::make_shared<DiscountingSwapEngine>(discounting);
+    Real bookTotal = 0.0, total = 0.0;
+    for (Size k = 0; k < portfolio.size(); ++k) {
+        portfolio[k]->setPricingEngine(engine);
+        QL_CHECK_CLOSE(npvs[k], portfolio[k]->NPV(), 1e-8);
+        bookTotal += npvs[k];
+        total += portfolio[k]->NPV();
+    }
+
+    tape.registerOutput(bookTotal);
+    derivative(bookTotal) = 1.0;
+    tape.computeAdjoints();
+    double bookForecastRisk = derivative(forecastRate), bookDiscountRisk = derivative(discountRate);
+
+    tape.clearDerivatives();
+    tape.registerOutput(total);
+    derivative(total) = 1.0;
+    tape.computeAdjoints();
+    QL_CHECK_CLOSE(bookForecastRisk, derivative(forecastRate), 1e-8);
+    QL_CHECK_CLOSE(bookDiscountRisk, derivative(discountRate), 1e-8);
+
+    index->clearFixings();
+}
+
+BOOST_AUTO_TEST_CASE(testSwapBookFromTerms) {
+
+    BOOST_TEST_MESSAGE("Testing swaps added to a book from their terms...");
+
+    Date today = Settings::instance().evaluationDate();
+    Handle<YieldTermStructure> forecasting(flatRate(today, 0.03, Actual365Fixed()));
+    Handle<YieldTermStructure> discounting(flatRate(today, 0.025, Actual365Fixed()));
+    auto index = ext::make_shared<Euribor6M>(forecasting);
+    for (Date d = today - 300; d <= today; ++d)
+        if (index->isValidFixingDate(d))
+            index->addFixing(d, 0.021);
+
+    // seasoned and spot swaps with short front or back stubs, and a fixed day count using
+    // the reference periods of the stubs
+    Calendar calendar = TARGET();
+    DayCounter fixedDayCount = ActualActual(ActualActual::ISMA);
+    const Integer startMonths[] = {-4, 0, 1, -7};
+    const Integer months[] = {27, 31, 5, 40};
+    const DateGeneration::Rule rules[] = {DateGeneration::Backward, DateGeneration::Forward,
+                                          DateGeneration::Forward, DateGeneration::Backward};
+    VanillaSwapBook fromSwaps, fromTerms;
+    for (Size k = 0; k < 4; ++k) {
+        Date effective =
+            calendar.advance(calendar.advance(today, 2, Days), startMonths[k], Months);
+        Date termination = calendar.advance(effective, months[k], Months);
+        Schedule fixedSchedule(effective, termination, 1 * Years, calendar, ModifiedFollowing,
+                               ModifiedFollowing, rules[k], false);
+        Schedule floatSchedule(effective, termination, 6 * Months, calendar, Following,
+                               ModifiedFollowing, rules[k], false);
+        Swap::Type type = k % 2 == 0 ? Swap::Payer : Swap::Receiver;
+        Real nominal = 1000000.0 * (k + 1);
+        Rate fixedRate = 0.02 + 0.005 * k;
+        Spread spread = 0.001 * k;
+        fromSwaps.add(VanillaSwap(type, nominal, fixedSchedule, fixedRate, fixedDayCount,
+                                  floatSchedule, index, spread, Actual360()));
+        fromTerms.add(type, nominal, fixedSchedule, fixedRate, fixedDayCount, floatSchedule,
+                      index, spread, Actual360());
+    }
+
+    std::vector<Real> npvs = fromTerms.npvs(*discounting, *forecasting),
+                      expected = fromSwaps.npvs(*discounting, *forecasting);
+    BOOST_REQUIRE_EQUAL(npvs.size(), expected.size());
+    for (Size k = 0; k < npvs.size(); ++k)
+        QL_CHECK_CLOSE(npvs[k], expected[k], 1e-12);
+
+    index->clearFixings();
+}
+
+BOOST_AUTO_TEST_CASE(testEuropeanOptionBook) {
+
+    BOOST_TEST_MESSAGE("Testing European option books against the analytic engine...");
+
+    Date today = Settings::instance().evaluationDate();
+    DayCounter dc = Actual365Fixed();
+    Handle<YieldTermStructure> riskFree(flatRate(today, 0.04, dc));
+    Handle<YieldTermStructure> dividend(flatRate(today, 0.015, dc));
+    std::vector<Date> volDates = {today + 90, today + 365, today + 730};
+    std::vector<Real> volStrikes = {80.0, 100.0, 120.0};
+    Matrix vols(3, 3);
+    for (Size i = 0; i < 3; ++i)
+        for (Size j = 0; j < 3; ++j)
+            vols[i][j] = 0.25 - 0.03 * i + 0.01 * j;
+    Handle<BlackVolTermStructure> volatility(
+        ext::make_shared<BlackVarianceSurface>(today, TARGET(), volDates, volStrikes, vols, dc));
+
+    std::vector<Real> spots = {95.0, 105.0};
+    std::vector<ext::shared_ptr<VanillaOption>> options;
+    EuropeanOptionBook book;
+    for (Size u = 0; u < spots.size(); ++u) {
+        auto process = ext::make_shared<GeneralizedBlackScholesProcess>(
+            Handle<Quote>(ext::make_shared<SimpleQuote>(spots[u])), dividend, riskFree,
+            volatility);
+        auto engine = ext::make_shared<AnalyticEuropeanEngine>(process);
+        for (Integer days : {120, 365, 500})
+            for (Real strike : {85.0, 100.0, 115.0})
+                for (Option::Type type : {Option::Call, Option::Put}) {
+                    options.push_back(ext::make_shared<VanillaOption>(
+                        ext::make_shared<PlainVanillaPayoff>(type, strike),
+                        ext::make_shared<EuropeanExercise>(today + days)));
+                    options.back()->setPricingEngine(engine);
+                    book.add(*options.back(), u);
+                }
+    }
+
+    std::vector<Real> npvs = book.npvs(spots, *riskFree, *dividend, *volatility);
+    BOOST_REQUIRE_EQUAL(npvs.size(), options.size());
+    for (Size k = 0; k < options.size(); ++k)
+        QL_CHECK_CLOSE(npvs[k], options[k]->NPV(), 1e-10);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE_END()